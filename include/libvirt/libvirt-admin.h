@@ -405,6 +405,76 @@ int virAdmServerSetClientLimits(virAdmServerPtr srv,
 int virAdmServerUpdateTlsFiles(virAdmServerPtr srv,
                                unsigned int flags);
 
+/* Per-server statistics reported by the lock daemon */
+
+/**
+ * VIR_SERVER_STATS_LOCK_LOCKSPACES:
+ * Number of lockspaces known to the lock daemon, as VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_SERVER_STATS_LOCK_LOCKSPACES "lock.lockspaces"
+
+/**
+ * VIR_SERVER_STATS_LOCK_RESOURCES:
+ * Number of currently locked resources, as VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_SERVER_STATS_LOCK_RESOURCES "lock.resources"
+
+/**
+ * VIR_SERVER_STATS_LOCK_OWNERS:
+ * Number of lock owners holding at least one resource, summed over
+ * lockspaces, as VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_SERVER_STATS_LOCK_OWNERS "lock.owners"
+
+/**
+ * VIR_SERVER_STATS_LOCK_ACQUIRED:
+ * Number of successful acquisitions of a resource, as
+ * VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_SERVER_STATS_LOCK_ACQUIRED "lock.acquired"
+
+/**
+ * VIR_SERVER_STATS_LOCK_BUSY:
+ * Number of acquisitions refused because the resource was held by
+ * somebody else, as VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_SERVER_STATS_LOCK_BUSY "lock.busy"
+
+/**
+ * VIR_SERVER_STATS_LOCK_RELEASED:
+ * Number of resources which were unlocked after their last owner
+ * released them, as VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_SERVER_STATS_LOCK_RELEASED "lock.released"
+
+/**
+ * VIR_SERVER_STATS_LOCK_HOLD_TIME:
+ * Total time resources counted in VIR_SERVER_STATS_LOCK_RELEASED were
+ * locked for, in microseconds, as VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_SERVER_STATS_LOCK_HOLD_TIME "lock.hold_time"
+
+/**
+ * VIR_SERVER_STATS_LOCK_HOLD_TIME_MAX:
+ * The longest time any of resources counted in
+ * VIR_SERVER_STATS_LOCK_RELEASED was locked for, in microseconds, as
+ * VIR_TYPED_PARAM_ULLONG.
+ */
+
+# define VIR_SERVER_STATS_LOCK_HOLD_TIME_MAX "lock.hold_time_max"
+
+int virAdmServerGetStats(virAdmServerPtr srv,
+                         virTypedParameterPtr *params,
+                         int *nparams,
+                         unsigned int flags);
+
 int virAdmConnectGetLoggingOutputs(virAdmConnectPtr conn,
                                    char **outputs,
                                    unsigned int flags);
@@ -3352,6 +3352,8 @@ typedef enum {
                                               * completed job */
     VIR_DOMAIN_JOB_STATS_KEEP_COMPLETED = 1 << 1, /* don't remove completed
                                                      stats when reading them */
+    VIR_DOMAIN_JOB_STATS_DISK_MIRRORS = 1 << 2, /* report per-disk statistics
+                                                   of storage migration */
 } virDomainGetJobStatsFlags;
 
 int virDomainGetJobInfo(virDomainPtr dom,
@@ -3714,6 +3716,78 @@ typedef enum {
  */
 # define VIR_DOMAIN_JOB_DISK_TEMP_TOTAL "disk_temp_total"
 
+/**
+ * VIR_DOMAIN_JOB_DISK_MIRROR_COUNT:
+ *
+ * virDomainGetJobStats field: number of disks copied by the migration
+ * using separate mirror jobs, as VIR_TYPED_PARAM_UINT. Details of each of
+ * them are reported in the VIR_DOMAIN_JOB_DISK_MIRROR_* fields indexed
+ * from 0 to this value minus one. The disk_mirror.* fields are only
+ * reported when VIR_DOMAIN_JOB_STATS_DISK_MIRRORS is passed to
+ * virDomainGetJobStats.
+ */
+# define VIR_DOMAIN_JOB_DISK_MIRROR_COUNT "disk_mirror.count"
+
+/**
+ * VIR_DOMAIN_JOB_DISK_MIRROR_NAME:
+ *
+ * virDomainGetJobStats field: target name of the mirrored disk, for
+ * example "disk_mirror.0.name", as VIR_TYPED_PARAM_STRING.
+ */
+# define VIR_DOMAIN_JOB_DISK_MIRROR_NAME "disk_mirror.%u.name"
+
+/**
+ * VIR_DOMAIN_JOB_DISK_MIRROR_TOTAL:
+ *
+ * virDomainGetJobStats field: number of bytes the mirror of the disk has
+ * to copy, as VIR_TYPED_PARAM_ULLONG. The value may grow while the guest
+ * keeps writing to the disk.
+ */
+# define VIR_DOMAIN_JOB_DISK_MIRROR_TOTAL "disk_mirror.%u.total"
+
+/**
+ * VIR_DOMAIN_JOB_DISK_MIRROR_PROCESSED:
+ *
+ * virDomainGetJobStats field: number of bytes already copied by the mirror
+ * of the disk, as VIR_TYPED_PARAM_ULLONG.
+ */
+# define VIR_DOMAIN_JOB_DISK_MIRROR_PROCESSED "disk_mirror.%u.processed"
+
+/**
+ * VIR_DOMAIN_JOB_DISK_MIRROR_REMAINING:
+ *
+ * virDomainGetJobStats field: number of bytes the mirror of the disk still
+ * has to copy, as VIR_TYPED_PARAM_ULLONG.
+ */
+# define VIR_DOMAIN_JOB_DISK_MIRROR_REMAINING "disk_mirror.%u.remaining"
+
+/**
+ * VIR_DOMAIN_JOB_DISK_MIRROR_BANDWIDTH:
+ *
+ * virDomainGetJobStats field: bandwidth limit currently applied to the
+ * mirror of the disk in bytes per second, as VIR_TYPED_PARAM_ULLONG.
+ * Omitted when the mirror is not limited.
+ */
+# define VIR_DOMAIN_JOB_DISK_MIRROR_BANDWIDTH "disk_mirror.%u.bandwidth"
+
+/**
+ * VIR_DOMAIN_JOB_DISK_MIRROR_READY:
+ *
+ * virDomainGetJobStats field: whether the mirror of the disk finished the
+ * initial copy and only keeps up with guest writes, as
+ * VIR_TYPED_PARAM_BOOLEAN.
+ */
+# define VIR_DOMAIN_JOB_DISK_MIRROR_READY "disk_mirror.%u.ready"
+
+/**
+ * VIR_DOMAIN_JOB_DISK_MIRROR_ETA:
+ *
+ * virDomainGetJobStats field: estimated number of milliseconds until the
+ * mirror of the disk finishes the initial copy, as VIR_TYPED_PARAM_ULLONG.
+ * Present only for running mirrors which are not ready yet.
+ */
+# define VIR_DOMAIN_JOB_DISK_MIRROR_ETA "disk_mirror.%u.eta"
+
 /**
  * virConnectDomainEventGenericCallback:
  * @conn: the connection pointer
@@ -374,3 +374,21 @@ adminServerUpdateTlsFiles(virNetServer *srv,
 
     return virNetServerUpdateTlsFiles(srv);
 }
+
+int
+adminServerGetStats(virNetServer *srv,
+                    virTypedParameterPtr *params,
+                    int *nparams,
+                    unsigned int flags)
+{
+    g_autoptr(virTypedParamList) paramlist = g_new0(virTypedParamList, 1);
+
+    virCheckFlags(0, -1);
+
+    if (virNetServerGetStats(srv, paramlist) < 0)
+        return -1;
+
+    *nparams = virTypedParamListStealParams(paramlist, params);
+
+    return 0;
+}
@@ -70,3 +70,8 @@ int adminServerSetClientLimits(virNetServer *srv,
 
 int adminServerUpdateTlsFiles(virNetServer *srv,
                               unsigned int flags);
+
+int adminServerGetStats(virNetServer *srv,
+                        virTypedParameterPtr *params,
+                        int *nparams,
+                        unsigned int flags);
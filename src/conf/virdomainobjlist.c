@@ -52,6 +52,9 @@ struct _virDomainObjList {
     /* name -> virDomainObj mapping for O(1),
      * lockless lookup-by-name */
     GHashTable *objsName;
+
+    /* whether configs may be parsed by multiple threads at once */
+    bool parallelLoad;
 };
 
 
@@ -81,6 +84,25 @@ virDomainObjList *virDomainObjListNew(void)
 }
 
 
+/**
+ * virDomainObjListSetParallelLoad:
+ * @doms: domain list
+ * @enable: whether to parse configs in parallel
+ *
+ * Lets virDomainObjListLoadAllConfigs() parse the XML files by multiple
+ * threads at once. Only drivers whose post parse callbacks are safe to
+ * run concurrently may enable this.
+ */
+void
+virDomainObjListSetParallelLoad(virDomainObjList *doms,
+                                bool enable)
+{
+    virObjectRWLockWrite(doms);
+    doms->parallelLoad = enable;
+    virObjectRWUnlock(doms);
+}
+
+
 static void virDomainObjListDispose(void *obj)
 {
     virDomainObjList *doms = obj;
@@ -478,78 +500,182 @@ virDomainObjListRename(virDomainObjList *doms,
 }
 
 
+/*
+ * Loading of domain configs is split into parsing, which is
+ * independent for each file and thus may be done in parallel by a
+ * couple of worker threads, and adding the results to the list, which
+ * is done serially.
+ */
+typedef struct _virDomainObjListLoadItem virDomainObjListLoadItem;
+struct _virDomainObjListLoadItem {
+    char *name;
+
+    /* Results of parsing, @obj in case of status XML, otherwise
+     * @def and @autostart */
+    virDomainObj *obj;
+    virDomainDef *def;
+    int autostart;
+};
+
+typedef struct _virDomainObjListLoadData virDomainObjListLoadData;
+struct _virDomainObjListLoadData {
+    const char *configDir;
+    const char *autostartDir;
+    bool liveStatus;
+    virDomainXMLOption *xmlopt;
+
+    virDomainObjListLoadItem *items;
+    size_t nitems;
+    int next; /* index of the next item to parse, atomic access only */
+};
+
+#define VIR_DOMAIN_OBJ_LIST_LOAD_MAX_WORKERS 16
+
+
+static int
+virDomainObjListParseConfig(virDomainObjListLoadData *data,
+                            virDomainObjListLoadItem *item)
+{
+    g_autofree char *configFile = NULL;
+    g_autofree char *autostartLink = NULL;
+    g_autoptr(virDomainDef) def = NULL;
+
+    if ((configFile = virDomainConfigFile(data->configDir, item->name)) == NULL)
+        return -1;
+    if (!(def = virDomainDefParseFile(configFile, data->xmlopt, NULL,
+                                      VIR_DOMAIN_DEF_PARSE_INACTIVE |
+                                      VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE |
+                                      VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL)))
+        return -1;
+
+    if ((autostartLink = virDomainConfigFile(data->autostartDir, item->name)) == NULL)
+        return -1;
+
+    if ((item->autostart = virFileLinkPointsTo(autostartLink, configFile)) < 0)
+        return -1;
+
+    item->def = g_steal_pointer(&def);
+    return 0;
+}
+
+
+static int
+virDomainObjListParseStatus(virDomainObjListLoadData *data,
+                            virDomainObjListLoadItem *item)
+{
+    g_autofree char *statusFile = NULL;
+
+    if ((statusFile = virDomainConfigFile(data->configDir, item->name)) == NULL)
+        return -1;
+
+    if (!(item->obj = virDomainObjParseFile(statusFile, data->xmlopt,
+                                            VIR_DOMAIN_DEF_PARSE_STATUS |
+                                            VIR_DOMAIN_DEF_PARSE_ACTUAL_NET |
+                                            VIR_DOMAIN_DEF_PARSE_PCI_ORIG_STATES |
+                                            VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE |
+                                            VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL)))
+        return -1;
+
+    /* The object is returned locked, but this may be a worker thread;
+     * it is locked again by the thread adding it to the list */
+    virObjectUnlock(item->obj);
+
+    return 0;
+}
+
+
+static void
+virDomainObjListParseWorker(void *opaque)
+{
+    virDomainObjListLoadData *data = opaque;
+    size_t i;
+
+    while ((i = g_atomic_int_add(&data->next, 1)) < data->nitems) {
+        virDomainObjListLoadItem *item = &data->items[i];
+
+        VIR_INFO("Loading config file '%s.xml'", item->name);
+        if (data->liveStatus)
+            ignore_value(virDomainObjListParseStatus(data, item));
+        else
+            ignore_value(virDomainObjListParseConfig(data, item));
+    }
+}
+
+
+static void
+virDomainObjListParseAll(virDomainObjListLoadData *data,
+                         bool parallel)
+{
+    g_autofree virThread *workers = NULL;
+    size_t nworkers = 1;
+    size_t i;
+
+    if (parallel)
+        nworkers = MIN(g_get_num_processors(),
+                       VIR_DOMAIN_OBJ_LIST_LOAD_MAX_WORKERS);
+
+    nworkers = MIN(nworkers, data->nitems);
+    if (nworkers > 1)
+        workers = g_new0(virThread, nworkers - 1);
+
+    /* The calling thread acts as one of the workers */
+    for (i = 0; i + 1 < nworkers; i++) {
+        if (virThreadCreateFull(&workers[i], true,
+                                virDomainObjListParseWorker,
+                                "dom-load", false, data) < 0) {
+            VIR_WARN("Failed to create domain config loading thread");
+            break;
+        }
+    }
+    nworkers = i;
+
+    virDomainObjListParseWorker(data);
+
+    for (i = 0; i < nworkers; i++)
+        virThreadJoin(&workers[i]);
+}
+
+
 static virDomainObj *
 virDomainObjListLoadConfig(virDomainObjList *doms,
                            virDomainXMLOption *xmlopt,
-                           const char *configDir,
-                           const char *autostartDir,
-                           const char *name,
+                           virDomainObjListLoadItem *item,
                            virDomainLoadConfigNotify notify,
                            void *opaque)
 {
-    char *configFile = NULL, *autostartLink = NULL;
-    virDomainDef *def = NULL;
     virDomainObj *dom;
-    int autostart;
     virDomainDef *oldDef = NULL;
 
-    if ((configFile = virDomainConfigFile(configDir, name)) == NULL)
-        goto error;
-    if (!(def = virDomainDefParseFile(configFile, xmlopt, NULL,
-                                      VIR_DOMAIN_DEF_PARSE_INACTIVE |
-                                      VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE |
-                                      VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL)))
-        goto error;
-
-    if ((autostartLink = virDomainConfigFile(autostartDir, name)) == NULL)
-        goto error;
-
-    if ((autostart = virFileLinkPointsTo(autostartLink, configFile)) < 0)
-        goto error;
+    if (!item->def)
+        return NULL;
 
-    if (!(dom = virDomainObjListAddLocked(doms, def, xmlopt, 0, &oldDef)))
-        goto error;
+    if (!(dom = virDomainObjListAddLocked(doms, item->def, xmlopt, 0, &oldDef)))
+        return NULL;
+    item->def = NULL;
 
-    dom->autostart = autostart;
+    dom->autostart = item->autostart;
 
     if (notify)
         (*notify)(dom, oldDef == NULL, opaque);
 
     virDomainDefFree(oldDef);
-    VIR_FREE(configFile);
-    VIR_FREE(autostartLink);
     return dom;
-
- error:
-    VIR_FREE(configFile);
-    VIR_FREE(autostartLink);
-    virDomainDefFree(def);
-    return NULL;
 }
 
 
 static virDomainObj *
 virDomainObjListLoadStatus(virDomainObjList *doms,
-                           const char *statusDir,
-                           const char *name,
-                           virDomainXMLOption *xmlopt,
+                           virDomainObjListLoadItem *item,
                            virDomainLoadConfigNotify notify,
                            void *opaque)
 {
-    char *statusFile = NULL;
-    virDomainObj *obj = NULL;
+    virDomainObj *obj = g_steal_pointer(&item->obj);
     char uuidstr[VIR_UUID_STRING_BUFLEN];
 
-    if ((statusFile = virDomainConfigFile(statusDir, name)) == NULL)
-        goto error;
+    if (!obj)
+        return NULL;
 
-    if (!(obj = virDomainObjParseFile(statusFile, xmlopt,
-                                      VIR_DOMAIN_DEF_PARSE_STATUS |
-                                      VIR_DOMAIN_DEF_PARSE_ACTUAL_NET |
-                                      VIR_DOMAIN_DEF_PARSE_PCI_ORIG_STATES |
-                                      VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE |
-                                      VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL)))
-        goto error;
+    virObjectLock(obj);
 
     virUUIDFormat(obj->def->uuid, uuidstr);
 
@@ -566,12 +692,10 @@ virDomainObjListLoadStatus(virDomainObjList *doms,
     if (notify)
         (*notify)(obj, 1, opaque);
 
-    VIR_FREE(statusFile);
     return obj;
 
  error:
     virDomainObjEndAPI(&obj);
-    VIR_FREE(statusFile);
     return NULL;
 }
 
@@ -587,6 +711,14 @@ virDomainObjListLoadAllConfigs(virDomainObjList *doms,
 {
     g_autoptr(DIR) dir = NULL;
     struct dirent *entry;
+    virDomainObjListLoadData data = {
+        .configDir = configDir,
+        .autostartDir = autostartDir,
+        .liveStatus = liveStatus,
+        .xmlopt = xmlopt,
+    };
+    bool parallel;
+    size_t i;
     int ret = -1;
     int rc;
 
@@ -595,42 +727,56 @@ virDomainObjListLoadAllConfigs(virDomainObjList *doms,
     if ((rc = virDirOpenIfExists(&dir, configDir)) <= 0)
         return rc;
 
-    virObjectRWLockWrite(doms);
-
     while ((ret = virDirRead(dir, &entry, configDir)) > 0) {
-        virDomainObj *dom;
+        virDomainObjListLoadItem item = { 0 };
 
         if (!virStringStripSuffix(entry->d_name, ".xml"))
             continue;
 
+        item.name = g_strdup(entry->d_name);
+        VIR_APPEND_ELEMENT(data.items, data.nitems, item);
+    }
+
+    virObjectRWLockRead(doms);
+    parallel = doms->parallelLoad;
+    virObjectRWUnlock(doms);
+
+    /* Parsing doesn't touch the list, so it's done without holding its
+     * lock. Adding the results below checks again for domains with the
+     * same name or UUID which may have appeared meanwhile. */
+    virDomainObjListParseAll(&data, parallel);
+
+    virObjectRWLockWrite(doms);
+
+    for (i = 0; i < data.nitems; i++) {
+        virDomainObjListLoadItem *item = &data.items[i];
+        virDomainObj *dom;
+
         /* NB: ignoring errors, so one malformed config doesn't
            kill the whole process */
-        VIR_INFO("Loading config file '%s.xml'", entry->d_name);
         if (liveStatus)
-            dom = virDomainObjListLoadStatus(doms,
-                                             configDir,
-                                             entry->d_name,
-                                             xmlopt,
-                                             notify,
-                                             opaque);
+            dom = virDomainObjListLoadStatus(doms, item, notify, opaque);
         else
-            dom = virDomainObjListLoadConfig(doms,
-                                             xmlopt,
-                                             configDir,
-                                             autostartDir,
-                                             entry->d_name,
-                                             notify,
-                                             opaque);
+            dom = virDomainObjListLoadConfig(doms, xmlopt, item, notify, opaque);
+
         if (dom) {
             if (!liveStatus)
                 dom->persistent = 1;
             virDomainObjEndAPI(&dom);
         } else {
-            VIR_ERROR(_("Failed to load config for domain '%s'"), entry->d_name);
+            VIR_ERROR(_("Failed to load config for domain '%s'"), item->name);
         }
     }
 
     virObjectRWUnlock(doms);
+
+    for (i = 0; i < data.nitems; i++) {
+        g_free(data.items[i].name);
+        virDomainDefFree(data.items[i].def);
+        virObjectUnref(data.items[i].obj);
+    }
+    g_free(data.items);
+
     return ret;
 }
 
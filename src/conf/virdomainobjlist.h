@@ -28,6 +28,9 @@ typedef struct _virDomainObjList virDomainObjList;
 
 virDomainObjList *virDomainObjListNew(void);
 
+void virDomainObjListSetParallelLoad(virDomainObjList *doms,
+                                     bool enable);
+
 virDomainObj *virDomainObjListFindByID(virDomainObjList *doms,
                                          int id);
 virDomainObj *virDomainObjListFindByUUID(virDomainObjList *doms,
@@ -8962,6 +8962,11 @@ virDomainGetJobInfo(virDomainPtr domain, virDomainJobInfoPtr info)
  * obtained by listening to a VIR_DOMAIN_EVENT_ID_JOB_COMPLETED event (on the
  * source host in case of a migration job).
  *
+ * Per-disk statistics of a migration which copies storage using separate
+ * mirror jobs (the VIR_DOMAIN_JOB_DISK_MIRROR_* fields) are only returned
+ * when @flags contains VIR_DOMAIN_JOB_STATS_DISK_MIRRORS. The completed job
+ * event never contains them.
+ *
  * Returns 0 in case of success and -1 in case of failure.
  */
 int
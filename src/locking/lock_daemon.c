@@ -290,6 +290,66 @@ int virLockDaemonAddLockSpace(virLockDaemon *lockd,
     return ret;
 }
 
+static void
+virLockDaemonAddStats(virLockSpaceStats *total,
+                      virLockSpace *lockspace)
+{
+    virLockSpaceStats stats;
+
+    virLockSpaceGetStats(lockspace, &stats);
+
+    total->resources += stats.resources;
+    total->owners += stats.owners;
+    total->acquired += stats.acquired;
+    total->busy += stats.busy;
+    total->released += stats.released;
+    total->holdTime += stats.holdTime;
+    total->holdTimeMax = MAX(total->holdTimeMax, stats.holdTimeMax);
+}
+
+
+static int
+virLockDaemonGetStats(virNetServer *srv G_GNUC_UNUSED,
+                      virTypedParamList *params,
+                      void *opaque)
+{
+    virLockDaemon *lockd = opaque;
+    virLockSpaceStats total = { 0 };
+    g_autofree virHashKeyValuePair *pairs = NULL;
+    virHashKeyValuePair *tmp;
+    unsigned int nlockspaces = 1;
+
+    virLockDaemonLock(lockd);
+    virLockDaemonAddStats(&total, lockd->defaultLockspace);
+    pairs = virHashGetItems(lockd->lockspaces, NULL, false);
+    for (tmp = pairs; tmp && tmp->value; tmp++) {
+        virLockDaemonAddStats(&total, (virLockSpace *)tmp->value);
+        nlockspaces++;
+    }
+    virLockDaemonUnlock(lockd);
+
+    if (virTypedParamListAddUInt(params, nlockspaces, "%s",
+                                 VIR_SERVER_STATS_LOCK_LOCKSPACES) < 0 ||
+        virTypedParamListAddULLong(params, total.resources, "%s",
+                                   VIR_SERVER_STATS_LOCK_RESOURCES) < 0 ||
+        virTypedParamListAddULLong(params, total.owners, "%s",
+                                   VIR_SERVER_STATS_LOCK_OWNERS) < 0 ||
+        virTypedParamListAddULLong(params, total.acquired, "%s",
+                                   VIR_SERVER_STATS_LOCK_ACQUIRED) < 0 ||
+        virTypedParamListAddULLong(params, total.busy, "%s",
+                                   VIR_SERVER_STATS_LOCK_BUSY) < 0 ||
+        virTypedParamListAddULLong(params, total.released, "%s",
+                                   VIR_SERVER_STATS_LOCK_RELEASED) < 0 ||
+        virTypedParamListAddULLong(params, total.holdTime, "%s",
+                                   VIR_SERVER_STATS_LOCK_HOLD_TIME) < 0 ||
+        virTypedParamListAddULLong(params, total.holdTimeMax, "%s",
+                                   VIR_SERVER_STATS_LOCK_HOLD_TIME_MAX) < 0)
+        return -1;
+
+    return 0;
+}
+
+
 virLockSpace *virLockDaemonFindLockSpace(virLockDaemon *lockd,
                                            const char *path)
 {
@@ -1107,6 +1167,8 @@ int main(int argc, char **argv) {
         goto cleanup;
     }
 
+    virNetServerSetStatsCallback(lockSrv, virLockDaemonGetStats, lockDaemon);
+
     if (adminSrv != NULL) {
         if (!(adminProgram = virNetServerProgramNew(ADMIN_PROGRAM,
                                                     ADMIN_PROTOCOL_VERSION,
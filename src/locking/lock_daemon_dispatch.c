@@ -95,6 +95,156 @@ virLockSpaceProtocolDispatchAcquireResource(virNetServer *server G_GNUC_UNUSED,
 }
 
 
+static int
+virLockDaemonResourceCompare(const void *a,
+                             const void *b)
+{
+    const virLockSpaceProtocolResource *ra = *(virLockSpaceProtocolResource * const *)a;
+    const virLockSpaceProtocolResource *rb = *(virLockSpaceProtocolResource * const *)b;
+    int rc;
+
+    if ((rc = strcmp(ra->path, rb->path)) != 0)
+        return rc;
+
+    return strcmp(ra->name, rb->name);
+}
+
+
+/*
+ * Makes one attempt at acquiring all of @res, which are sorted by
+ * lockspace path and resource name. Resources of one lockspace are
+ * acquired at once. On failure only the resources acquired by this
+ * call are released again, in the lockspaces they were acquired from,
+ * so that a caller never holds a lock while waiting for another one
+ * and locks it held before are left alone.
+ */
+static int
+virLockDaemonAcquireResources(virLockSpaceProtocolResource **res,
+                              size_t nres,
+                              pid_t owner)
+{
+    g_autofree const char **names = g_new0(const char *, nres);
+    g_autofree unsigned int *flags = g_new0(unsigned int, nres);
+    g_autofree virLockSpace **acquired = g_new0(virLockSpace *, nres);
+    size_t start = 0;
+    size_t i;
+
+    while (start < nres) {
+        virLockSpace *lockspace;
+        size_t end;
+
+        for (end = start; end < nres; end++) {
+            if (STRNEQ(res[end]->path, res[start]->path))
+                break;
+
+            names[end - start] = res[end]->name;
+            flags[end - start] = 0;
+            if (res[end]->flags & VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED)
+                flags[end - start] |= VIR_LOCK_SPACE_ACQUIRE_SHARED;
+            if (res[end]->flags & VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE)
+                flags[end - start] |= VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE;
+        }
+
+        if (!(lockspace = virLockDaemonFindLockSpace(lockDaemon, res[start]->path))) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Lockspace for path %s does not exist"),
+                           res[start]->path);
+            goto error;
+        }
+
+        for (i = start; i < end; i++) {
+            if (res[i]->flags & ~(VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED |
+                                  VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE)) {
+                virReportError(VIR_ERR_INVALID_ARG,
+                               _("unsupported flags (0x%x) for resource '%s'"),
+                               res[i]->flags, res[i]->name);
+                goto error;
+            }
+        }
+
+        /* Either all resources of the lockspace are acquired or none */
+        if (virLockSpaceAcquireResources(lockspace, end - start,
+                                         names, flags, owner) < 0)
+            goto error;
+
+        for (i = start; i < end; i++)
+            acquired[i] = lockspace;
+
+        start = end;
+    }
+
+    return 0;
+
+ error:
+    {
+        virErrorPtr origerr;
+
+        virErrorPreserveLast(&origerr);
+        /* Each release drops a single hold of @owner, so a shared
+         * resource it held before this call stays held */
+        for (i = nres; i-- > 0;) {
+            if (acquired[i])
+                virLockSpaceReleaseResource(acquired[i], res[i]->name, owner);
+        }
+        virErrorRestore(&origerr);
+    }
+    return -1;
+}
+
+
+static int
+virLockSpaceProtocolDispatchAcquireResources(virNetServer *server G_GNUC_UNUSED,
+                                             virNetServerClient *client,
+                                             virNetMessage *msg G_GNUC_UNUSED,
+                                             struct virNetMessageError *rerr,
+                                             virLockSpaceProtocolAcquireResourcesArgs *args)
+{
+    int rv = -1;
+    unsigned int flags = args->flags;
+    virLockDaemonClient *priv =
+        virNetServerClientGetPrivateData(client);
+    g_autofree virLockSpaceProtocolResource **res = NULL;
+    size_t nres = args->resources.resources_len;
+    size_t i;
+
+    g_mutex_lock(&priv->lock);
+
+    virCheckFlagsGoto(0, cleanup);
+
+    if (priv->restricted) {
+        virReportError(VIR_ERR_OPERATION_DENIED, "%s",
+                       _("lock manager connection has been restricted"));
+        goto cleanup;
+    }
+
+    if (!priv->ownerId) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("lock owner details have not been registered"));
+        goto cleanup;
+    }
+
+    /* Acquire in a globally consistent order, so that two clients
+     * asking for overlapping sets can't starve each other forever.
+     * Busy resources are never waited for here, as that would stall
+     * every other client; retrying is up to the caller. */
+    res = g_new0(virLockSpaceProtocolResource *, nres);
+    for (i = 0; i < nres; i++)
+        res[i] = &args->resources.resources_val[i];
+    qsort(res, nres, sizeof(*res), virLockDaemonResourceCompare);
+
+    if (virLockDaemonAcquireResources(res, nres, priv->ownerPid) < 0)
+        goto cleanup;
+
+    rv = 0;
+
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    g_mutex_unlock(&priv->lock);
+    return rv;
+}
+
+
 static int
 virLockSpaceProtocolDispatchCreateResource(virNetServer *server G_GNUC_UNUSED,
                                            virNetServerClient *client,
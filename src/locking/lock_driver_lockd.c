@@ -71,6 +71,8 @@ struct _virLockManagerLockDaemonPrivate {
 struct _virLockManagerLockDaemonDriver {
     bool autoDiskLease;
     bool requireLeaseForDisks;
+    unsigned int acquireTimeout;
+    bool noBatchAcquire;
 
     char *fileLockSpaceDir;
     char *lvmLockSpaceDir;
@@ -79,6 +81,9 @@ struct _virLockManagerLockDaemonDriver {
 
 static virLockManagerLockDaemonDriver *driver;
 
+/* Upper bound on how long busy resources are retried */
+#define VIR_LOCK_MANAGER_LOCK_DAEMON_ACQUIRE_TIMEOUT_MAX (60 * 1000)
+
 static int virLockManagerLockDaemonLoadConfig(const char *configFile)
 {
     g_autoptr(virConf) conf = NULL;
@@ -112,6 +117,9 @@ static int virLockManagerLockDaemonLoadConfig(const char *configFile)
     if (virConfGetValueBool(conf, "require_lease_for_disks", &driver->requireLeaseForDisks) < 0)
         return -1;
 
+    if (virConfGetValueUInt(conf, "acquire_timeout", &driver->acquireTimeout) < 0)
+        return -1;
+
     return 0;
 }
 
@@ -294,6 +302,50 @@ static int virLockManagerLockDaemonSetupLockspace(const char *path)
 }
 
 
+/*
+ * Finds out whether virtlockd knows the ACQUIRE_RESOURCES procedure.
+ * Resources are usually acquired in a child process which is about
+ * to exec the guest, so this is done upfront in the daemon itself
+ * for the answer to be inherited by every child. An unregistered
+ * connection is refused by a daemon which knows the procedure,
+ * whereas an older one doesn't know the procedure at all.
+ */
+static void virLockManagerLockDaemonProbeBatchAcquire(void)
+{
+    virNetClient *client;
+    virNetClientProgram *program = NULL;
+    virLockSpaceProtocolAcquireResourcesArgs args;
+    int counter = 0;
+
+    memset(&args, 0, sizeof(args));
+
+    if (!(client = virLockManagerLockDaemonConnectionNew(geteuid() == 0, &program))) {
+        VIR_DEBUG("Unable to probe virtlockd: %s", virGetLastErrorMessage());
+        virResetLastError();
+        return;
+    }
+
+    if (virNetClientProgramCall(program,
+                                client,
+                                counter++,
+                                VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCES,
+                                0, NULL, NULL, NULL,
+                                (xdrproc_t)xdr_virLockSpaceProtocolAcquireResourcesArgs, &args,
+                                (xdrproc_t)xdr_void, NULL) < 0) {
+        if (virGetLastErrorCode() == VIR_ERR_RPC) {
+            VIR_DEBUG("virtlockd doesn't support batch acquire: %s",
+                      virGetLastErrorMessage());
+            driver->noBatchAcquire = true;
+        }
+        virResetLastError();
+    }
+
+    virObjectUnref(program);
+    virNetClientClose(client);
+    virObjectUnref(client);
+}
+
+
 static int virLockManagerLockDaemonDeinit(void);
 
 static int virLockManagerLockDaemonInit(unsigned int version,
@@ -329,6 +381,8 @@ static int virLockManagerLockDaemonInit(unsigned int version,
             goto error;
     }
 
+    virLockManagerLockDaemonProbeBatchAcquire();
+
     return 0;
 
  error:
@@ -650,6 +704,115 @@ static int virLockManagerLockDaemonAddResource(virLockManager *lock,
 }
 
 
+static int
+virLockManagerLockDaemonAcquireResourcesOneByOne(virLockManager *lock,
+                                                 virNetClient *client,
+                                                 virNetClientProgram *program,
+                                                 int *counter)
+{
+    virLockManagerLockDaemonPrivate *priv = lock->privateData;
+    size_t i;
+
+    for (i = 0; i < priv->nresources; i++) {
+        virLockSpaceProtocolAcquireResourceArgs args;
+
+        memset(&args, 0, sizeof(args));
+
+        args.path = priv->resources[i].lockspace;
+        args.name = priv->resources[i].name;
+        args.flags = priv->resources[i].flags;
+
+        if (virNetClientProgramCall(program,
+                                    client,
+                                    (*counter)++,
+                                    VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCE,
+                                    0, NULL, NULL, NULL,
+                                    (xdrproc_t)xdr_virLockSpaceProtocolAcquireResourceArgs, &args,
+                                    (xdrproc_t)xdr_void, NULL) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Acquires all resources in a single round trip to virtlockd, which
+ * takes care of doing so in a deadlock free order. virtlockd never
+ * waits for busy resources, so if acquire_timeout is set the request
+ * is repeated with an exponential backoff until it expires. Falls
+ * back to acquiring resources one by one when talking to an older
+ * daemon.
+ */
+static int
+virLockManagerLockDaemonAcquireResources(virLockManager *lock,
+                                         virNetClient *client,
+                                         virNetClientProgram *program,
+                                         int *counter)
+{
+    virLockManagerLockDaemonPrivate *priv = lock->privateData;
+    virLockSpaceProtocolAcquireResourcesArgs args;
+    g_autofree virLockSpaceProtocolResource *res = NULL;
+    unsigned long long sleepus = 1000;
+    gint64 deadline;
+    size_t i;
+
+    if (driver->noBatchAcquire ||
+        priv->nresources > VIR_LOCK_SPACE_PROTOCOL_RESOURCES_MAX)
+        return virLockManagerLockDaemonAcquireResourcesOneByOne(lock, client,
+                                                                program, counter);
+
+    res = g_new0(virLockSpaceProtocolResource, priv->nresources);
+    for (i = 0; i < priv->nresources; i++) {
+        res[i].path = priv->resources[i].lockspace;
+        res[i].name = priv->resources[i].name;
+        res[i].flags = priv->resources[i].flags;
+    }
+
+    memset(&args, 0, sizeof(args));
+    args.resources.resources_len = priv->nresources;
+    args.resources.resources_val = res;
+
+    deadline = g_get_monotonic_time() +
+        MIN(driver->acquireTimeout,
+            VIR_LOCK_MANAGER_LOCK_DAEMON_ACQUIRE_TIMEOUT_MAX) * 1000ll;
+
+    while (virNetClientProgramCall(program,
+                                   client,
+                                   (*counter)++,
+                                   VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCES,
+                                   0, NULL, NULL, NULL,
+                                   (xdrproc_t)xdr_virLockSpaceProtocolAcquireResourcesArgs, &args,
+                                   (xdrproc_t)xdr_void, NULL) < 0) {
+        gint64 now = g_get_monotonic_time();
+
+        /* Nothing is held after a failed request, so it's safe to retry */
+        if (virGetLastErrorCode() == VIR_ERR_RESOURCE_BUSY && now < deadline) {
+            VIR_DEBUG("Some resources are busy, retrying in %lluus", sleepus);
+            virResetLastError();
+            g_usleep(MIN(sleepus, deadline - now));
+            sleepus = MIN(sleepus * 2, 100 * 1000);
+            continue;
+        }
+
+        /* virtlockd which predates the procedure replies with
+         * an RPC error and leaves the connection open */
+        if (virGetLastErrorCode() != VIR_ERR_RPC)
+            return -1;
+
+        VIR_DEBUG("virtlockd doesn't support batch acquire: %s",
+                  virGetLastErrorMessage());
+        virResetLastError();
+        driver->noBatchAcquire = true;
+
+        return virLockManagerLockDaemonAcquireResourcesOneByOne(lock, client,
+                                                                program, counter);
+    }
+
+    return 0;
+}
+
+
 static int virLockManagerLockDaemonAcquire(virLockManager *lock,
                                            const char *state G_GNUC_UNUSED,
                                            unsigned int flags,
@@ -680,27 +843,10 @@ static int virLockManagerLockDaemonAcquire(virLockManager *lock,
         (*fd = virNetClientDupFD(client, false)) < 0)
         goto cleanup;
 
-    if (!(flags & VIR_LOCK_MANAGER_ACQUIRE_REGISTER_ONLY)) {
-        size_t i;
-        for (i = 0; i < priv->nresources; i++) {
-            virLockSpaceProtocolAcquireResourceArgs args;
-
-            memset(&args, 0, sizeof(args));
-
-            args.path = priv->resources[i].lockspace;
-            args.name = priv->resources[i].name;
-            args.flags = priv->resources[i].flags;
-
-            if (virNetClientProgramCall(program,
-                                        client,
-                                        counter++,
-                                        VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCE,
-                                        0, NULL, NULL, NULL,
-                                        (xdrproc_t)xdr_virLockSpaceProtocolAcquireResourceArgs, &args,
-                                        (xdrproc_t)xdr_void, NULL) < 0)
-                goto cleanup;
-        }
-    }
+    if (!(flags & VIR_LOCK_MANAGER_ACQUIRE_REGISTER_ONLY) &&
+        priv->nresources > 0 &&
+        virLockManagerLockDaemonAcquireResources(lock, client, program, &counter) < 0)
+        goto cleanup;
 
     if ((flags & VIR_LOCK_MANAGER_ACQUIRE_RESTRICT) &&
         virLockManagerLockDaemonConnectionRestrict(lock, client, program, &counter) < 0)
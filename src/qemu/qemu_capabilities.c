@@ -680,9 +680,10 @@ struct _virQEMUCapsAccel {
 
 
 /*
- * Update the XML parser/formatter when adding more
- * information to this struct so that it gets cached
- * correctly. It does not have to be ABI-stable, as
+ * Update the XML parser/formatter as well as the binary cache
+ * (virQEMUCapsFormatCacheBinary and virQEMUCapsLoadCacheBinary)
+ * when adding more information to this struct so that it gets
+ * cached correctly. It does not have to be ABI-stable, as
  * the cache will be discarded & repopulated if the
  * timestamp on the libvirtd binary changes.
  *
@@ -1108,8 +1109,90 @@ virQEMUCapsProbeHostCPU(virArch hostArch,
 }
 
 
+struct virQEMUCapsPrefetchData {
+    virFileCache *cache;
+    char **binaries;
+    size_t nbinaries;
+    int next; /* atomic access only */
+};
+
+
+static void
+virQEMUCapsPrefetchWorker(void *opaque)
+{
+    struct virQEMUCapsPrefetchData *data = opaque;
+    size_t i;
+
+    while ((i = g_atomic_int_add(&data->next, 1)) < data->nbinaries) {
+        virQEMUCaps *qemuCaps;
+
+        if (!(qemuCaps = virQEMUCapsCacheLookup(data->cache, data->binaries[i])))
+            virResetLastError();
+
+        virObjectUnref(qemuCaps);
+    }
+}
+
+
+/*
+ * Make sure capabilities of all emulators which are going to be looked up
+ * by virQEMUCapsInit are in @cache. Emulators missing there are probed
+ * by up to @maxParallel threads rather than one by one.
+ */
+static void
+virQEMUCapsPrefetch(virFileCache *cache,
+                    virArch hostarch,
+                    unsigned int maxParallel)
+{
+    struct virQEMUCapsPrefetchData data = { .cache = cache };
+    g_autofree virThread *workers = NULL;
+    size_t nworkers;
+    size_t i;
+
+    if (maxParallel <= 1)
+        return;
+
+    for (i = 0; i < VIR_ARCH_LAST; i++) {
+        char *binary = virQEMUCapsGetDefaultEmulator(hostarch, i);
+
+        if (!binary)
+            continue;
+
+        if (data.binaries && g_strv_contains((const char **)data.binaries, binary)) {
+            g_free(binary);
+            continue;
+        }
+
+        VIR_REALLOC_N(data.binaries, data.nbinaries + 2);
+        data.binaries[data.nbinaries++] = binary;
+        data.binaries[data.nbinaries] = NULL;
+    }
+
+    nworkers = MIN(data.nbinaries, maxParallel);
+
+    if (nworkers > 1) {
+        workers = g_new0(virThread, nworkers);
+
+        for (i = 0; i < nworkers; i++) {
+            if (virThreadCreateFull(&workers[i], true, virQEMUCapsPrefetchWorker,
+                                    "qemu-caps-probe", false, &data) < 0) {
+                virResetLastError();
+                break;
+            }
+        }
+        nworkers = i;
+
+        for (i = 0; i < nworkers; i++)
+            virThreadJoin(&workers[i]);
+    }
+
+    g_strfreev(data.binaries);
+}
+
+
 virCaps *
-virQEMUCapsInit(virFileCache *cache)
+virQEMUCapsInit(virFileCache *cache,
+                unsigned int probeMaxParallel)
 {
     g_autoptr(virCaps) caps = NULL;
     size_t i;
@@ -1137,6 +1220,8 @@ virQEMUCapsInit(virFileCache *cache)
     virCapabilitiesAddHostMigrateTransport(caps, "tcp");
     virCapabilitiesAddHostMigrateTransport(caps, "rdma");
 
+    virQEMUCapsPrefetch(cache, hostarch, probeMaxParallel);
+
     /* QEMU can support pretty much every arch that exists,
      * so just probe for them all - we gracefully fail
      * if a qemu-system-$ARCH binary can't be found
@@ -4046,10 +4131,16 @@ struct _virQEMUCapsCachePriv {
     uid_t runUid;
     gid_t runGid;
     virArch hostArch;
-    unsigned int microcodeVersion;
     char *kernelVersion;
     char *hostCPUSignature;
 
+    /* Handlers of the cache run concurrently for different binaries, the
+     * lock protects the members below which are updated after the cache
+     * was created. */
+    virMutex lock;
+
+    unsigned int microcodeVersion;
+
     /* cache whether /dev/kvm is usable as runUid:runGuid */
     virTristateBool kvmUsable;
     time_t kvmCtime;
@@ -4065,6 +4156,7 @@ virQEMUCapsCachePrivFree(void *privData)
     g_free(priv->libDir);
     g_free(priv->kernelVersion);
     g_free(priv->hostCPUSignature);
+    virMutexDestroy(&priv->lock);
     g_free(priv);
 }
 
@@ -4627,6 +4719,550 @@ virQEMUCapsFormatCache(virQEMUCaps *qemuCaps)
 }
 
 
+/*
+ * Binary form of the capabilities cache
+ *
+ * The XML cache is kept for debugging and as a fallback, but loading it
+ * means parsing a large document on every daemon start. The binary form
+ * stores the same data as a flat sequence of native-endian integers and
+ * length-prefixed strings which can be read straight from a mapped file.
+ * Since the cache is discarded whenever libvirt changes, enum values are
+ * stored as they are and there is no need for backward compatibility
+ * beyond the format version.
+ */
+#define QEMU_CAPS_BIN_MAGIC "LIBVIRT-QEMUCAPS"
+#define QEMU_CAPS_BIN_VERSION 1
+#define QEMU_CAPS_BIN_BYTEORDER 0x01020304
+
+typedef struct _virQEMUCapsBinReader virQEMUCapsBinReader;
+struct _virQEMUCapsBinReader {
+    const char *data;
+    size_t len;
+    size_t pos;
+    bool error;
+};
+
+
+static void
+virQEMUCapsBinWriteU32(GByteArray *buf,
+                       uint32_t val)
+{
+    g_byte_array_append(buf, (const guint8 *)&val, sizeof(val));
+}
+
+
+static void
+virQEMUCapsBinWriteI64(GByteArray *buf,
+                       int64_t val)
+{
+    g_byte_array_append(buf, (const guint8 *)&val, sizeof(val));
+}
+
+
+/* Strings are stored as their length + 1 followed by the characters,
+ * zero length means NULL. */
+static void
+virQEMUCapsBinWriteString(GByteArray *buf,
+                          const char *str)
+{
+    size_t len = str ? strlen(str) : 0;
+
+    virQEMUCapsBinWriteU32(buf, str ? len + 1 : 0);
+    if (str)
+        g_byte_array_append(buf, (const guint8 *)str, len);
+}
+
+
+static const void *
+virQEMUCapsBinRead(virQEMUCapsBinReader *reader,
+                   size_t len)
+{
+    const void *ret;
+
+    if (reader->error || reader->len - reader->pos < len) {
+        reader->error = true;
+        return NULL;
+    }
+
+    ret = reader->data + reader->pos;
+    reader->pos += len;
+    return ret;
+}
+
+
+static uint32_t
+virQEMUCapsBinReadU32(virQEMUCapsBinReader *reader)
+{
+    const void *ptr = virQEMUCapsBinRead(reader, sizeof(uint32_t));
+    uint32_t val = 0;
+
+    if (ptr)
+        memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+
+
+static int64_t
+virQEMUCapsBinReadI64(virQEMUCapsBinReader *reader)
+{
+    const void *ptr = virQEMUCapsBinRead(reader, sizeof(int64_t));
+    int64_t val = 0;
+
+    if (ptr)
+        memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+
+
+static char *
+virQEMUCapsBinReadString(virQEMUCapsBinReader *reader)
+{
+    uint32_t len = virQEMUCapsBinReadU32(reader);
+    const char *str;
+
+    if (len == 0)
+        return NULL;
+
+    if (!(str = virQEMUCapsBinRead(reader, len - 1)))
+        return NULL;
+
+    return g_strndup(str, len - 1);
+}
+
+
+/* Reads a string which must not be NULL */
+static char *
+virQEMUCapsBinReadName(virQEMUCapsBinReader *reader)
+{
+    char *str = virQEMUCapsBinReadString(reader);
+
+    if (!str)
+        reader->error = true;
+    return str;
+}
+
+
+static void
+virQEMUCapsFormatBinAccel(virQEMUCapsAccel *caps,
+                          GByteArray *buf)
+{
+    qemuMonitorCPUModelInfo *model = caps->hostCPU.info;
+    size_t i;
+
+    virQEMUCapsBinWriteU32(buf, !!model);
+    if (model) {
+        virQEMUCapsBinWriteString(buf, model->name);
+        virQEMUCapsBinWriteU32(buf, model->migratability);
+        virQEMUCapsBinWriteU32(buf, model->nprops);
+
+        for (i = 0; i < model->nprops; i++) {
+            qemuMonitorCPUProperty *prop = model->props + i;
+
+            virQEMUCapsBinWriteString(buf, prop->name);
+            virQEMUCapsBinWriteU32(buf, prop->type);
+            virQEMUCapsBinWriteU32(buf, prop->migratable);
+
+            switch (prop->type) {
+            case QEMU_MONITOR_CPU_PROPERTY_BOOLEAN:
+                virQEMUCapsBinWriteU32(buf, prop->value.boolean);
+                break;
+
+            case QEMU_MONITOR_CPU_PROPERTY_STRING:
+                virQEMUCapsBinWriteString(buf, prop->value.string);
+                break;
+
+            case QEMU_MONITOR_CPU_PROPERTY_NUMBER:
+                virQEMUCapsBinWriteI64(buf, prop->value.number);
+                break;
+
+            case QEMU_MONITOR_CPU_PROPERTY_LAST:
+                break;
+            }
+        }
+    }
+
+    virQEMUCapsBinWriteU32(buf, caps->cpuModels ? caps->cpuModels->ncpus : 0);
+    for (i = 0; caps->cpuModels && i < caps->cpuModels->ncpus; i++) {
+        qemuMonitorCPUDefInfo *cpu = caps->cpuModels->cpus + i;
+        size_t nblockers = cpu->blockers ? g_strv_length(cpu->blockers) : 0;
+        size_t j;
+
+        virQEMUCapsBinWriteString(buf, cpu->name);
+        virQEMUCapsBinWriteString(buf, cpu->type);
+        virQEMUCapsBinWriteU32(buf, cpu->usable);
+        virQEMUCapsBinWriteU32(buf, cpu->deprecated);
+        virQEMUCapsBinWriteU32(buf, !!cpu->blockers);
+        virQEMUCapsBinWriteU32(buf, nblockers);
+        for (j = 0; j < nblockers; j++)
+            virQEMUCapsBinWriteString(buf, cpu->blockers[j]);
+    }
+
+    virQEMUCapsBinWriteU32(buf, caps->nmachineTypes);
+    for (i = 0; i < caps->nmachineTypes; i++) {
+        virQEMUCapsMachineType *machine = caps->machineTypes + i;
+
+        virQEMUCapsBinWriteString(buf, machine->name);
+        virQEMUCapsBinWriteString(buf, machine->alias);
+        virQEMUCapsBinWriteU32(buf, machine->maxCpus);
+        virQEMUCapsBinWriteU32(buf, machine->hotplugCpus);
+        virQEMUCapsBinWriteU32(buf, machine->qemuDefault);
+        virQEMUCapsBinWriteString(buf, machine->defaultCPU);
+        virQEMUCapsBinWriteU32(buf, machine->numaMemSupported);
+        virQEMUCapsBinWriteString(buf, machine->defaultRAMid);
+        virQEMUCapsBinWriteU32(buf, machine->deprecated);
+    }
+}
+
+
+/**
+ * virQEMUCapsFormatCacheBinary:
+ * @qemuCaps: capabilities
+ *
+ * Stores @qemuCaps in the binary form of the capabilities cache.
+ *
+ * Returns the binary data, the caller must free it using g_byte_array_unref.
+ */
+GByteArray *
+virQEMUCapsFormatCacheBinary(virQEMUCaps *qemuCaps)
+{
+    GByteArray *buf = g_byte_array_new();
+    size_t nflags = 0;
+    size_t i;
+
+    g_byte_array_append(buf, (const guint8 *)QEMU_CAPS_BIN_MAGIC,
+                        strlen(QEMU_CAPS_BIN_MAGIC));
+    virQEMUCapsBinWriteU32(buf, QEMU_CAPS_BIN_VERSION);
+    virQEMUCapsBinWriteU32(buf, QEMU_CAPS_BIN_BYTEORDER);
+
+    virQEMUCapsBinWriteI64(buf, qemuCaps->libvirtCtime);
+    virQEMUCapsBinWriteU32(buf, qemuCaps->libvirtVersion);
+
+    virQEMUCapsBinWriteString(buf, qemuCaps->binary);
+    virQEMUCapsBinWriteI64(buf, qemuCaps->ctime);
+    virQEMUCapsBinWriteI64(buf, qemuCaps->modDirMtime);
+
+    for (i = 0; i < QEMU_CAPS_LAST; i++) {
+        if (virQEMUCapsGet(qemuCaps, i))
+            nflags++;
+    }
+    virQEMUCapsBinWriteU32(buf, nflags);
+    for (i = 0; i < QEMU_CAPS_LAST; i++) {
+        if (virQEMUCapsGet(qemuCaps, i))
+            virQEMUCapsBinWriteU32(buf, i);
+    }
+
+    virQEMUCapsBinWriteU32(buf, qemuCaps->version);
+    virQEMUCapsBinWriteU32(buf, qemuCaps->kvmVersion);
+    virQEMUCapsBinWriteU32(buf, qemuCaps->microcodeVersion);
+    virQEMUCapsBinWriteString(buf, qemuCaps->hostCPUSignature);
+    virQEMUCapsBinWriteString(buf, qemuCaps->package);
+    virQEMUCapsBinWriteString(buf, qemuCaps->kernelVersion);
+    virQEMUCapsBinWriteU32(buf, qemuCaps->arch);
+
+    virQEMUCapsFormatBinAccel(&qemuCaps->kvm, buf);
+    virQEMUCapsFormatBinAccel(&qemuCaps->tcg, buf);
+
+    virQEMUCapsBinWriteU32(buf, qemuCaps->ngicCapabilities);
+    for (i = 0; i < qemuCaps->ngicCapabilities; i++) {
+        virQEMUCapsBinWriteU32(buf, qemuCaps->gicCapabilities[i].version);
+        virQEMUCapsBinWriteU32(buf, qemuCaps->gicCapabilities[i].implementation);
+    }
+
+    virQEMUCapsBinWriteU32(buf, !!qemuCaps->sevCapabilities);
+    if (qemuCaps->sevCapabilities) {
+        virQEMUCapsBinWriteU32(buf, qemuCaps->sevCapabilities->cbitpos);
+        virQEMUCapsBinWriteU32(buf, qemuCaps->sevCapabilities->reduced_phys_bits);
+        virQEMUCapsBinWriteString(buf, qemuCaps->sevCapabilities->pdh);
+        virQEMUCapsBinWriteString(buf, qemuCaps->sevCapabilities->cert_chain);
+    }
+
+    virQEMUCapsBinWriteU32(buf, qemuCaps->kvmSupportsNesting);
+    virQEMUCapsBinWriteU32(buf, qemuCaps->kvmSupportsSecureGuest);
+
+    return buf;
+}
+
+
+static void
+virQEMUCapsLoadBinAccel(virQEMUCapsAccel *caps,
+                        virQEMUCapsBinReader *reader)
+{
+    size_t n;
+    size_t i;
+
+    if (virQEMUCapsBinReadU32(reader)) {
+        g_autoptr(qemuMonitorCPUModelInfo) model = g_new0(qemuMonitorCPUModelInfo, 1);
+
+        model->name = virQEMUCapsBinReadName(reader);
+        model->migratability = virQEMUCapsBinReadU32(reader);
+        n = virQEMUCapsBinReadU32(reader);
+        if (reader->error || n > reader->len)
+            goto error;
+
+        model->props = g_new0(qemuMonitorCPUProperty, n);
+        model->nprops = n;
+
+        for (i = 0; i < n && !reader->error; i++) {
+            qemuMonitorCPUProperty *prop = model->props + i;
+
+            prop->name = virQEMUCapsBinReadName(reader);
+            prop->type = virQEMUCapsBinReadU32(reader);
+            prop->migratable = virQEMUCapsBinReadU32(reader);
+
+            switch (prop->type) {
+            case QEMU_MONITOR_CPU_PROPERTY_BOOLEAN:
+                prop->value.boolean = virQEMUCapsBinReadU32(reader);
+                break;
+
+            case QEMU_MONITOR_CPU_PROPERTY_STRING:
+                prop->value.string = virQEMUCapsBinReadName(reader);
+                break;
+
+            case QEMU_MONITOR_CPU_PROPERTY_NUMBER:
+                prop->value.number = virQEMUCapsBinReadI64(reader);
+                break;
+
+            case QEMU_MONITOR_CPU_PROPERTY_LAST:
+            default:
+                goto error;
+            }
+        }
+
+        caps->hostCPU.info = g_steal_pointer(&model);
+    }
+
+    n = virQEMUCapsBinReadU32(reader);
+    if (reader->error || n > reader->len)
+        goto error;
+
+    if (n > 0) {
+        if (!(caps->cpuModels = qemuMonitorCPUDefsNew(n)))
+            goto error;
+
+        for (i = 0; i < n && !reader->error; i++) {
+            qemuMonitorCPUDefInfo *cpu = caps->cpuModels->cpus + i;
+            size_t nblockers;
+            size_t j;
+            bool hasBlockers;
+
+            cpu->name = virQEMUCapsBinReadName(reader);
+            cpu->type = virQEMUCapsBinReadString(reader);
+            cpu->usable = virQEMUCapsBinReadU32(reader);
+            cpu->deprecated = virQEMUCapsBinReadU32(reader);
+            hasBlockers = virQEMUCapsBinReadU32(reader);
+            nblockers = virQEMUCapsBinReadU32(reader);
+            if (reader->error || nblockers > reader->len)
+                goto error;
+
+            if (hasBlockers) {
+                cpu->blockers = g_new0(char *, nblockers + 1);
+                for (j = 0; j < nblockers; j++)
+                    cpu->blockers[j] = virQEMUCapsBinReadName(reader);
+            }
+        }
+    }
+
+    n = virQEMUCapsBinReadU32(reader);
+    if (reader->error || n > reader->len)
+        goto error;
+
+    caps->machineTypes = g_new0(virQEMUCapsMachineType, n);
+    caps->nmachineTypes = n;
+
+    for (i = 0; i < n && !reader->error; i++) {
+        virQEMUCapsMachineType *machine = caps->machineTypes + i;
+
+        machine->name = virQEMUCapsBinReadName(reader);
+        machine->alias = virQEMUCapsBinReadString(reader);
+        machine->maxCpus = virQEMUCapsBinReadU32(reader);
+        machine->hotplugCpus = virQEMUCapsBinReadU32(reader);
+        machine->qemuDefault = virQEMUCapsBinReadU32(reader);
+        machine->defaultCPU = virQEMUCapsBinReadString(reader);
+        machine->numaMemSupported = virQEMUCapsBinReadU32(reader);
+        machine->defaultRAMid = virQEMUCapsBinReadString(reader);
+        machine->deprecated = virQEMUCapsBinReadU32(reader);
+    }
+
+    return;
+
+ error:
+    reader->error = true;
+}
+
+
+/**
+ * virQEMUCapsLoadCacheBinary:
+ * @hostArch: host architecture
+ * @qemuCaps: capabilities to fill in
+ * @filename: file with the binary form of the capabilities cache
+ * @skipInvalidation: don't check whether libvirt changed
+ *
+ * Binary counterpart of virQEMUCapsLoadCache.
+ *
+ * Returns 0 on success, 1 if outdated, -1 on error
+ */
+int
+virQEMUCapsLoadCacheBinary(virArch hostArch,
+                           virQEMUCaps *qemuCaps,
+                           const char *filename,
+                           bool skipInvalidation)
+{
+    g_autoptr(GMappedFile) file = NULL;
+    g_autoptr(GError) err = NULL;
+    g_autofree char *binary = NULL;
+    virQEMUCapsBinReader reader = { 0 };
+    const char *magic;
+    size_t nflags;
+    size_t i;
+
+    if (!(file = g_mapped_file_new(filename, FALSE, &err))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unable to read '%s': %s"), filename, err->message);
+        return -1;
+    }
+
+    reader.data = g_mapped_file_get_contents(file);
+    reader.len = g_mapped_file_get_length(file);
+
+    magic = virQEMUCapsBinRead(&reader, strlen(QEMU_CAPS_BIN_MAGIC));
+    if (!magic ||
+        memcmp(magic, QEMU_CAPS_BIN_MAGIC, strlen(QEMU_CAPS_BIN_MAGIC)) != 0 ||
+        virQEMUCapsBinReadU32(&reader) != QEMU_CAPS_BIN_VERSION ||
+        virQEMUCapsBinReadU32(&reader) != QEMU_CAPS_BIN_BYTEORDER) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("unsupported format of QEMU capabilities cache '%s'"),
+                       filename);
+        return -1;
+    }
+
+    qemuCaps->libvirtCtime = virQEMUCapsBinReadI64(&reader);
+    qemuCaps->libvirtVersion = virQEMUCapsBinReadU32(&reader);
+
+    if (reader.error)
+        goto corrupted;
+
+    if (!skipInvalidation &&
+        (qemuCaps->libvirtCtime != virGetSelfLastChanged() ||
+         qemuCaps->libvirtVersion != LIBVIR_VERSION_NUMBER)) {
+        VIR_DEBUG("Outdated capabilities in %s: libvirt changed "
+                  "(%lld vs %lld, %lu vs %lu), stopping load",
+                  qemuCaps->binary,
+                  (long long)qemuCaps->libvirtCtime,
+                  (long long)virGetSelfLastChanged(),
+                  (unsigned long)qemuCaps->libvirtVersion,
+                  (unsigned long)LIBVIR_VERSION_NUMBER);
+        return 1;
+    }
+
+    if (!(binary = virQEMUCapsBinReadName(&reader)))
+        goto corrupted;
+
+    if (STRNEQ(binary, qemuCaps->binary)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Expected caps for '%s' but saw '%s'"),
+                       qemuCaps->binary, binary);
+        return -1;
+    }
+
+    qemuCaps->ctime = virQEMUCapsBinReadI64(&reader);
+    qemuCaps->modDirMtime = virQEMUCapsBinReadI64(&reader);
+
+    nflags = virQEMUCapsBinReadU32(&reader);
+    for (i = 0; i < nflags && !reader.error; i++) {
+        uint32_t flag = virQEMUCapsBinReadU32(&reader);
+
+        if (flag >= QEMU_CAPS_LAST)
+            goto corrupted;
+
+        virQEMUCapsSet(qemuCaps, flag);
+    }
+
+    qemuCaps->version = virQEMUCapsBinReadU32(&reader);
+    qemuCaps->kvmVersion = virQEMUCapsBinReadU32(&reader);
+    qemuCaps->microcodeVersion = virQEMUCapsBinReadU32(&reader);
+    qemuCaps->hostCPUSignature = virQEMUCapsBinReadString(&reader);
+    qemuCaps->package = virQEMUCapsBinReadString(&reader);
+    qemuCaps->kernelVersion = virQEMUCapsBinReadString(&reader);
+    qemuCaps->arch = virQEMUCapsBinReadU32(&reader);
+
+    if (reader.error ||
+        qemuCaps->arch == VIR_ARCH_NONE ||
+        qemuCaps->arch >= VIR_ARCH_LAST)
+        goto corrupted;
+
+    virQEMUCapsLoadBinAccel(&qemuCaps->kvm, &reader);
+    virQEMUCapsLoadBinAccel(&qemuCaps->tcg, &reader);
+
+    qemuCaps->ngicCapabilities = virQEMUCapsBinReadU32(&reader);
+    if (reader.error || qemuCaps->ngicCapabilities > reader.len)
+        goto corrupted;
+
+    qemuCaps->gicCapabilities = g_new0(virGICCapability, qemuCaps->ngicCapabilities);
+    for (i = 0; i < qemuCaps->ngicCapabilities; i++) {
+        qemuCaps->gicCapabilities[i].version = virQEMUCapsBinReadU32(&reader);
+        qemuCaps->gicCapabilities[i].implementation = virQEMUCapsBinReadU32(&reader);
+    }
+
+    if (virQEMUCapsBinReadU32(&reader)) {
+        virSEVCapability *sev = g_new0(virSEVCapability, 1);
+
+        qemuCaps->sevCapabilities = sev;
+        sev->cbitpos = virQEMUCapsBinReadU32(&reader);
+        sev->reduced_phys_bits = virQEMUCapsBinReadU32(&reader);
+        sev->pdh = virQEMUCapsBinReadName(&reader);
+        sev->cert_chain = virQEMUCapsBinReadName(&reader);
+    }
+
+    qemuCaps->kvmSupportsNesting = virQEMUCapsBinReadU32(&reader);
+    qemuCaps->kvmSupportsSecureGuest = virQEMUCapsBinReadU32(&reader);
+
+    if (reader.error || reader.pos != reader.len)
+        goto corrupted;
+
+    virQEMUCapsInitHostCPUModel(qemuCaps, hostArch, VIR_DOMAIN_VIRT_KVM);
+    virQEMUCapsInitHostCPUModel(qemuCaps, hostArch, VIR_DOMAIN_VIRT_QEMU);
+
+    if (skipInvalidation)
+        qemuCaps->invalidation = false;
+
+    return 0;
+
+ corrupted:
+    virReportError(VIR_ERR_INTERNAL_ERROR,
+                   _("corrupted QEMU capabilities cache '%s'"), filename);
+    return -1;
+}
+
+
+/*
+ * The binary form of the cache lives next to the XML one, which is
+ * still written for debugging and serves as a fallback.
+ */
+static char *
+virQEMUCapsGetBinaryCacheFileName(const char *filename)
+{
+    const char *suffix = strrchr(filename, '.');
+
+    if (suffix && STREQ(suffix, ".xml"))
+        return g_strdup_printf("%.*s.bin", (int)(suffix - filename), filename);
+
+    return g_strdup_printf("%s.bin", filename);
+}
+
+
+static int
+virQEMUCapsWriteBinaryCache(int fd,
+                            const void *opaque)
+{
+    const GByteArray *bin = opaque;
+
+    if (safewrite(fd, bin->data, bin->len) != bin->len)
+        return -1;
+
+    return 0;
+}
+
+
 static int
 virQEMUCapsSaveFile(void *data,
                     const char *filename,
@@ -4634,6 +5270,8 @@ virQEMUCapsSaveFile(void *data,
 {
     virQEMUCaps *qemuCaps = data;
     g_autofree char *xml = NULL;
+    g_autofree char *binFilename = NULL;
+    g_autoptr(GByteArray) bin = NULL;
 
     xml = virQEMUCapsFormatCache(qemuCaps);
 
@@ -4644,6 +5282,20 @@ virQEMUCapsSaveFile(void *data,
         return -1;
     }
 
+    binFilename = virQEMUCapsGetBinaryCacheFileName(filename);
+    bin = virQEMUCapsFormatCacheBinary(qemuCaps);
+
+    if (virFileRewrite(binFilename, 0600, virQEMUCapsWriteBinaryCache, bin) < 0) {
+        VIR_WARN("Failed to save binary caps '%s' for '%s': %s",
+                 binFilename, qemuCaps->binary, virGetLastErrorMessage());
+        virResetLastError();
+
+        /* The binary cache is preferred when loading, make sure an old
+         * one doesn't shadow the XML cache which is still usable. */
+        if (unlink(binFilename) < 0 && errno != ENOENT)
+            VIR_WARN("Failed to remove stale binary caps '%s'", binFilename);
+    }
+
     VIR_DEBUG("Saved caps '%s' for '%s' with (%lld, %lld)",
               filename, qemuCaps->binary,
               (long long)qemuCaps->ctime,
@@ -4763,9 +5415,14 @@ virQEMUCapsKVMUsable(virQEMUCapsCachePriv *priv)
     struct stat sb;
     static const char *kvm_device = "/dev/kvm";
     virTristateBool value;
-    virTristateBool cached_value = priv->kvmUsable;
+    virTristateBool cached_value;
     time_t kvm_ctime;
-    time_t cached_kvm_ctime = priv->kvmCtime;
+    time_t cached_kvm_ctime;
+
+    virMutexLock(&priv->lock);
+    cached_value = priv->kvmUsable;
+    cached_kvm_ctime = priv->kvmCtime;
+    virMutexUnlock(&priv->lock);
 
     if (stat(kvm_device, &sb) < 0) {
         if (errno != ENOENT) {
@@ -4797,8 +5454,10 @@ virQEMUCapsKVMUsable(virQEMUCapsCachePriv *priv)
      * detecting changes *after* the virFileAccessibleAs check, we can
      * neglect this here.
      */
+    virMutexLock(&priv->lock);
     priv->kvmCtime = kvm_ctime;
     priv->kvmUsable = value;
+    virMutexUnlock(&priv->lock);
 
     return value == VIR_TRISTATE_BOOL_YES;
 }
@@ -4813,6 +5472,7 @@ virQEMUCapsIsValid(void *data,
     bool kvmUsable;
     struct stat sb;
     bool kvmSupportsNesting;
+    unsigned int microcodeVersion;
 
     if (!qemuCaps->invalidation)
         return true;
@@ -4900,11 +5560,15 @@ virQEMUCapsIsValid(void *data,
             return false;
         }
 
-        if (priv->microcodeVersion != qemuCaps->microcodeVersion) {
+        virMutexLock(&priv->lock);
+        microcodeVersion = priv->microcodeVersion;
+        virMutexUnlock(&priv->lock);
+
+        if (microcodeVersion != qemuCaps->microcodeVersion) {
             VIR_DEBUG("Outdated capabilities for '%s': microcode version "
                       "changed (%u vs %u)",
                       qemuCaps->binary,
-                      priv->microcodeVersion,
+                      microcodeVersion,
                       qemuCaps->microcodeVersion);
             return false;
         }
@@ -5334,20 +5998,26 @@ virQEMUCapsLogProbeFailure(const char *binary)
 
 static int
 virQEMUCapsInitQMPSingle(virQEMUCaps *qemuCaps,
+                         qemuProcessQMP *startedProc,
                          const char *libDir,
                          uid_t runUid,
                          gid_t runGid,
                          bool onlyTCG)
 {
-    g_autoptr(qemuProcessQMP) proc = NULL;
+    g_autoptr(qemuProcessQMP) newProc = NULL;
+    qemuProcessQMP *proc = startedProc;
     int ret = -1;
 
-    if (!(proc = qemuProcessQMPNew(qemuCaps->binary, libDir,
-                                   runUid, runGid, onlyTCG)))
-        goto cleanup;
+    if (!proc) {
+        if (!(newProc = qemuProcessQMPNew(qemuCaps->binary, libDir,
+                                          runUid, runGid, onlyTCG)))
+            goto cleanup;
 
-    if (qemuProcessQMPStart(proc) < 0)
-        goto cleanup;
+        if (qemuProcessQMPStart(newProc) < 0)
+            goto cleanup;
+
+        proc = newProc;
+    }
 
     if (onlyTCG)
         ret = virQEMUCapsInitQMPMonitorTCG(qemuCaps, proc->mon);
@@ -5362,14 +6032,91 @@ virQEMUCapsInitQMPSingle(virQEMUCaps *qemuCaps,
 }
 
 
+struct virQEMUCapsTCGProcessData {
+    const char *binary;
+    const char *libDir;
+    uid_t runUid;
+    gid_t runGid;
+    qemuProcessQMP *proc;
+};
+
+
+static void
+virQEMUCapsStartTCGProcess(void *opaque)
+{
+    struct virQEMUCapsTCGProcessData *data = opaque;
+    g_autoptr(qemuProcessQMP) proc = NULL;
+
+    if (!(proc = qemuProcessQMPNew(data->binary, data->libDir,
+                                   data->runUid, data->runGid, true)) ||
+        qemuProcessQMPStart(proc) < 0) {
+        /* the TCG probe will start its own process if needed */
+        VIR_DEBUG("Failed to start TCG probing process for %s: %s",
+                  data->binary, virGetLastErrorMessage());
+        virResetLastError();
+        return;
+    }
+
+    data->proc = g_steal_pointer(&proc);
+}
+
+
+/*
+ * The TCG probe is only needed when the first probe finds KVM usable.
+ * Start the process for it in advance when that is likely, i.e. for
+ * the host's native emulator on a host with KVM.
+ */
+static bool
+virQEMUCapsTCGProbeLikely(virQEMUCaps *qemuCaps,
+                          virArch hostArch)
+{
+    g_autofree char *native = NULL;
+
+    if (!virFileExists("/dev/kvm"))
+        return false;
+
+    native = virQEMUCapsGetDefaultEmulator(hostArch, hostArch);
+
+    return STREQ_NULLABLE(native, qemuCaps->binary);
+}
+
+
 static int
 virQEMUCapsInitQMP(virQEMUCaps *qemuCaps,
+                   virArch hostArch,
                    const char *libDir,
                    uid_t runUid,
                    gid_t runGid)
 {
-    if (virQEMUCapsInitQMPSingle(qemuCaps, libDir, runUid, runGid, false) < 0)
-        return -1;
+    struct virQEMUCapsTCGProcessData tcg = {
+        .binary = qemuCaps->binary,
+        .libDir = libDir,
+        .runUid = runUid,
+        .runGid = runGid,
+    };
+    g_autoptr(qemuProcessQMP) tcgProc = NULL;
+    virThread tcgThread;
+    bool tcgStarting = false;
+    int ret = -1;
+
+    /* Starting QEMU takes a significant part of each probe, so let the
+     * TCG process start while the main probe is running */
+    if (virQEMUCapsTCGProbeLikely(qemuCaps, hostArch)) {
+        if (virThreadCreateFull(&tcgThread, true, virQEMUCapsStartTCGProcess,
+                                "qemu-caps-tcg", false, &tcg) < 0)
+            virResetLastError();
+        else
+            tcgStarting = true;
+    }
+
+    if (virQEMUCapsInitQMPSingle(qemuCaps, NULL, libDir, runUid, runGid, false) < 0)
+        goto cleanup;
+
+    if (tcgStarting) {
+        virThreadJoin(&tcgThread);
+        tcgStarting = false;
+        tcgProc = g_steal_pointer(&tcg.proc);
+    }
 
     /*
      * If KVM was enabled during the first probe, we need to explicitly probe
@@ -5378,10 +6125,17 @@ virQEMUCapsInitQMP(virQEMUCaps *qemuCaps,
      */
     if (virQEMUCapsGet(qemuCaps, QEMU_CAPS_KVM) &&
         virQEMUCapsGet(qemuCaps, QEMU_CAPS_TCG) &&
-        virQEMUCapsInitQMPSingle(qemuCaps, libDir, runUid, runGid, true) < 0)
-        return -1;
+        virQEMUCapsInitQMPSingle(qemuCaps, tcgProc, libDir, runUid, runGid, true) < 0)
+        goto cleanup;
 
-    return 0;
+    ret = 0;
+
+ cleanup:
+    if (tcgStarting) {
+        virThreadJoin(&tcgThread);
+        qemuProcessQMPFree(tcg.proc);
+    }
+    return ret;
 }
 
 
@@ -5429,7 +6183,7 @@ virQEMUCapsNewForBinaryInternal(virArch hostArch,
         qemuCaps->modDirMtime = sb.st_mtime;
     }
 
-    if (virQEMUCapsInitQMP(qemuCaps, libDir, runUid, runGid) < 0)
+    if (virQEMUCapsInitQMP(qemuCaps, hostArch, libDir, runUid, runGid) < 0)
         return NULL;
 
     qemuCaps->libvirtCtime = virGetSelfLastChanged();
@@ -5477,11 +6231,33 @@ virQEMUCapsLoadFile(const char *filename,
 {
     g_autoptr(virQEMUCaps) qemuCaps = virQEMUCapsNewBinary(binary);
     virQEMUCapsCachePriv *priv = privData;
+    g_autofree char *binFilename = virQEMUCapsGetBinaryCacheFileName(filename);
     int ret;
 
     if (!qemuCaps)
         return NULL;
 
+    if (virFileExists(binFilename)) {
+        ret = virQEMUCapsLoadCacheBinary(priv->hostArch, qemuCaps,
+                                         binFilename, false);
+        if (ret == 0)
+            return g_steal_pointer(&qemuCaps);
+
+        if (ret == 1) {
+            *outdated = true;
+            return NULL;
+        }
+
+        VIR_WARN("Failed to load binary capabilities cache '%s': %s",
+                 binFilename, virGetLastErrorMessage());
+        virResetLastError();
+
+        /* start over with the XML cache */
+        g_clear_pointer(&qemuCaps, virObjectUnref);
+        if (!(qemuCaps = virQEMUCapsNewBinary(binary)))
+            return NULL;
+    }
+
     ret = virQEMUCapsLoadCache(priv->hostArch, qemuCaps, filename, false);
     if (ret < 0)
         return NULL;
@@ -5533,6 +6309,10 @@ virQEMUCapsFilterByMachineType(virQEMUCaps *qemuCaps,
 }
 
 
+/* How long (in milliseconds) cached capabilities are trusted without
+ * checking the QEMU binary and its modules again */
+#define QEMU_CAPS_CACHE_VALIDITY_TTL 1000
+
 virFileCacheHandlers qemuCapsCacheHandlers = {
     .isValid = virQEMUCapsIsValid,
     .newData = virQEMUCapsNewData,
@@ -5559,8 +6339,16 @@ virQEMUCapsCacheNew(const char *libDir,
         goto error;
 
     priv = g_new0(virQEMUCapsCachePriv, 1);
+    if (virMutexInit(&priv->lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        g_free(priv);
+        goto error;
+    }
     virFileCacheSetPriv(cache, priv);
 
+    virFileCacheSetValidityTTL(cache, QEMU_CAPS_CACHE_VALIDITY_TTL);
+
     priv->libDir = g_strdup(libDir);
 
     priv->hostArch = virArchFromHost();
@@ -5591,8 +6379,11 @@ virQEMUCapsCacheLookup(virFileCache *cache,
 {
     virQEMUCapsCachePriv *priv = virFileCacheGetPriv(cache);
     virQEMUCaps *ret = NULL;
+    unsigned int microcodeVersion = virHostCPUGetMicrocodeVersion(priv->hostArch);
 
-    priv->microcodeVersion = virHostCPUGetMicrocodeVersion(priv->hostArch);
+    virMutexLock(&priv->lock);
+    priv->microcodeVersion = microcodeVersion;
+    virMutexUnlock(&priv->lock);
 
     ret = virFileCacheLookup(cache, binary);
 
@@ -747,7 +747,8 @@ virQEMUCaps *virQEMUCapsCacheLookupDefault(virFileCache *cache,
                                              virDomainVirtType *retVirttype,
                                              const char **retMachine);
 
-virCaps *virQEMUCapsInit(virFileCache *cache);
+virCaps *virQEMUCapsInit(virFileCache *cache,
+                         unsigned int probeMaxParallel);
 
 int virQEMUCapsGetDefaultVersion(virCaps *caps,
                                  virFileCache *capsCache,
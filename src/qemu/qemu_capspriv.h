@@ -43,6 +43,12 @@ int virQEMUCapsLoadCache(virArch hostArch,
                          bool skipInvalidation);
 char *virQEMUCapsFormatCache(virQEMUCaps *qemuCaps);
 
+int virQEMUCapsLoadCacheBinary(virArch hostArch,
+                               virQEMUCaps *qemuCaps,
+                               const char *filename,
+                               bool skipInvalidation);
+GByteArray *virQEMUCapsFormatCacheBinary(virQEMUCaps *qemuCaps);
+
 int
 virQEMUCapsInitQMPMonitor(virQEMUCaps *qemuCaps,
                           qemuMonitor *mon);
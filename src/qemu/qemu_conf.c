@@ -71,6 +71,9 @@ VIR_LOG_INIT("qemu.qemu_conf");
 #define QEMU_MIGRATION_PORT_MIN 49152
 #define QEMU_MIGRATION_PORT_MAX 49215
 
+/* in milliseconds */
+#define QEMU_MIGRATION_CONVERGENCE_MAX_DOWNTIME 2000
+
 static virClass *virQEMUDriverConfigClass;
 static void virQEMUDriverConfigDispose(void *obj);
 
@@ -256,6 +259,7 @@ virQEMUDriverConfig *virQEMUDriverConfigNew(bool privileged,
 
     cfg->migrationPortMin = QEMU_MIGRATION_PORT_MIN;
     cfg->migrationPortMax = QEMU_MIGRATION_PORT_MAX;
+    cfg->migrationConvergenceMaxDowntime = QEMU_MIGRATION_CONVERGENCE_MAX_DOWNTIME;
 
     /* For privileged driver, try and find hugetlbfs mounts automatically.
      * Non-privileged driver requires admin to create a dir for the
@@ -279,6 +283,9 @@ virQEMUDriverConfig *virQEMUDriverConfigNew(bool privileged,
     cfg->keepAliveCount = 5;
     cfg->seccompSandbox = -1;
 
+    cfg->autoStartMaxParallel = 1;
+    cfg->capsProbeMaxParallel = 1;
+
     cfg->logTimestamp = true;
     cfg->glusterDebugLevel = 4;
     cfg->stdioLogD = true;
@@ -627,6 +634,8 @@ virQEMUDriverConfigLoadSaveEntry(virQEMUDriverConfig *cfg,
         return -1;
     if (virConfGetValueBool(conf, "auto_start_bypass_cache", &cfg->autoStartBypassCache) < 0)
         return -1;
+    if (virConfGetValueUInt(conf, "auto_start_max_parallel", &cfg->autoStartMaxParallel) < 0)
+        return -1;
 
     return 0;
 }
@@ -752,6 +761,9 @@ virQEMUDriverConfigLoadRPCEntry(virQEMUDriverConfig *cfg,
 {
     if (virConfGetValueUInt(conf, "max_queued", &cfg->maxQueuedJobs) < 0)
         return -1;
+    if (virConfGetValueUInt(conf, "max_reconnect_workers",
+                            &cfg->maxReconnectWorkers) < 0)
+        return -1;
     if (virConfGetValueInt(conf, "keepalive_interval", &cfg->keepAliveInterval) < 0)
         return -1;
     if (virConfGetValueUInt(conf, "keepalive_count", &cfg->keepAliveCount) < 0)
@@ -786,6 +798,18 @@ virQEMUDriverConfigLoadNetworkEntry(virQEMUDriverConfig *cfg,
         return -1;
     }
 
+    if (virConfGetValueUInt(conf, "migration_max_disk_mirrors",
+                            &cfg->migrationMaxDiskMirrors) < 0)
+        return -1;
+
+    if (virConfGetValueBool(conf, "migration_convergence",
+                            &cfg->migrationConvergence) < 0)
+        return -1;
+
+    if (virConfGetValueULLong(conf, "migration_convergence_max_downtime",
+                              &cfg->migrationConvergenceMaxDowntime) < 0)
+        return -1;
+
     if (virConfGetValueString(conf, "migration_host", &cfg->migrateHost) < 0)
         return -1;
     virStringStripIPv6Brackets(cfg->migrateHost);
@@ -1034,6 +1058,22 @@ virQEMUDriverConfigLoadSWTPMEntry(virQEMUDriverConfig *cfg,
 }
 
 
+static int
+virQEMUDriverConfigLoadCapabilitiesEntry(virQEMUDriverConfig *cfg,
+                                         virConf *conf)
+{
+    if (virConfGetValueBool(conf, "capabilities_refresh_in_background",
+                            &cfg->capsRefreshInBackground) < 0)
+        return -1;
+
+    if (virConfGetValueUInt(conf, "capabilities_probe_max_parallel",
+                            &cfg->capsProbeMaxParallel) < 0)
+        return -1;
+
+    return 0;
+}
+
+
 static int
 virQEMUDriverConfigLoadCapsFiltersEntry(virQEMUDriverConfig *cfg,
                                         virConf *conf)
@@ -1114,6 +1154,9 @@ int virQEMUDriverConfigLoadFile(virQEMUDriverConfig *cfg,
     if (virQEMUDriverConfigLoadSWTPMEntry(cfg, conf) < 0)
         return -1;
 
+    if (virQEMUDriverConfigLoadCapabilitiesEntry(cfg, conf) < 0)
+        return -1;
+
     if (virQEMUDriverConfigLoadCapsFiltersEntry(cfg, conf) < 0)
         return -1;
 
@@ -1315,9 +1358,79 @@ virQEMUDriverGetHostCPU(virQEMUDriver *driver)
 }
 
 
+/**
+ * virQEMUDriverAddNUMAPlacementLoad:
+ * @driver: the QEMU driver
+ * @nodeset: host NUMA nodes a domain was placed onto
+ * @load: number of vCPUs to account to each node of @nodeset
+ *
+ * Account vCPUs of an automatically placed domain so that the built-in
+ * placement engine can spread domains started later. The caller must
+ * hold driver->numaPlacementLock.
+ */
+void
+virQEMUDriverAddNUMAPlacementLoad(virQEMUDriver *driver,
+                                  virBitmap *nodeset,
+                                  unsigned int load)
+{
+    ssize_t node = -1;
+
+    while ((node = virBitmapNextSetBit(nodeset, node)) >= 0) {
+        if (node >= driver->nnumaPlacementLoad)
+            VIR_EXPAND_N(driver->numaPlacementLoad, driver->nnumaPlacementLoad,
+                         node + 1 - driver->nnumaPlacementLoad);
+
+        driver->numaPlacementLoad[node] += load;
+    }
+}
+
+
+void
+virQEMUDriverRemoveNUMAPlacementLoad(virQEMUDriver *driver,
+                                     virBitmap *nodeset,
+                                     unsigned int load)
+{
+    ssize_t node = -1;
+
+    while ((node = virBitmapNextSetBit(nodeset, node)) >= 0) {
+        if (node >= driver->nnumaPlacementLoad)
+            break;
+
+        if (driver->numaPlacementLoad[node] > load)
+            driver->numaPlacementLoad[node] -= load;
+        else
+            driver->numaPlacementLoad[node] = 0;
+    }
+}
+
+
+/**
+ * virQEMUDriverGetNUMAPlacementLoad:
+ * @driver: the QEMU driver
+ * @nload: filled with the number of items of the returned array
+ *
+ * Returns a copy of the number of vCPUs accounted to each host NUMA node
+ * by virQEMUDriverAddNUMAPlacementLoad, indexed by node ID. The caller
+ * must hold driver->numaPlacementLock.
+ */
+unsigned int *
+virQEMUDriverGetNUMAPlacementLoad(virQEMUDriver *driver,
+                                  size_t *nload)
+{
+    unsigned int *load;
+
+    *nload = driver->nnumaPlacementLoad;
+    load = g_new0(unsigned int, *nload);
+    memcpy(load, driver->numaPlacementLoad, sizeof(*load) * *nload);
+
+    return load;
+}
+
+
 virCaps *virQEMUDriverCreateCapabilities(virQEMUDriver *driver)
 {
     size_t i, j;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
     g_autoptr(virCaps) caps = NULL;
     g_autofree virSecurityManager **sec_managers = NULL;
     /* Security driver data */
@@ -1326,7 +1439,8 @@ virCaps *virQEMUDriverCreateCapabilities(virQEMUDriver *driver)
                              VIR_DOMAIN_VIRT_QEMU,};
 
     /* Basic host arch / guest machine capabilities */
-    if (!(caps = virQEMUCapsInit(driver->qemuCapsCache)))
+    if (!(caps = virQEMUCapsInit(driver->qemuCapsCache,
+                                 cfg->capsProbeMaxParallel)))
         return NULL;
 
     if (virGetHostUUID(caps->host.host_uuid)) {
@@ -43,6 +43,7 @@
 #include "virthreadpool.h"
 #include "locking/lock_manager.h"
 #include "qemu_capabilities.h"
+#include "qemu_statussave.h"
 #include "virclosecallbacks.h"
 #include "virhostdev.h"
 #include "virfile.h"
@@ -181,6 +182,7 @@ struct _virQEMUDriverConfig {
     bool dumpGuestCore;
 
     unsigned int maxQueuedJobs;
+    unsigned int maxReconnectWorkers;
 
     char **securityDriverNames;
     bool securityDefaultConfined;
@@ -193,6 +195,7 @@ struct _virQEMUDriverConfig {
     char *autoDumpPath;
     bool autoDumpBypassCache;
     bool autoStartBypassCache;
+    unsigned int autoStartMaxParallel;
 
     char *lockManagerName;
 
@@ -206,6 +209,9 @@ struct _virQEMUDriverConfig {
     char *migrationAddress;
     unsigned int migrationPortMin;
     unsigned int migrationPortMax;
+    unsigned int migrationMaxDiskMirrors;
+    bool migrationConvergence;
+    unsigned long long migrationConvergenceMaxDowntime;
 
     bool logTimestamp;
     bool stdioLogD;
@@ -220,6 +226,9 @@ struct _virQEMUDriverConfig {
     uid_t swtpm_user;
     gid_t swtpm_group;
 
+    bool capsRefreshInBackground;
+    unsigned int capsProbeMaxParallel;
+
     char **capabilityfilters;
 
     char *deprecationBehavior;
@@ -242,6 +251,11 @@ struct _virQEMUDriver {
     /* Immutable pointer, self-locking APIs */
     virThreadPool *workerPool;
 
+    /* Thread reconnecting to running domains at startup, joined by
+     * qemuProcessReconnectAllWait */
+    virThread reconnectThread;
+    bool reconnectThreadActive;
+
     /* Atomic increment only */
     int lastvmid;
 
@@ -315,6 +329,18 @@ struct _virQEMUDriver {
 
     /* Immutable pointer, self-locking APIs */
     virHashAtomic *migrationErrors;
+
+    /* Immutable pointer, self-locking APIs */
+    qemuStatusSaver *statusSaver;
+
+    /* Serializes picking host NUMA nodes for automatic placement
+     * together with accounting the placed domain */
+    virMutex numaPlacementLock;
+
+    /* Number of vCPUs of running domains placed onto each host NUMA
+     * node by automatic placement. Require numaPlacementLock to access. */
+    unsigned int *numaPlacementLoad;
+    size_t nnumaPlacementLoad;
 };
 
 virQEMUDriverConfig *virQEMUDriverConfigNew(bool privileged,
@@ -333,6 +359,15 @@ virQEMUDriverConfigSetDefaults(virQEMUDriverConfig *cfg);
 virQEMUDriverConfig *virQEMUDriverGetConfig(virQEMUDriver *driver);
 
 virCPUDef *virQEMUDriverGetHostCPU(virQEMUDriver *driver);
+
+void virQEMUDriverAddNUMAPlacementLoad(virQEMUDriver *driver,
+                                       virBitmap *nodeset,
+                                       unsigned int load);
+void virQEMUDriverRemoveNUMAPlacementLoad(virQEMUDriver *driver,
+                                          virBitmap *nodeset,
+                                          unsigned int load);
+unsigned int *virQEMUDriverGetNUMAPlacementLoad(virQEMUDriver *driver,
+                                                size_t *nload);
 virCaps *virQEMUDriverCreateCapabilities(virQEMUDriver *driver);
 virCaps *virQEMUDriverGetCapabilities(virQEMUDriver *driver,
                                         bool refresh);
@@ -1772,6 +1772,20 @@ qemuDomainObjStopWorker(virDomainObj *dom)
 }
 
 
+static void
+qemuDomainObjPrivateXMLCacheClear(qemuDomainObjPrivate *priv)
+{
+    size_t i;
+
+    for (i = 0; i < priv->nxmlCache; i++)
+        g_clear_pointer(&priv->xmlCache[i].xml, g_free);
+
+    priv->nxmlCache = 0;
+    priv->xmlCacheDef = NULL;
+    priv->xmlCacheNewDef = NULL;
+}
+
+
 /**
  * qemuDomainObjPrivateDataClear:
  * @priv: domain private data
@@ -1782,6 +1796,8 @@ qemuDomainObjStopWorker(virDomainObj *dom)
 void
 qemuDomainObjPrivateDataClear(qemuDomainObjPrivate *priv)
 {
+    qemuDomainObjPrivateXMLCacheClear(priv);
+
     g_strfreev(priv->qemuDevices);
     priv->qemuDevices = NULL;
 
@@ -1802,6 +1818,7 @@ qemuDomainObjPrivateDataClear(qemuDomainObjPrivate *priv)
     VIR_FREE(priv->channelTargetDir);
 
     priv->memPrealloc = false;
+    priv->vcpuTaskStats = VIR_TRISTATE_BOOL_ABSENT;
 
     /* remove automatic pinning data */
     virBitmapFree(priv->autoNodeset);
@@ -5907,10 +5924,16 @@ virDomainDefParserConfig virQEMUDriverDomainDefParserConfig = {
 };
 
 
+/**
+ * qemuDomainSaveStatusNow:
+ * @obj: domain object
+ *
+ * Write the status XML of @obj right away.
+ */
 void
-qemuDomainObjSaveStatus(virQEMUDriver *driver,
-                        virDomainObj *obj)
+qemuDomainSaveStatusNow(virDomainObj *obj)
 {
+    virQEMUDriver *driver = QEMU_DOMAIN_PRIVATE(obj)->driver;
     g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
 
     if (virDomainObjIsActive(obj)) {
@@ -5920,6 +5943,34 @@ qemuDomainObjSaveStatus(virQEMUDriver *driver,
 }
 
 
+/**
+ * qemuDomainObjSaveStatus:
+ * @driver: qemu driver
+ * @obj: domain object
+ *
+ * Request the status XML of @obj to be saved. The write is done
+ * asynchronously and coalesced with other changes of the status done
+ * shortly after unless the driver doesn't provide a status saver.
+ *
+ * Job and migration phase changes must use qemuDomainSaveStatusNow
+ * instead, as a restarted daemon recovers jobs from the status XML.
+ */
+void
+qemuDomainObjSaveStatus(virQEMUDriver *driver,
+                        virDomainObj *obj)
+{
+    qemuDomainXMLCacheInvalidate(obj);
+
+    if (!virDomainObjIsActive(obj))
+        return;
+
+    if (driver->statusSaver)
+        qemuStatusSaverSchedule(driver->statusSaver, obj);
+    else
+        qemuDomainSaveStatusNow(obj);
+}
+
+
 void
 qemuDomainSaveStatus(virDomainObj *obj)
 {
@@ -5934,6 +5985,8 @@ qemuDomainSaveConfig(virDomainObj *obj)
     g_autoptr(virQEMUDriverConfig) cfg = NULL;
     virDomainDef *def = NULL;
 
+    qemuDomainXMLCacheInvalidate(obj);
+
     if (virDomainObjIsActive(obj))
         def = obj->newDef;
     else
@@ -6421,9 +6474,11 @@ qemuDomainDefFormatXML(virQEMUDriver *driver,
 }
 
 
-char *qemuDomainFormatXML(virQEMUDriver *driver,
-                          virDomainObj *vm,
-                          unsigned int flags)
+static int
+qemuDomainFormatXMLBuf(virQEMUDriver *driver,
+                       virDomainObj *vm,
+                       unsigned int flags,
+                       virBuffer *buf)
 {
     virDomainDef *def;
     qemuDomainObjPrivate *priv = vm->privateData;
@@ -6436,7 +6491,102 @@ char *qemuDomainFormatXML(virQEMUDriver *driver,
         origCPU = priv->origCPU;
     }
 
-    return qemuDomainDefFormatXMLInternal(driver, priv->qemuCaps, def, origCPU, flags);
+    return qemuDomainDefFormatBufInternal(driver, priv->qemuCaps, def, origCPU,
+                                          flags, buf);
+}
+
+
+char *qemuDomainFormatXML(virQEMUDriver *driver,
+                          virDomainObj *vm,
+                          unsigned int flags)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+
+    if (qemuDomainFormatXMLBuf(driver, vm, flags, &buf) < 0)
+        return NULL;
+
+    return virBufferContentAndReset(&buf);
+}
+
+
+/**
+ * qemuDomainXMLCacheInvalidate:
+ * @vm: domain object
+ *
+ * Drops all XML documents cached by qemuDomainFormatXMLCached. Must be
+ * called whenever the definition of @vm may have changed.
+ */
+void
+qemuDomainXMLCacheInvalidate(virDomainObj *vm)
+{
+    qemuDomainObjPrivateXMLCacheClear(vm->privateData);
+}
+
+
+/**
+ * qemuDomainFormatXMLCached:
+ * @driver: qemu driver
+ * @vm: domain object
+ * @flags: VIR_DOMAIN_XML_* flags
+ *
+ * Same as qemuDomainFormatXML, but the result is remembered and
+ * returned again by subsequent calls with the same @flags until the
+ * definition of @vm changes. The definition is considered changed by
+ * ending any job on @vm, saving its status or config, or replacing
+ * either of its definitions. Nothing is cached while a job is running
+ * since the definition may be modified anytime the job releases the
+ * domain lock.
+ */
+char *
+qemuDomainFormatXMLCached(virQEMUDriver *driver,
+                          virDomainObj *vm,
+                          unsigned int flags)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    qemuDomainXMLCacheEntry *entry;
+    size_t i;
+
+    if (priv->xmlCacheDef != vm->def ||
+        priv->xmlCacheNewDef != vm->newDef)
+        qemuDomainXMLCacheInvalidate(vm);
+
+    for (i = 0; i < priv->nxmlCache; i++) {
+        if (priv->xmlCache[i].flags == flags)
+            return g_strdup(priv->xmlCache[i].xml);
+    }
+
+    /* leave some room as the definition grows over time */
+    virBufferReserve(&buf, priv->xmlSizeHint + priv->xmlSizeHint / 8);
+
+    if (qemuDomainFormatXMLBuf(driver, vm, flags, &buf) < 0)
+        return NULL;
+
+    priv->xmlSizeHint = virBufferUse(&buf);
+
+    /* Don't remember XML formatted while a job may still modify the
+     * definition or XML which depends on the host CPU rather than on the
+     * domain alone. */
+    if (priv->job.active != QEMU_JOB_NONE ||
+        priv->job.asyncJob != QEMU_ASYNC_JOB_NONE ||
+        priv->job.agentActive != QEMU_AGENT_JOB_NONE ||
+        (flags & VIR_DOMAIN_XML_UPDATE_CPU))
+        return virBufferContentAndReset(&buf);
+
+    if (priv->nxmlCache == QEMU_DOMAIN_XML_CACHE_SIZE) {
+        g_free(priv->xmlCache[0].xml);
+        memmove(priv->xmlCache, priv->xmlCache + 1,
+                sizeof(*priv->xmlCache) * (QEMU_DOMAIN_XML_CACHE_SIZE - 1));
+        priv->nxmlCache--;
+    }
+
+    entry = &priv->xmlCache[priv->nxmlCache++];
+    entry->flags = flags;
+    entry->xml = virBufferContentAndReset(&buf);
+    priv->xmlCacheDef = vm->def;
+    priv->xmlCacheNewDef = vm->newDef;
+
+    return g_strdup(entry->xml);
 }
 
 char *
@@ -9513,6 +9663,61 @@ qemuDomainGetVcpuPid(virDomainObj *vm,
 }
 
 
+/**
+ * qemuDomainGetVcpusTaskStats:
+ * @vm: domain object
+ * @stats: array of @maxinfo items to fill
+ * @maxinfo: maximum number of online vCPUs to query
+ *
+ * Fetch the CPU accounting of up to @maxinfo online vCPU threads of @vm
+ * at once through taskstats. Taskstats and procfs account CPU time with
+ * different granularity, so the source used first for @vm is kept: if
+ * taskstats failed then, procfs is used from then on, otherwise a later
+ * failure of taskstats is reported rather than falling back.
+ *
+ * Returns 1 if @stats were filled in, 0 if the caller has to read the
+ * accounting from procfs, -1 on error.
+ */
+int
+qemuDomainGetVcpusTaskStats(virDomainObj *vm,
+                            virNetlinkTaskStats *stats,
+                            size_t maxinfo)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+    g_autofree pid_t *tids = NULL;
+    size_t ntids = 0;
+    size_t i;
+
+    if (priv->vcpuTaskStats == VIR_TRISTATE_BOOL_NO)
+        return 0;
+
+    tids = g_new0(pid_t, maxinfo);
+
+    for (i = 0; i < virDomainDefGetVcpusMax(vm->def) && ntids < maxinfo; i++) {
+        virDomainVcpuDef *vcpu = virDomainDefGetVcpu(vm->def, i);
+
+        if (!vcpu->online)
+            continue;
+
+        tids[ntids++] = qemuDomainGetVcpuPid(vm, i);
+    }
+
+    if (virNetlinkGetTaskStats(tids, ntids, stats) < 0) {
+        if (priv->vcpuTaskStats == VIR_TRISTATE_BOOL_YES)
+            return -1;
+
+        VIR_DEBUG("Using procfs for vCPU accounting of domain %s: %s",
+                  vm->def->name, virGetLastErrorMessage());
+        virResetLastError();
+        priv->vcpuTaskStats = VIR_TRISTATE_BOOL_NO;
+        return 0;
+    }
+
+    priv->vcpuTaskStats = VIR_TRISTATE_BOOL_YES;
+    return 1;
+}
+
+
 /**
  * qemuDomainValidateVcpuInfo:
  *
@@ -43,6 +43,7 @@
 #include "virdomainmomentobjlist.h"
 #include "virenum.h"
 #include "vireventthread.h"
+#include "virnetlink.h"
 
 #define QEMU_DOMAIN_FORMAT_LIVE_FLAGS \
     (VIR_DOMAIN_XML_SECURE)
@@ -65,6 +66,7 @@ qemuDomainObjSaveStatus(virQEMUDriver *driver,
                         virDomainObj *obj);
 
 void qemuDomainSaveStatus(virDomainObj *obj);
+void qemuDomainSaveStatusNow(virDomainObj *obj);
 void qemuDomainSaveConfig(virDomainObj *obj);
 
 
@@ -124,6 +126,14 @@ struct _qemuDomainSecretInfo {
     } s;
 };
 
+#define QEMU_DOMAIN_XML_CACHE_SIZE 4
+
+typedef struct _qemuDomainXMLCacheEntry qemuDomainXMLCacheEntry;
+struct _qemuDomainXMLCacheEntry {
+    unsigned int flags;
+    char *xml;
+};
+
 typedef struct _qemuDomainObjPrivate qemuDomainObjPrivate;
 struct _qemuDomainObjPrivate {
     virQEMUDriver *driver;
@@ -183,6 +193,16 @@ struct _qemuDomainObjPrivate {
     /* Bitmaps below hold data from the auto NUMA feature */
     virBitmap *autoNodeset;
     virBitmap *autoCpuset;
+    /* vCPUs accounted to each node of @autoNodeset in driver->numaPlacementLoad */
+    unsigned int autoNodesetLoad;
+
+    /* XML formatted by qemuDomainFormatXMLCached, valid only as long as
+     * the definitions it was formatted from are the ones below */
+    qemuDomainXMLCacheEntry xmlCache[QEMU_DOMAIN_XML_CACHE_SIZE];
+    size_t nxmlCache;
+    virDomainDef *xmlCacheDef;
+    virDomainDef *xmlCacheNewDef;
+    size_t xmlSizeHint; /* length of the most recently formatted XML */
 
     bool signalIOError; /* true if the domain condition should be signalled on
                            I/O error */
@@ -238,6 +258,10 @@ struct _qemuDomainObjPrivate {
     /* true if global -mem-prealloc appears on cmd line */
     bool memPrealloc;
 
+    /* whether vCPU times are read through taskstats rather than procfs,
+     * decided on first use so that they never mix */
+    virTristateBool vcpuTaskStats;
+
     /* running block jobs */
     GHashTable *blockjobs;
 
@@ -558,6 +582,12 @@ char *qemuDomainFormatXML(virQEMUDriver *driver,
                           virDomainObj *vm,
                           unsigned int flags);
 
+char *qemuDomainFormatXMLCached(virQEMUDriver *driver,
+                                virDomainObj *vm,
+                                unsigned int flags);
+
+void qemuDomainXMLCacheInvalidate(virDomainObj *vm);
+
 char *qemuDomainDefFormatLive(virQEMUDriver *driver,
                               virQEMUCaps *qemuCaps,
                               virDomainDef *def,
@@ -814,6 +844,9 @@ int qemuDomainDefValidateMemoryHotplug(const virDomainDef *def,
 bool qemuDomainSupportsNewVcpuHotplug(virDomainObj *vm);
 bool qemuDomainHasVcpuPids(virDomainObj *vm);
 pid_t qemuDomainGetVcpuPid(virDomainObj *vm, unsigned int vcpuid);
+int qemuDomainGetVcpusTaskStats(virDomainObj *vm,
+                                virNetlinkTaskStats *stats,
+                                size_t maxinfo);
 int qemuDomainValidateVcpuInfo(virDomainObj *vm);
 int qemuDomainRefreshVcpuInfo(virQEMUDriver *driver,
                               virDomainObj *vm,
@@ -116,9 +116,23 @@ qemuDomainAsyncJobPhaseFromString(qemuDomainAsyncJob job,
 }
 
 
+void
+qemuDomainMirrorStatsClear(qemuDomainMirrorStats *stats)
+{
+    size_t i;
+
+    for (i = 0; i < stats->ndisks; i++)
+        g_free(stats->disks[i].dst);
+    g_free(stats->disks);
+
+    memset(stats, 0, sizeof(*stats));
+}
+
+
 void
 qemuDomainJobInfoFree(qemuDomainJobInfo *info)
 {
+    qemuDomainMirrorStatsClear(&info->mirrorStats);
     g_free(info->errmsg);
     g_free(info);
 }
@@ -128,11 +142,22 @@ qemuDomainJobInfo *
 qemuDomainJobInfoCopy(qemuDomainJobInfo *info)
 {
     qemuDomainJobInfo *ret = g_new0(qemuDomainJobInfo, 1);
+    size_t i;
 
     memcpy(ret, info, sizeof(*info));
 
     ret->errmsg = g_strdup(info->errmsg);
 
+    if (info->mirrorStats.ndisks > 0) {
+        ret->mirrorStats.disks = g_new0(qemuDomainMirrorDiskStats,
+                                        info->mirrorStats.ndisks);
+
+        for (i = 0; i < info->mirrorStats.ndisks; i++) {
+            ret->mirrorStats.disks[i] = info->mirrorStats.disks[i];
+            ret->mirrorStats.disks[i].dst = g_strdup(info->mirrorStats.disks[i].dst);
+        }
+    }
+
     return ret;
 }
 
@@ -150,7 +175,7 @@ qemuDomainEventEmitJobCompleted(virQEMUDriver *driver,
         return;
 
     if (qemuDomainJobInfoToParams(priv->job.completed, &type,
-                                  &params, &nparams) < 0) {
+                                  &params, &nparams, false) < 0) {
         VIR_WARN("Could not get stats for completed job; domain %s",
                  vm->def->name);
     }
@@ -388,11 +413,97 @@ qemuDomainJobInfoToInfo(qemuDomainJobInfo *jobInfo,
 }
 
 
+static unsigned long long
+qemuDomainMirrorDiskStatsETA(qemuDomainMirrorDiskStats *disk)
+{
+    unsigned long long remaining;
+
+    if (disk->transferred >= disk->total)
+        return 0;
+
+    remaining = disk->total - disk->transferred;
+    return remaining / disk->rate * 1000 +
+           remaining % disk->rate * 1000 / disk->rate;
+}
+
+
+int
+qemuDomainMirrorStatsToParams(qemuDomainMirrorStats *stats,
+                              virTypedParameterPtr *par,
+                              int *npar,
+                              int *maxpar)
+{
+    size_t i;
+
+    if (stats->ndisks == 0)
+        return 0;
+
+    if (virTypedParamsAddUInt(par, npar, maxpar,
+                              VIR_DOMAIN_JOB_DISK_MIRROR_COUNT,
+                              stats->ndisks) < 0)
+        return -1;
+
+    for (i = 0; i < stats->ndisks; i++) {
+        qemuDomainMirrorDiskStats *disk = stats->disks + i;
+        unsigned long long remaining = 0;
+        char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+
+        if (disk->total > disk->transferred)
+            remaining = disk->total - disk->transferred;
+
+        g_snprintf(field, VIR_TYPED_PARAM_FIELD_LENGTH,
+                   VIR_DOMAIN_JOB_DISK_MIRROR_NAME, (unsigned int) i);
+        if (virTypedParamsAddString(par, npar, maxpar, field, disk->dst) < 0)
+            return -1;
+
+        g_snprintf(field, VIR_TYPED_PARAM_FIELD_LENGTH,
+                   VIR_DOMAIN_JOB_DISK_MIRROR_TOTAL, (unsigned int) i);
+        if (virTypedParamsAddULLong(par, npar, maxpar, field, disk->total) < 0)
+            return -1;
+
+        g_snprintf(field, VIR_TYPED_PARAM_FIELD_LENGTH,
+                   VIR_DOMAIN_JOB_DISK_MIRROR_PROCESSED, (unsigned int) i);
+        if (virTypedParamsAddULLong(par, npar, maxpar, field,
+                                    disk->transferred) < 0)
+            return -1;
+
+        g_snprintf(field, VIR_TYPED_PARAM_FIELD_LENGTH,
+                   VIR_DOMAIN_JOB_DISK_MIRROR_REMAINING, (unsigned int) i);
+        if (virTypedParamsAddULLong(par, npar, maxpar, field, remaining) < 0)
+            return -1;
+
+        if (disk->bandwidth > 0) {
+            g_snprintf(field, VIR_TYPED_PARAM_FIELD_LENGTH,
+                       VIR_DOMAIN_JOB_DISK_MIRROR_BANDWIDTH, (unsigned int) i);
+            if (virTypedParamsAddULLong(par, npar, maxpar, field,
+                                        disk->bandwidth) < 0)
+                return -1;
+        }
+
+        g_snprintf(field, VIR_TYPED_PARAM_FIELD_LENGTH,
+                   VIR_DOMAIN_JOB_DISK_MIRROR_READY, (unsigned int) i);
+        if (virTypedParamsAddBoolean(par, npar, maxpar, field, disk->ready) < 0)
+            return -1;
+
+        if (disk->started && !disk->ready && disk->rate > 0) {
+            g_snprintf(field, VIR_TYPED_PARAM_FIELD_LENGTH,
+                       VIR_DOMAIN_JOB_DISK_MIRROR_ETA, (unsigned int) i);
+            if (virTypedParamsAddULLong(par, npar, maxpar, field,
+                                        qemuDomainMirrorDiskStatsETA(disk)) < 0)
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+
 static int
 qemuDomainMigrationJobInfoToParams(qemuDomainJobInfo *jobInfo,
                                    int *type,
                                    virTypedParameterPtr *params,
-                                   int *nparams)
+                                   int *nparams,
+                                   bool diskMirrors)
 {
     qemuMonitorMigrationStats *stats = &jobInfo->stats.mig;
     qemuDomainMirrorStats *mirrorStats = &jobInfo->mirrorStats;
@@ -528,6 +639,10 @@ qemuDomainMigrationJobInfoToParams(qemuDomainJobInfo *jobInfo,
                                 stats->disk_bps) < 0)
         goto error;
 
+    if (diskMirrors &&
+        qemuDomainMirrorStatsToParams(mirrorStats, &par, &npar, &maxpar) < 0)
+        goto error;
+
     if (stats->xbzrle_set) {
         if (virTypedParamsAddULLong(&par, &npar, &maxpar,
                                     VIR_DOMAIN_JOB_COMPRESSION_CACHE,
@@ -669,12 +784,14 @@ int
 qemuDomainJobInfoToParams(qemuDomainJobInfo *jobInfo,
                           int *type,
                           virTypedParameterPtr *params,
-                          int *nparams)
+                          int *nparams,
+                          bool diskMirrors)
 {
     switch (jobInfo->statsType) {
     case QEMU_DOMAIN_JOB_STATS_TYPE_MIGRATION:
     case QEMU_DOMAIN_JOB_STATS_TYPE_SAVEDUMP:
-        return qemuDomainMigrationJobInfoToParams(jobInfo, type, params, nparams);
+        return qemuDomainMigrationJobInfoToParams(jobInfo, type, params, nparams,
+                                                  diskMirrors);
 
     case QEMU_DOMAIN_JOB_STATS_TYPE_MEMDUMP:
         return qemuDomainDumpJobInfoToParams(jobInfo, type, params, nparams);
@@ -721,7 +838,7 @@ qemuDomainObjSetJobPhase(virQEMUDriver *driver,
 
     priv->job.phase = phase;
     priv->job.asyncOwner = me;
-    qemuDomainObjSaveStatus(driver, obj);
+    qemuDomainSaveStatusNow(obj);
 }
 
 void
@@ -744,7 +861,7 @@ qemuDomainObjDiscardAsyncJob(virQEMUDriver *driver, virDomainObj *obj)
     if (priv->job.active == QEMU_JOB_ASYNC_NESTED)
         qemuDomainObjResetJob(&priv->job);
     qemuDomainObjResetAsyncJob(&priv->job);
-    qemuDomainObjSaveStatus(driver, obj);
+    qemuDomainSaveStatusNow(obj);
 }
 
 void
@@ -924,7 +1041,7 @@ qemuDomainObjBeginJobInternal(virQEMUDriver *driver,
     }
 
     if (qemuDomainTrackJob(job))
-        qemuDomainObjSaveStatus(driver, obj);
+        qemuDomainSaveStatusNow(obj);
 
     return 0;
 
@@ -1138,6 +1255,7 @@ qemuDomainObjEndJob(virQEMUDriver *driver, virDomainObj *obj)
     qemuDomainJob job = priv->job.active;
 
     priv->jobs_queued--;
+    qemuDomainXMLCacheInvalidate(obj);
 
     VIR_DEBUG("Stopping job: %s (async=%s vm=%p name=%s)",
               qemuDomainJobTypeToString(job),
@@ -1146,7 +1264,7 @@ qemuDomainObjEndJob(virQEMUDriver *driver, virDomainObj *obj)
 
     qemuDomainObjResetJob(&priv->job);
     if (qemuDomainTrackJob(job))
-        qemuDomainObjSaveStatus(driver, obj);
+        qemuDomainSaveStatusNow(obj);
     /* We indeed need to wake up ALL threads waiting because
      * grabbing a job requires checking more variables. */
     virCondBroadcast(&priv->job.cond);
@@ -1159,6 +1277,7 @@ qemuDomainObjEndAgentJob(virDomainObj *obj)
     qemuDomainAgentJob agentJob = priv->job.agentActive;
 
     priv->jobs_queued--;
+    qemuDomainXMLCacheInvalidate(obj);
 
     VIR_DEBUG("Stopping agent job: %s (async=%s vm=%p name=%s)",
               qemuDomainAgentJobTypeToString(agentJob),
@@ -1177,13 +1296,14 @@ qemuDomainObjEndAsyncJob(virQEMUDriver *driver, virDomainObj *obj)
     qemuDomainObjPrivate *priv = obj->privateData;
 
     priv->jobs_queued--;
+    qemuDomainXMLCacheInvalidate(obj);
 
     VIR_DEBUG("Stopping async job: %s (vm=%p name=%s)",
               qemuDomainAsyncJobTypeToString(priv->job.asyncJob),
               obj, obj->def->name);
 
     qemuDomainObjResetAsyncJob(&priv->job);
-    qemuDomainObjSaveStatus(driver, obj);
+    qemuDomainSaveStatusNow(obj);
     virCondBroadcast(&priv->job.asyncCond);
 }
 
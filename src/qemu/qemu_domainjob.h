@@ -100,12 +100,30 @@ typedef enum {
 } qemuDomainJobStatsType;
 
 
+typedef struct _qemuDomainMirrorDiskStats qemuDomainMirrorDiskStats;
+struct _qemuDomainMirrorDiskStats {
+    char *dst;                      /* target of the mirrored disk */
+    bool started;                   /* the mirror job was started */
+    bool ready;                     /* the initial copy is finished */
+    unsigned long long transferred;
+    unsigned long long total;
+    unsigned long long bandwidth;   /* limit in bytes/s, 0 if unlimited */
+    unsigned long long rate;        /* measured copy rate in bytes/s */
+    unsigned long long sampledBytes; /* @transferred when @rate was computed */
+    unsigned long long sampledTime; /* when @rate was computed (ms) */
+};
+
 typedef struct _qemuDomainMirrorStats qemuDomainMirrorStats;
 struct _qemuDomainMirrorStats {
     unsigned long long transferred;
     unsigned long long total;
+    size_t ndisks;
+    qemuDomainMirrorDiskStats *disks;
 };
 
+void
+qemuDomainMirrorStatsClear(qemuDomainMirrorStats *stats);
+
 typedef struct _qemuDomainBackupStats qemuDomainBackupStats;
 struct _qemuDomainBackupStats {
     unsigned long long transferred;
@@ -264,7 +282,14 @@ int qemuDomainJobInfoToInfo(qemuDomainJobInfo *jobInfo,
 int qemuDomainJobInfoToParams(qemuDomainJobInfo *jobInfo,
                               int *type,
                               virTypedParameterPtr *params,
-                              int *nparams)
+                              int *nparams,
+                              bool diskMirrors)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2)
+    ATTRIBUTE_NONNULL(3) ATTRIBUTE_NONNULL(4);
+int qemuDomainMirrorStatsToParams(qemuDomainMirrorStats *stats,
+                                  virTypedParameterPtr *par,
+                                  int *npar,
+                                  int *maxpar)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2)
     ATTRIBUTE_NONNULL(3) ATTRIBUTE_NONNULL(4);
 
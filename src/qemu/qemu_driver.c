@@ -62,6 +62,7 @@
 #include "virhostmem.h"
 #include "virnetdevtap.h"
 #include "virnetdevopenvswitch.h"
+#include "virnetlink.h"
 #include "capabilities.h"
 #include "viralloc.h"
 #include "virarptable.h"
@@ -112,6 +113,7 @@
 #include "virdomaincheckpointobjlist.h"
 #include "virsocket.h"
 #include "virutil.h"
+#include "virtaskgraph.h"
 
 #define VIR_FROM_THIS VIR_FROM_QEMU
 
@@ -216,10 +218,183 @@ qemuAutostartDomain(virDomainObj *vm,
 }
 
 
+/* Classes of domains competing for a host-wide resource. Domains of
+ * a limited class are started one at a time, in the order of the
+ * enum, before the domains without such requirements. */
+typedef enum {
+    QEMU_AUTOSTART_CLASS_HOSTDEV,
+    QEMU_AUTOSTART_CLASS_HUGEPAGES,
+    QEMU_AUTOSTART_CLASS_GENERIC,
+
+    QEMU_AUTOSTART_CLASS_LAST
+} qemuAutostartClass;
+
+typedef struct _qemuAutostartItem qemuAutostartItem;
+struct _qemuAutostartItem {
+    virQEMUDriver *driver;
+    virDomainObj *vm;
+    char *name;
+    char *emulator;
+    qemuAutostartClass cls;
+    size_t cost;
+};
+
+typedef struct _qemuAutostartBatch qemuAutostartBatch;
+struct _qemuAutostartBatch {
+    virQEMUDriver *driver;
+    qemuAutostartItem *items;
+    size_t nitems;
+};
+
+
+static int
+qemuAutostartCollect(virDomainObj *vm,
+                     void *opaque)
+{
+    qemuAutostartBatch *batch = opaque;
+    qemuAutostartItem item = { .driver = batch->driver };
+
+    virObjectLock(vm);
+
+    if (vm->autostart && !virDomainObjIsActive(vm)) {
+        virDomainDef *def = vm->def;
+
+        if (def->nhostdevs > 0)
+            item.cls = QEMU_AUTOSTART_CLASS_HOSTDEV;
+        else if (def->mem.nhugepages > 0)
+            item.cls = QEMU_AUTOSTART_CLASS_HUGEPAGES;
+        else
+            item.cls = QEMU_AUTOSTART_CLASS_GENERIC;
+
+        item.cost = 1 + def->ndisks + def->nnets + def->nhostdevs;
+        item.vm = virObjectRef(vm);
+        item.name = g_strdup(def->name);
+        item.emulator = g_strdup(def->emulator);
+
+        VIR_APPEND_ELEMENT(batch->items, batch->nitems, item);
+    }
+
+    virObjectUnlock(vm);
+    return 0;
+}
+
+
+static int
+qemuAutostartItemCompare(const void *a,
+                         const void *b)
+{
+    const qemuAutostartItem *itemA = a;
+    const qemuAutostartItem *itemB = b;
+
+    if (itemA->cls != itemB->cls)
+        return itemA->cls < itemB->cls ? -1 : 1;
+
+    if (itemA->cost != itemB->cost)
+        return itemA->cost < itemB->cost ? -1 : 1;
+
+    return 0;
+}
+
+
+static int
+qemuAutostartItemRun(void *opaque)
+{
+    qemuAutostartItem *item = opaque;
+
+    /* failure to start one domain must not prevent starting the others */
+    qemuAutostartDomain(item->vm, item->driver);
+    return 0;
+}
+
+
+/* Probes every emulator used by the batch once instead of letting
+ * concurrent starts of domains race for it. */
+static void
+qemuAutostartPrepare(qemuAutostartBatch *batch)
+{
+    g_autoptr(GHashTable) emulators = virHashNew(NULL);
+    size_t i;
+
+    for (i = 0; i < batch->nitems; i++) {
+        const char *emulator = batch->items[i].emulator;
+        virQEMUCaps *qemuCaps;
+
+        if (!emulator || virHashLookup(emulators, emulator))
+            continue;
+
+        ignore_value(virHashAddEntry(emulators, emulator, (void *) emulator));
+
+        if (!(qemuCaps = virQEMUCapsCacheLookup(batch->driver->qemuCapsCache,
+                                                emulator))) {
+            virResetLastError();
+            continue;
+        }
+
+        virObjectUnref(qemuCaps);
+    }
+}
+
+
 static void
 qemuAutostartDomains(virQEMUDriver *driver)
 {
-    virDomainObjListForEach(driver->domains, false, qemuAutostartDomain, driver);
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    g_autoptr(virTaskGraph) graph = NULL;
+    qemuAutostartBatch batch = { .driver = driver };
+    ssize_t last[QEMU_AUTOSTART_CLASS_LAST];
+    size_t nworkers = cfg->autoStartMaxParallel;
+    size_t i;
+
+    virDomainObjListForEach(driver->domains, false,
+                            qemuAutostartCollect, &batch);
+
+    if (batch.nitems == 0)
+        return;
+
+    qsort(batch.items, batch.nitems, sizeof(*batch.items),
+          qemuAutostartItemCompare);
+
+    nworkers = MIN(MAX(nworkers, 1), batch.nitems);
+
+    VIR_DEBUG("Autostarting %zu domains using %zu workers",
+              batch.nitems, nworkers);
+
+    qemuAutostartPrepare(&batch);
+
+    graph = virTaskGraphNew();
+    for (i = 0; i < QEMU_AUTOSTART_CLASS_LAST; i++)
+        last[i] = -1;
+
+    for (i = 0; i < batch.nitems; i++) {
+        qemuAutostartItem *item = batch.items + i;
+        size_t dep = last[item->cls];
+        size_t ndeps = 0;
+        ssize_t id;
+
+        /* chain domains of limited classes so that they don't run
+         * concurrently with each other */
+        if (item->cls != QEMU_AUTOSTART_CLASS_GENERIC && last[item->cls] >= 0)
+            ndeps = 1;
+
+        if ((id = virTaskGraphAdd(graph, item->name,
+                                  qemuAutostartItemRun, item,
+                                  &dep, ndeps)) < 0)
+            break;
+
+        last[item->cls] = id;
+    }
+
+    if (i < batch.nitems || virTaskGraphRun(graph, nworkers) < 0) {
+        VIR_WARN("Unable to autostart domains: %s", virGetLastErrorMessage());
+        virResetLastError();
+    }
+
+    for (i = 0; i < batch.nitems; i++) {
+        virObjectUnref(batch.items[i].vm);
+        g_free(batch.items[i].name);
+        g_free(batch.items[i].emulator);
+    }
+    g_free(batch.items);
 }
 
 
@@ -602,6 +777,14 @@ qemuStateInitialize(bool privileged,
         return VIR_DRV_STATE_INIT_ERROR;
     }
 
+    if (virMutexInit(&qemu_driver->numaPlacementLock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        virMutexDestroy(&qemu_driver->lock);
+        VIR_FREE(qemu_driver);
+        return VIR_DRV_STATE_INIT_ERROR;
+    }
+
     qemu_driver->inhibitCallback = callback;
     qemu_driver->inhibitOpaque = opaque;
 
@@ -613,6 +796,9 @@ qemuStateInitialize(bool privileged,
     if (!(qemu_driver->domains = virDomainObjListNew()))
         goto error;
 
+    /* The post parse callbacks only use self-locking driver state */
+    virDomainObjListSetParallelLoad(qemu_driver->domains, true);
+
     /* Init domain events */
     qemu_driver->domainEventState = virObjectEventStateNew();
     if (!qemu_driver->domainEventState)
@@ -852,6 +1038,9 @@ qemuStateInitialize(bool privileged,
     if (!qemu_driver->qemuCapsCache)
         goto error;
 
+    virFileCacheSetRefreshInBackground(qemu_driver->qemuCapsCache,
+                                       cfg->capsRefreshInBackground);
+
     if (!(sec_managers = qemuSecurityGetNested(qemu_driver->securityManager)))
         goto error;
 
@@ -893,6 +1082,9 @@ qemuStateInitialize(bool privileged,
     if (!(qemu_driver->closeCallbacks = virCloseCallbacksNew()))
         goto error;
 
+    if (!(qemu_driver->statusSaver = qemuStatusSaverNew(qemuDomainSaveStatusNow)))
+        goto error;
+
     /* Get all the running persistent or transient configs first */
     if (virDomainObjListLoadAllConfigs(qemu_driver->domains,
                                        cfg->stateDir,
@@ -950,8 +1142,12 @@ qemuStateInitialize(bool privileged,
     if (virDriverShouldAutostart(cfg->stateDir, &autostart) < 0)
         goto error;
 
-    if (autostart)
+    if (autostart) {
+        /* Domains being reconnected hold host resources which autostarted
+         * domains must not be given. */
+        qemuProcessReconnectAllWait(qemu_driver);
         qemuAutostartDomains(qemu_driver);
+    }
 
     return VIR_DRV_STATE_INIT_COMPLETE;
 
@@ -1085,6 +1281,11 @@ qemuStateShutdownWait(void)
     virDomainObjListForEach(qemu_driver->domains, false,
                             qemuDomainObjStopWorkerIter, NULL);
     virThreadPoolDrain(qemu_driver->workerPool);
+
+    /* Make sure the latest status of all domains is on disk before the
+     * daemon goes away */
+    if (qemu_driver->statusSaver)
+        qemuStatusSaverFlush(qemu_driver->statusSaver);
     return 0;
 }
 
@@ -1100,7 +1301,10 @@ qemuStateCleanup(void)
     if (!qemu_driver)
         return -1;
 
+    qemuProcessReconnectAllWait(qemu_driver);
+    qemuStatusSaverFree(qemu_driver->statusSaver);
     virObjectUnref(qemu_driver->migrationErrors);
+    g_free(qemu_driver->numaPlacementLoad);
     virObjectUnref(qemu_driver->closeCallbacks);
     virLockManagerPluginUnref(qemu_driver->lockManager);
     virSysinfoDefFree(qemu_driver->hostsysinfo);
@@ -1124,6 +1328,7 @@ qemuStateCleanup(void)
         virPidFileRelease(qemu_driver->config->stateDir, "driver", qemu_driver->lockFD);
 
     virObjectUnref(qemu_driver->config);
+    virMutexDestroy(&qemu_driver->numaPlacementLock);
     virMutexDestroy(&qemu_driver->lock);
     VIR_FREE(qemu_driver);
 
@@ -1480,6 +1685,11 @@ qemuGetProcessInfo(unsigned long long *cpuTime, int *lastCpu, long *vm_rss,
 }
 
 
+/*
+ * @lastCpu: whether the caller needs the host CPU the vCPU ran on last to
+ *           be reported in @info. It is only available in procfs, which
+ *           is otherwise not read when taskstats can be used instead.
+ */
 static int
 qemuDomainHelperGetVcpus(virDomainObj *vm,
                          virVcpuInfoPtr info,
@@ -1487,10 +1697,13 @@ qemuDomainHelperGetVcpus(virDomainObj *vm,
                          unsigned long long *cpudelay,
                          int maxinfo,
                          unsigned char *cpumaps,
-                         int maplen)
+                         int maplen,
+                         bool lastCpu)
 {
+    g_autofree virNetlinkTaskStats *taskstats = NULL;
     size_t ncpuinfo = 0;
     size_t i;
+    int rc;
 
     if (maxinfo == 0)
         return 0;
@@ -1507,6 +1720,16 @@ qemuDomainHelperGetVcpus(virDomainObj *vm,
     if (cpumaps)
         memset(cpumaps, 0, sizeof(*cpumaps) * maxinfo);
 
+    if (info || cpudelay) {
+        taskstats = g_new0(virNetlinkTaskStats, maxinfo);
+
+        if ((rc = qemuDomainGetVcpusTaskStats(vm, taskstats, maxinfo)) < 0)
+            return -1;
+
+        if (rc == 0)
+            g_clear_pointer(&taskstats, g_free);
+    }
+
     for (i = 0; i < virDomainDefGetVcpusMax(vm->def) && ncpuinfo < maxinfo; i++) {
         virDomainVcpuDef *vcpu = virDomainDefGetVcpu(vm->def, i);
         pid_t vcpupid = qemuDomainGetVcpuPid(vm, i);
@@ -1519,13 +1742,19 @@ qemuDomainHelperGetVcpus(virDomainObj *vm,
             vcpuinfo->number = i;
             vcpuinfo->state = VIR_VCPU_RUNNING;
 
-            if (qemuGetProcessInfo(&vcpuinfo->cpuTime,
-                                   &vcpuinfo->cpu, NULL,
+            vcpuinfo->cpu = VIR_VCPU_INFO_CPU_UNAVAILABLE;
+
+            if ((!taskstats || lastCpu) &&
+                qemuGetProcessInfo(taskstats ? NULL : &vcpuinfo->cpuTime,
+                                   lastCpu ? &vcpuinfo->cpu : NULL, NULL,
                                    vm->pid, vcpupid) < 0) {
                 virReportSystemError(errno, "%s",
                                      _("cannot get vCPU placement & pCPU time"));
                 return -1;
             }
+
+            if (taskstats)
+                vcpuinfo->cpuTime = taskstats[ncpuinfo].cpuTime;
         }
 
         if (cpumaps) {
@@ -1545,8 +1774,12 @@ qemuDomainHelperGetVcpus(virDomainObj *vm,
         }
 
         if (cpudelay) {
-            if (qemuGetSchedstatDelay(&(cpudelay[ncpuinfo]), vm->pid, vcpupid) < 0)
+            if (taskstats && taskstats[ncpuinfo].hasDelay) {
+                cpudelay[ncpuinfo] = taskstats[ncpuinfo].cpuDelay;
+            } else if (qemuGetSchedstatDelay(&(cpudelay[ncpuinfo]),
+                                             vm->pid, vcpupid) < 0) {
                 return -1;
+            }
         }
 
         ncpuinfo++;
@@ -4893,7 +5126,8 @@ qemuDomainGetVcpus(virDomainPtr dom,
         goto cleanup;
     }
 
-    ret = qemuDomainHelperGetVcpus(vm, info, NULL, NULL, maxinfo, cpumaps, maplen);
+    ret = qemuDomainHelperGetVcpus(vm, info, NULL, NULL, maxinfo,
+                                   cpumaps, maplen, true);
 
  cleanup:
     virDomainObjEndAPI(&vm);
@@ -6384,7 +6618,7 @@ static char
         !(flags & VIR_DOMAIN_XML_INACTIVE))
         flags &= ~VIR_DOMAIN_XML_UPDATE_CPU;
 
-    ret = qemuDomainFormatXML(driver, vm, flags);
+    ret = qemuDomainFormatXMLCached(driver, vm, flags);
 
  cleanup:
     virDomainObjEndAPI(&vm);
@@ -6715,6 +6949,8 @@ qemuDomainDefineXMLFlags(virConnectPtr conn,
         goto cleanup;
     def = NULL;
 
+    qemuDomainXMLCacheInvalidate(vm);
+
     if (!oldDef && qemuDomainNamePathsCleanup(cfg, vm->def->name, false) < 0)
         goto cleanup;
 
@@ -12691,10 +12927,12 @@ qemuDomainGetJobStats(virDomainPtr dom,
     qemuDomainObjPrivate *priv;
     g_autoptr(qemuDomainJobInfo) jobInfo = NULL;
     bool completed = !!(flags & VIR_DOMAIN_JOB_STATS_COMPLETED);
+    bool diskMirrors = !!(flags & VIR_DOMAIN_JOB_STATS_DISK_MIRRORS);
     int ret = -1;
 
     virCheckFlags(VIR_DOMAIN_JOB_STATS_COMPLETED |
-                  VIR_DOMAIN_JOB_STATS_KEEP_COMPLETED, -1);
+                  VIR_DOMAIN_JOB_STATS_KEEP_COMPLETED |
+                  VIR_DOMAIN_JOB_STATS_DISK_MIRRORS, -1);
 
     if (!(vm = qemuDomainObjFromDomain(dom)))
         goto cleanup;
@@ -12715,7 +12953,8 @@ qemuDomainGetJobStats(virDomainPtr dom,
         goto cleanup;
     }
 
-    ret = qemuDomainJobInfoToParams(jobInfo, type, params, nparams);
+    ret = qemuDomainJobInfoToParams(jobInfo, type, params, nparams,
+                                    diskMirrors);
 
     if (completed && ret == 0 && !(flags & VIR_DOMAIN_JOB_STATS_KEEP_COMPLETED))
         g_clear_pointer(&priv->job.completed, qemuDomainJobInfoFree);
@@ -17950,7 +18189,7 @@ qemuDomainGetStatsVcpu(virQEMUDriver *driver,
 
     if (qemuDomainHelperGetVcpus(dom, cpuinfo, cpuwait, cpudelay,
                                  virDomainDefGetVcpus(dom->def),
-                                 NULL, 0) < 0) {
+                                 NULL, 0, false) < 0) {
         virResetLastError();
         ret = 0; /* it's ok to be silent and go ahead */
         goto cleanup;
@@ -18497,23 +18736,6 @@ qemuDomainGetStatsIOThread(virQEMUDriver *driver,
 }
 
 
-static int
-qemuDomainGetStatsPerfOneEvent(virPerf *perf,
-                               virPerfEventType type,
-                               virTypedParamList *params)
-{
-    uint64_t value = 0;
-
-    if (virPerfReadEvent(perf, type, &value) < 0)
-        return -1;
-
-    if (virTypedParamListAddULLong(params, value, "perf.%s",
-                                   virPerfEventTypeToString(type)) < 0)
-        return -1;
-
-    return 0;
-}
-
 static int
 qemuDomainGetStatsPerf(virQEMUDriver *driver G_GNUC_UNUSED,
                        virDomainObj *dom,
@@ -18522,12 +18744,20 @@ qemuDomainGetStatsPerf(virQEMUDriver *driver G_GNUC_UNUSED,
 {
     size_t i;
     qemuDomainObjPrivate *priv = dom->privateData;
+    uint64_t values[VIR_PERF_EVENT_LAST] = { 0 };
+
+    if (!priv->perf)
+        return 0;
+
+    if (virPerfReadEvents(priv->perf, values) < 0)
+        return -1;
 
     for (i = 0; i < VIR_PERF_EVENT_LAST; i++) {
         if (!virPerfEventIsEnabled(priv->perf, i))
              continue;
 
-        if (qemuDomainGetStatsPerfOneEvent(priv->perf, i, params) < 0)
+        if (virTypedParamListAddULLong(params, values[i], "perf.%s",
+                                       virPerfEventTypeToString(i)) < 0)
             return -1;
     }
 
@@ -32,6 +32,7 @@
 #include "viralloc.h"
 #include "virlog.h"
 #include "virstring.h"
+#include "virtaskgraph.h"
 #include "virtime.h"
 #include "virtpm.h"
 #include "virpidfile.h"
@@ -163,6 +164,88 @@ qemuExtDevicesCleanupHost(virQEMUDriver *driver,
 }
 
 
+typedef struct _qemuExtDevicesStartData qemuExtDevicesStartData;
+struct _qemuExtDevicesStartData {
+    virQEMUDriver *driver;
+    virDomainObj *vm;
+    virLogManager *logManager;
+    bool incomingMigration;
+    void *dev;
+};
+
+
+static int
+qemuExtDevicesStartVhostUserGPU(void *opaque)
+{
+    qemuExtDevicesStartData *data = opaque;
+
+    return qemuExtVhostUserGPUStart(data->driver, data->vm, data->dev);
+}
+
+
+static int
+qemuExtDevicesStartTPM(void *opaque)
+{
+    qemuExtDevicesStartData *data = opaque;
+
+    return qemuExtTPMStart(data->driver, data->vm, data->incomingMigration);
+}
+
+
+static int
+qemuExtDevicesStartSlirp(void *opaque)
+{
+    qemuExtDevicesStartData *data = opaque;
+    virDomainNetDef *net = data->dev;
+
+    return qemuSlirpStart(QEMU_DOMAIN_NETWORK_PRIVATE(net)->slirp, data->vm,
+                          data->driver, net, data->incomingMigration);
+}
+
+
+static int
+qemuExtDevicesStartVirtioFS(void *opaque)
+{
+    qemuExtDevicesStartData *data = opaque;
+
+    return qemuVirtioFSStart(data->logManager, data->driver, data->vm, data->dev);
+}
+
+
+static qemuExtDevicesStartData *
+qemuExtDevicesStartDataAdd(qemuExtDevicesStartData ***list,
+                           size_t *nlist,
+                           const qemuExtDevicesStartData *tmpl,
+                           void *dev)
+{
+    qemuExtDevicesStartData *data = g_new0(qemuExtDevicesStartData, 1);
+
+    *data = *tmpl;
+    data->dev = dev;
+
+    VIR_APPEND_ELEMENT(*list, *nlist, data);
+    return (*list)[*nlist - 1];
+}
+
+
+/**
+ * qemuExtDevicesStart:
+ * @driver: QEMU driver
+ * @vm: domain
+ * @logManager: log manager used by virtiofsd
+ * @incomingMigration: whether the domain is started for incoming migration
+ *
+ * Starts helper processes for external devices of @vm. Helpers do not
+ * depend on each other and most of the time spent here is waiting for
+ * them to come up, so they are started concurrently. The only exception
+ * are slirp helpers which share the D-Bus daemon and VM state list of
+ * the domain and are thus started one after another.
+ *
+ * On failure helpers which were already started are left running and
+ * the caller is expected to clean them up via qemuExtDevicesStop.
+ *
+ * Returns 0 on success, -1 on error.
+ */
 int
 qemuExtDevicesStart(virQEMUDriver *driver,
                     virDomainObj *vm,
@@ -170,41 +253,81 @@ qemuExtDevicesStart(virQEMUDriver *driver,
                     bool incomingMigration)
 {
     virDomainDef *def = vm->def;
+    g_autoptr(virTaskGraph) graph = virTaskGraphNew();
+    qemuExtDevicesStartData tmpl = {
+        .driver = driver,
+        .vm = vm,
+        .logManager = logManager,
+        .incomingMigration = incomingMigration,
+    };
+    qemuExtDevicesStartData **data = NULL;
+    size_t ndata = 0;
+    ssize_t lastSlirp = -1;
+    ssize_t id;
     size_t i;
+    int ret = -1;
 
     for (i = 0; i < def->nvideos; i++) {
         virDomainVideoDef *video = def->videos[i];
 
         if (video->backend == VIR_DOMAIN_VIDEO_BACKEND_TYPE_VHOSTUSER) {
-            if (qemuExtVhostUserGPUStart(driver, vm, video) < 0)
-                return -1;
+            if (virTaskGraphAdd(graph, "vhost-user-gpu",
+                                qemuExtDevicesStartVhostUserGPU,
+                                qemuExtDevicesStartDataAdd(&data, &ndata, &tmpl, video),
+                                NULL, 0) < 0)
+                goto cleanup;
         }
     }
 
-    if (def->ntpms > 0 && qemuExtTPMStart(driver, vm, incomingMigration) < 0)
-        return -1;
+    if (def->ntpms > 0) {
+        if (virTaskGraphAdd(graph, "tpm", qemuExtDevicesStartTPM,
+                            qemuExtDevicesStartDataAdd(&data, &ndata, &tmpl, NULL),
+                            NULL, 0) < 0)
+            goto cleanup;
+    }
 
     for (i = 0; i < def->nnets; i++) {
         virDomainNetDef *net = def->nets[i];
-        qemuSlirp *slirp = QEMU_DOMAIN_NETWORK_PRIVATE(net)->slirp;
+        size_t dep = lastSlirp;
 
-        if (slirp &&
-            qemuSlirpStart(slirp, vm, driver, net, incomingMigration) < 0)
-            return -1;
+        if (!QEMU_DOMAIN_NETWORK_PRIVATE(net)->slirp)
+            continue;
+
+        if ((id = virTaskGraphAdd(graph, "slirp", qemuExtDevicesStartSlirp,
+                                  qemuExtDevicesStartDataAdd(&data, &ndata, &tmpl, net),
+                                  &dep, lastSlirp >= 0 ? 1 : 0)) < 0)
+            goto cleanup;
+
+        lastSlirp = id;
     }
 
     for (i = 0; i < def->nfss; i++) {
         virDomainFSDef *fs = def->fss[i];
 
-        if (fs->fsdriver == VIR_DOMAIN_FS_DRIVER_TYPE_VIRTIOFS) {
-            if (fs->sock)
-                QEMU_DOMAIN_FS_PRIVATE(fs)->vhostuser_fs_sock = g_strdup(fs->sock);
-            else if (qemuVirtioFSStart(logManager, driver, vm, fs) < 0)
-                return -1;
+        if (fs->fsdriver != VIR_DOMAIN_FS_DRIVER_TYPE_VIRTIOFS)
+            continue;
+
+        if (fs->sock) {
+            QEMU_DOMAIN_FS_PRIVATE(fs)->vhostuser_fs_sock = g_strdup(fs->sock);
+            continue;
         }
+
+        if (virTaskGraphAdd(graph, "virtiofs", qemuExtDevicesStartVirtioFS,
+                            qemuExtDevicesStartDataAdd(&data, &ndata, &tmpl, fs),
+                            NULL, 0) < 0)
+            goto cleanup;
     }
 
-    return 0;
+    if (virTaskGraphRun(graph, ndata) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < ndata; i++)
+        g_free(data[i]);
+    g_free(data);
+    return ret;
 }
 
 
@@ -26,6 +26,8 @@
 #include <poll.h>
 
 #include "qemu_migration.h"
+#define LIBVIRT_QEMU_MIGRATIONPRIV_H_ALLOW
+#include "qemu_migrationpriv.h"
 #include "qemu_migration_cookie.h"
 #include "qemu_migration_params.h"
 #include "qemu_monitor.h"
@@ -52,6 +54,7 @@
 #include "virtime.h"
 #include "locking/domain_lock.h"
 #include "rpc/virnetsocket.h"
+#include "rpc/virnetprotocol.h"
 #include "storage_source_conf.h"
 #include "viruri.h"
 #include "virhook.h"
@@ -1085,6 +1088,488 @@ qemuMigrationSrcNBDStorageCopyOne(virQEMUDriver *driver,
 }
 
 
+/* How often the storage migration scheduler re-evaluates the mirrors */
+#define QEMU_MIGRATION_NBD_SCHED_INTERVAL 1000
+
+/* Guest writes to a disk are expected to keep the mirror busy for this
+ * many seconds, which makes heavily written disks start sooner */
+#define QEMU_MIGRATION_NBD_DIRTY_HORIZON 60
+
+/* Part (1/N) of the bandwidth split evenly among all running mirrors so
+ * that ready mirrors can keep up with guest writes */
+#define QEMU_MIGRATION_NBD_BANDWIDTH_RESERVE 4
+
+
+static void
+qemuMigrationNBDSchedulerFree(qemuMigrationNBDScheduler *sched)
+{
+    if (!sched)
+        return;
+
+    g_free(sched->mirrors);
+    g_free(sched);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(qemuMigrationNBDScheduler, qemuMigrationNBDSchedulerFree);
+
+
+/**
+ * qemuMigrationSrcNBDSchedulerSample:
+ * @driver: qemu driver
+ * @vm: domain
+ * @sched: storage migration scheduler
+ * @capacity: refresh capacity of the disks too
+ *
+ * Sample block statistics of the disks handled by @sched to estimate how
+ * fast the guest is writing to them.
+ *
+ * Returns 0 on success, -1 otherwise.
+ */
+static int
+qemuMigrationSrcNBDSchedulerSample(virQEMUDriver *driver,
+                                   virDomainObj *vm,
+                                   qemuMigrationNBDScheduler *sched,
+                                   bool capacity)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+    bool blockdev = virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_BLOCKDEV);
+    g_autoptr(GHashTable) blockstats = NULL;
+    unsigned long long now;
+    size_t i;
+    int nstats;
+    int rc = 0;
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+
+    if (qemuDomainObjEnterMonitorAsync(driver, vm,
+                                       QEMU_ASYNC_JOB_MIGRATION_OUT) < 0)
+        return -1;
+
+    nstats = qemuMonitorGetAllBlockStatsInfo(priv->mon, &blockstats, false);
+
+    if (capacity && nstats >= 0) {
+        if (blockdev)
+            rc = qemuMonitorBlockStatsUpdateCapacityBlockdev(priv->mon, blockstats);
+        else
+            rc = qemuMonitorBlockStatsUpdateCapacity(priv->mon, blockstats, false);
+    }
+
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || nstats < 0 || rc < 0)
+        return -1;
+
+    for (i = 0; i < sched->nmirrors; i++) {
+        qemuMigrationNBDMirror *mirror = sched->mirrors + i;
+        virDomainDiskDef *disk = mirror->disk;
+        const char *entryname = disk->info.alias;
+        qemuBlockStats *stats;
+
+        if (blockdev && QEMU_DOMAIN_DISK_PRIVATE(disk)->qomName)
+            entryname = QEMU_DOMAIN_DISK_PRIVATE(disk)->qomName;
+
+        if (capacity) {
+            /* capacity is reported only per node-name with -blockdev */
+            const char *capname = blockdev ? disk->src->nodeformat : entryname;
+
+            if (capname && (stats = virHashLookup(blockstats, capname)))
+                mirror->capacity = stats->capacity;
+        }
+
+        if (!entryname || !(stats = virHashLookup(blockstats, entryname)))
+            continue;
+
+        if (sched->sampled > 0 && now > sched->sampled &&
+            stats->wr_bytes >= mirror->written) {
+            mirror->dirtyRate = (stats->wr_bytes - mirror->written) * 1000 /
+                                (now - sched->sampled);
+        }
+        mirror->written = stats->wr_bytes;
+    }
+
+    sched->sampled = now;
+    return 0;
+}
+
+
+/**
+ * qemuMigrationSrcNBDSchedulerNew:
+ * @driver: qemu driver
+ * @vm: domain
+ * @speed: aggregate bandwidth limit in bytes/s
+ * @nmigrate_disks: number of items in @migrate_disks
+ * @migrate_disks: disks selected for migration
+ *
+ * Create a scheduler for copying the disks which need to be migrated and
+ * reset the per-disk statistics of the current job accordingly.
+ *
+ * Returns the scheduler on success, NULL otherwise.
+ */
+static qemuMigrationNBDScheduler *
+qemuMigrationSrcNBDSchedulerNew(virQEMUDriver *driver,
+                                virDomainObj *vm,
+                                unsigned long long speed,
+                                size_t nmigrate_disks,
+                                const char **migrate_disks)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+    qemuDomainMirrorStats *stats = &priv->job.current->mirrorStats;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    g_autoptr(qemuMigrationNBDScheduler) sched = g_new0(qemuMigrationNBDScheduler, 1);
+    size_t i;
+
+    sched->speed = speed;
+    sched->maxSyncing = cfg->migrationMaxDiskMirrors;
+    sched->mirrors = g_new0(qemuMigrationNBDMirror, vm->def->ndisks);
+
+    qemuDomainMirrorStatsClear(stats);
+    stats->disks = g_new0(qemuDomainMirrorDiskStats, vm->def->ndisks);
+
+    for (i = 0; i < vm->def->ndisks; i++) {
+        virDomainDiskDef *disk = vm->def->disks[i];
+
+        /* check whether disk should be migrated */
+        if (!qemuMigrationAnyCopyDisk(disk, nmigrate_disks, migrate_disks))
+            continue;
+
+        sched->mirrors[sched->nmirrors].disk = disk;
+        stats->disks[sched->nmirrors].dst = g_strdup(disk->dst);
+        sched->nmirrors++;
+    }
+    stats->ndisks = sched->nmirrors;
+
+    if (sched->nmirrors == 0)
+        return g_steal_pointer(&sched);
+
+    if (qemuMigrationSrcNBDSchedulerSample(driver, vm, sched, true) < 0)
+        return NULL;
+
+    for (i = 0; i < sched->nmirrors; i++) {
+        qemuMigrationNBDMirror *mirror = sched->mirrors + i;
+
+        if (mirror->capacity == 0)
+            mirror->capacity = mirror->disk->src->capacity;
+
+        stats->disks[i].total = mirror->capacity;
+    }
+
+    return g_steal_pointer(&sched);
+}
+
+
+static bool
+qemuMigrationSrcNBDMirrorIsReady(qemuMigrationNBDMirror *mirror)
+{
+    qemuBlockJobData *job;
+    bool ready;
+
+    if (!mirror->started ||
+        !(job = qemuBlockJobDiskGetJob(mirror->disk)))
+        return false;
+
+    ready = job->state == VIR_DOMAIN_BLOCK_JOB_READY;
+    virObjectUnref(job);
+
+    return ready;
+}
+
+
+/**
+ * qemuMigrationSrcNBDSchedulerNext:
+ * @sched: storage migration scheduler
+ *
+ * Pick the disk which should be mirrored next. The largest disks are
+ * started first, with guest writes counted as additional data to copy.
+ *
+ * Returns the mirror to start or NULL if all of them were started.
+ */
+qemuMigrationNBDMirror *
+qemuMigrationSrcNBDSchedulerNext(qemuMigrationNBDScheduler *sched)
+{
+    qemuMigrationNBDMirror *next = NULL;
+    unsigned long long nextSize = 0;
+    size_t i;
+
+    for (i = 0; i < sched->nmirrors; i++) {
+        qemuMigrationNBDMirror *mirror = sched->mirrors + i;
+        unsigned long long size;
+
+        if (mirror->started)
+            continue;
+
+        size = mirror->capacity +
+               mirror->dirtyRate * QEMU_MIGRATION_NBD_DIRTY_HORIZON;
+
+        if (!next || size > nextSize) {
+            next = mirror;
+            nextSize = size;
+        }
+    }
+
+    return next;
+}
+
+
+/**
+ * qemuMigrationSrcNBDSchedulerSplit:
+ * @sched: storage migration scheduler
+ * @stats: progress of the mirrors handled by @sched
+ * @bandwidth: array of @sched->nmirrors items to fill in
+ *
+ * Split the bandwidth limit of the migration among running mirrors. Each
+ * of them gets an equal part of QEMU_MIGRATION_NBD_BANDWIDTH_RESERVE and
+ * the rest is distributed according to the amount of data the mirrors
+ * still need to copy, so that bandwidth freed by converged mirrors is
+ * used by the remaining ones. Mirrors which were not started yet get 0.
+ *
+ * The bandwidth limit of @sched must not be 0 (unlimited).
+ */
+void
+qemuMigrationSrcNBDSchedulerSplit(qemuMigrationNBDScheduler *sched,
+                                  qemuDomainMirrorStats *stats,
+                                  unsigned long long *bandwidth)
+{
+    g_autofree double *weights = g_new0(double, sched->nmirrors);
+    double totalWeight = 0;
+    unsigned long long reserve;
+    unsigned long long pool;
+    size_t nstarted = 0;
+    size_t i;
+
+    for (i = 0; i < sched->nmirrors; i++) {
+        qemuMigrationNBDMirror *mirror = sched->mirrors + i;
+        qemuDomainMirrorDiskStats *disk = stats->disks + i;
+        unsigned long long remaining = mirror->capacity;
+
+        bandwidth[i] = 0;
+
+        if (!mirror->started)
+            continue;
+
+        if (disk->started)
+            remaining = disk->total > disk->transferred ?
+                        disk->total - disk->transferred : 0;
+
+        weights[i] = (double) remaining + mirror->dirtyRate;
+        totalWeight += weights[i];
+        nstarted++;
+    }
+
+    if (nstarted == 0)
+        return;
+
+    reserve = sched->speed / (QEMU_MIGRATION_NBD_BANDWIDTH_RESERVE * nstarted);
+    pool = sched->speed - reserve * nstarted;
+
+    for (i = 0; i < sched->nmirrors; i++) {
+        if (!sched->mirrors[i].started)
+            continue;
+
+        bandwidth[i] = reserve;
+
+        if (totalWeight > 0)
+            bandwidth[i] += pool * (weights[i] / totalWeight);
+        else
+            bandwidth[i] += pool / nstarted;
+
+        if (bandwidth[i] == 0)
+            bandwidth[i] = 1;
+    }
+}
+
+
+/**
+ * qemuMigrationSrcNBDSchedulerBalance:
+ * @driver: qemu driver
+ * @vm: domain
+ * @sched: storage migration scheduler
+ *
+ * Apply the split of the migration bandwidth computed by
+ * qemuMigrationSrcNBDSchedulerSplit to the running mirrors. Nothing is
+ * done when the bandwidth is not limited.
+ *
+ * Returns 0 on success, -1 otherwise.
+ */
+static int
+qemuMigrationSrcNBDSchedulerBalance(virQEMUDriver *driver,
+                                    virDomainObj *vm,
+                                    qemuMigrationNBDScheduler *sched)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+    qemuDomainMirrorStats *stats = &priv->job.current->mirrorStats;
+    g_autofree unsigned long long *bandwidth = NULL;
+    size_t i;
+
+    if (sched->speed == 0)
+        return 0;
+
+    bandwidth = g_new0(unsigned long long, sched->nmirrors);
+    qemuMigrationSrcNBDSchedulerSplit(sched, stats, bandwidth);
+
+    for (i = 0; i < sched->nmirrors; i++) {
+        qemuMigrationNBDMirror *mirror = sched->mirrors + i;
+        unsigned long long diff;
+        qemuBlockJobData *job;
+        int rc;
+
+        if (!mirror->started)
+            continue;
+
+        /* avoid talking to QEMU because of negligible changes */
+        diff = bandwidth[i] > mirror->bandwidth ?
+               bandwidth[i] - mirror->bandwidth :
+               mirror->bandwidth - bandwidth[i];
+        if (diff <= mirror->bandwidth / 8)
+            continue;
+
+        if (!(job = qemuBlockJobDiskGetJob(mirror->disk)))
+            continue;
+
+        VIR_DEBUG("Changing bandwidth of disk mirror '%s' from %llu to %llu",
+                  mirror->disk->dst, mirror->bandwidth, bandwidth[i]);
+
+        if (qemuDomainObjEnterMonitorAsync(driver, vm,
+                                           QEMU_ASYNC_JOB_MIGRATION_OUT) < 0) {
+            virObjectUnref(job);
+            return -1;
+        }
+
+        rc = qemuMonitorBlockJobSetSpeed(priv->mon, job->name, bandwidth[i]);
+        virObjectUnref(job);
+
+        if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0)
+            return -1;
+
+        mirror->bandwidth = bandwidth[i];
+        stats->disks[i].bandwidth = bandwidth[i];
+    }
+
+    return 0;
+}
+
+
+/**
+ * qemuMigrationSrcNBDSchedulerStart:
+ * @driver: qemu driver
+ * @vm: domain
+ * @sched: storage migration scheduler
+ *
+ * Start mirrors of the disks handled by @sched while the number of mirrors
+ * performing their initial copy is below the configured limit.
+ *
+ * Returns 0 on success, -1 otherwise.
+ */
+static int
+qemuMigrationSrcNBDSchedulerStart(virQEMUDriver *driver,
+                                  virDomainObj *vm,
+                                  qemuMigrationNBDScheduler *sched,
+                                  const char *host,
+                                  int port,
+                                  const char *socket,
+                                  bool mirror_shallow,
+                                  const char *tlsAlias,
+                                  unsigned int flags)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+    qemuDomainMirrorStats *stats = &priv->job.current->mirrorStats;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    qemuMigrationNBDMirror *mirror;
+    size_t nstarted = 0;
+    size_t nsyncing = 0;
+    size_t i;
+
+    for (i = 0; i < sched->nmirrors; i++) {
+        if (!sched->mirrors[i].started)
+            continue;
+
+        nstarted++;
+        if (!qemuMigrationSrcNBDMirrorIsReady(sched->mirrors + i))
+            nsyncing++;
+    }
+
+    if (sched->maxSyncing > 0 && nsyncing >= sched->maxSyncing)
+        return 0;
+
+    if (!(mirror = qemuMigrationSrcNBDSchedulerNext(sched)))
+        return 0;
+
+    do {
+        qemuDomainMirrorDiskStats *disk = stats->disks + (mirror - sched->mirrors);
+
+        /* the final split is computed by qemuMigrationSrcNBDSchedulerBalance */
+        if (sched->speed > 0)
+            mirror->bandwidth = MAX(sched->speed / (nstarted + 1), 1);
+
+        VIR_DEBUG("Starting drive mirror for disk '%s' (capacity=%llu, "
+                  "dirtyRate=%llu)", mirror->disk->dst,
+                  mirror->capacity, mirror->dirtyRate);
+
+        if (qemuMigrationSrcNBDStorageCopyOne(driver, vm, mirror->disk,
+                                              host, port, socket,
+                                              mirror->bandwidth, mirror_shallow,
+                                              tlsAlias, flags) < 0)
+            return -1;
+
+        mirror->started = true;
+        disk->started = true;
+        disk->bandwidth = mirror->bandwidth;
+        nstarted++;
+        nsyncing++;
+
+        if (virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0) {
+            VIR_WARN("Failed to save status on vm %s", vm->def->name);
+            return -1;
+        }
+    } while ((sched->maxSyncing == 0 || nsyncing < sched->maxSyncing) &&
+             (mirror = qemuMigrationSrcNBDSchedulerNext(sched)));
+
+    return qemuMigrationSrcNBDSchedulerBalance(driver, vm, sched);
+}
+
+
+static bool
+qemuMigrationSrcNBDSchedulerPending(qemuMigrationNBDScheduler *sched)
+{
+    size_t i;
+
+    for (i = 0; i < sched->nmirrors; i++) {
+        if (!sched->mirrors[i].started)
+            return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * qemuMigrationSrcNBDSchedulerUpdate:
+ * @driver: qemu driver
+ * @vm: domain
+ * @sched: storage migration scheduler
+ *
+ * Refresh progress of the running mirrors and guest write rates and
+ * redistribute the bandwidth accordingly.
+ *
+ * Returns 0 on success, -1 otherwise.
+ */
+static int
+qemuMigrationSrcNBDSchedulerUpdate(virQEMUDriver *driver,
+                                   virDomainObj *vm,
+                                   qemuMigrationNBDScheduler *sched)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+
+    if (qemuMigrationSrcFetchMirrorStats(driver, vm,
+                                         QEMU_ASYNC_JOB_MIGRATION_OUT,
+                                         priv->job.current) < 0)
+        return -1;
+
+    if (qemuMigrationSrcNBDSchedulerSample(driver, vm, sched, false) < 0)
+        return -1;
+
+    return qemuMigrationSrcNBDSchedulerBalance(driver, vm, sched);
+}
+
+
 /**
  * qemuMigrationSrcNBDStorageCopy:
  * @driver: qemu driver
@@ -1094,7 +1579,9 @@ qemuMigrationSrcNBDStorageCopyOne(virQEMUDriver *driver,
  * @speed: bandwidth limit in MiB/s
  *
  * Migrate non-shared storage using the NBD protocol to the server running
- * inside the qemu process on dst and wait until the copy converges.
+ * inside the qemu process on dst and wait until the copy converges. Disks
+ * are scheduled by qemuMigrationSrcNBDSchedulerStart and @speed is shared
+ * by all running mirrors.
  * On failure, the caller is expected to call qemuMigrationSrcNBDCopyCancel
  * to stop all running copy operations.
  *
@@ -1116,11 +1603,10 @@ qemuMigrationSrcNBDStorageCopy(virQEMUDriver *driver,
 {
     qemuDomainObjPrivate *priv = vm->privateData;
     int port;
-    size_t i;
     unsigned long long mirror_speed = speed;
     bool mirror_shallow = flags & VIR_MIGRATE_NON_SHARED_INC;
     int rv;
-    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    g_autoptr(qemuMigrationNBDScheduler) sched = NULL;
     g_autoptr(virURI) uri = NULL;
     const char *socket = NULL;
 
@@ -1134,6 +1620,10 @@ qemuMigrationSrcNBDStorageCopy(virQEMUDriver *driver,
     }
     mirror_speed <<= 20;
 
+    /* the maximum means no limit was set, there's nothing to share then */
+    if (speed == QEMU_DOMAIN_MIG_BANDWIDTH_MAX)
+        mirror_speed = 0;
+
     /* steal NBD port and thus prevent its propagation back to destination */
     port = mig->nbd->port;
     mig->nbd->port = 0;
@@ -1172,27 +1662,23 @@ qemuMigrationSrcNBDStorageCopy(virQEMUDriver *driver,
         }
     }
 
-    for (i = 0; i < vm->def->ndisks; i++) {
-        virDomainDiskDef *disk = vm->def->disks[i];
+    if (!(sched = qemuMigrationSrcNBDSchedulerNew(driver, vm, mirror_speed,
+                                                  nmigrate_disks,
+                                                  migrate_disks)))
+        return -1;
 
-        /* check whether disk should be migrated */
-        if (!qemuMigrationAnyCopyDisk(disk, nmigrate_disks, migrate_disks))
-            continue;
+    while (true) {
+        unsigned long long now;
 
-        if (qemuMigrationSrcNBDStorageCopyOne(driver, vm, disk, host, port,
-                                              socket,
-                                              mirror_speed, mirror_shallow,
-                                              tlsAlias, flags) < 0)
+        if ((rv = qemuMigrationSrcNBDStorageCopyReady(vm, QEMU_ASYNC_JOB_MIGRATION_OUT)) < 0)
             return -1;
 
-        if (virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0) {
-            VIR_WARN("Failed to save status on vm %s", vm->def->name);
-            return -1;
-        }
-    }
+        if (rv == 1 && !qemuMigrationSrcNBDSchedulerPending(sched))
+            break;
 
-    while ((rv = qemuMigrationSrcNBDStorageCopyReady(vm, QEMU_ASYNC_JOB_MIGRATION_OUT)) != 1) {
-        if (rv < 0)
+        if (qemuMigrationSrcNBDSchedulerStart(driver, vm, sched, host, port,
+                                              socket, mirror_shallow,
+                                              tlsAlias, flags) < 0)
             return -1;
 
         if (priv->job.abortJob) {
@@ -1209,7 +1695,11 @@ qemuMigrationSrcNBDStorageCopy(virQEMUDriver *driver,
             return -1;
         }
 
-        if (virDomainObjWait(vm) < 0)
+        if (virTimeMillisNow(&now) < 0 ||
+            virDomainObjWaitUntil(vm, now + QEMU_MIGRATION_NBD_SCHED_INTERVAL) < 0)
+            return -1;
+
+        if (qemuMigrationSrcNBDSchedulerUpdate(driver, vm, sched) < 0)
             return -1;
     }
 
@@ -1762,106 +2252,439 @@ qemuMigrationJobCheckStatus(virQEMUDriver *driver,
 }
 
 
-enum qemuMigrationCompletedFlags {
-    QEMU_MIGRATION_COMPLETED_ABORT_ON_ERROR = (1 << 0),
-    /* This flag should only be set when run on src host */
-    QEMU_MIGRATION_COMPLETED_CHECK_STORAGE  = (1 << 1),
-    QEMU_MIGRATION_COMPLETED_POSTCOPY       = (1 << 2),
-    QEMU_MIGRATION_COMPLETED_PRE_SWITCHOVER = (1 << 3),
-};
-
-
+enum qemuMigrationCompletedFlags {
+    QEMU_MIGRATION_COMPLETED_ABORT_ON_ERROR = (1 << 0),
+    /* This flag should only be set when run on src host */
+    QEMU_MIGRATION_COMPLETED_CHECK_STORAGE  = (1 << 1),
+    QEMU_MIGRATION_COMPLETED_POSTCOPY       = (1 << 2),
+    QEMU_MIGRATION_COMPLETED_PRE_SWITCHOVER = (1 << 3),
+};
+
+
+/**
+ * Returns 1 if migration completed successfully,
+ *         0 if the domain is still being migrated,
+ *         -1 migration failed,
+ *         -2 something else failed, we need to cancel migration.
+ */
+static int
+qemuMigrationAnyCompleted(virQEMUDriver *driver,
+                          virDomainObj *vm,
+                          qemuDomainAsyncJob asyncJob,
+                          virConnectPtr dconn,
+                          unsigned int flags)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+    qemuDomainJobInfo *jobInfo = priv->job.current;
+    int pauseReason;
+
+    if (qemuMigrationJobCheckStatus(driver, vm, asyncJob) < 0)
+        goto error;
+
+    /* This flag should only be set when run on src host */
+    if (flags & QEMU_MIGRATION_COMPLETED_CHECK_STORAGE &&
+        qemuMigrationSrcNBDStorageCopyReady(vm, asyncJob) < 0)
+        goto error;
+
+    if (flags & QEMU_MIGRATION_COMPLETED_ABORT_ON_ERROR &&
+        virDomainObjGetState(vm, &pauseReason) == VIR_DOMAIN_PAUSED &&
+        pauseReason == VIR_DOMAIN_PAUSED_IOERROR) {
+        virReportError(VIR_ERR_OPERATION_FAILED, _("%s: %s"),
+                       qemuMigrationJobName(vm), _("failed due to I/O error"));
+        goto error;
+    }
+
+    if (dconn && virConnectIsAlive(dconn) <= 0) {
+        virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                       _("Lost connection to destination host"));
+        goto error;
+    }
+
+    /* Migration was paused before serializing device state, let's return to
+     * the caller so that it can finish all block jobs, resume migration, and
+     * wait again for the real end of the migration.
+     */
+    if (flags & QEMU_MIGRATION_COMPLETED_PRE_SWITCHOVER &&
+        jobInfo->status == QEMU_DOMAIN_JOB_STATUS_PAUSED) {
+        VIR_DEBUG("Migration paused before switchover");
+        return 1;
+    }
+
+    /* In case of postcopy the source considers migration completed at the
+     * moment it switched from active to postcopy-active state. The destination
+     * will continue waiting until the migrate state changes to completed.
+     */
+    if (flags & QEMU_MIGRATION_COMPLETED_POSTCOPY &&
+        jobInfo->status == QEMU_DOMAIN_JOB_STATUS_POSTCOPY) {
+        VIR_DEBUG("Migration switched to post-copy");
+        return 1;
+    }
+
+    if (jobInfo->status == QEMU_DOMAIN_JOB_STATUS_QEMU_COMPLETED)
+        return 1;
+    else
+        return 0;
+
+ error:
+    switch (jobInfo->status) {
+    case QEMU_DOMAIN_JOB_STATUS_MIGRATING:
+    case QEMU_DOMAIN_JOB_STATUS_POSTCOPY:
+    case QEMU_DOMAIN_JOB_STATUS_PAUSED:
+        /* The migration was aborted by us rather than QEMU itself. */
+        jobInfo->status = QEMU_DOMAIN_JOB_STATUS_FAILED;
+        return -2;
+
+    case QEMU_DOMAIN_JOB_STATUS_QEMU_COMPLETED:
+        /* Something failed after QEMU already finished the migration. */
+        jobInfo->status = QEMU_DOMAIN_JOB_STATUS_FAILED;
+        return -1;
+
+    case QEMU_DOMAIN_JOB_STATUS_FAILED:
+    case QEMU_DOMAIN_JOB_STATUS_CANCELED:
+        /* QEMU aborted the migration. */
+        return -1;
+
+    case QEMU_DOMAIN_JOB_STATUS_ACTIVE:
+    case QEMU_DOMAIN_JOB_STATUS_COMPLETED:
+    case QEMU_DOMAIN_JOB_STATUS_NONE:
+        /* Impossible. */
+        break;
+    }
+
+    return -1;
+}
+
+
+/* How often the convergence controller looks at migration statistics */
+#define QEMU_MIGRATION_CONVERGENCE_INTERVAL 1000
+
+/* A RAM iteration has to shrink the amount of remaining memory at least
+ * by 1/N, otherwise the migration is considered stalled */
+#define QEMU_MIGRATION_CONVERGENCE_PROGRESS 10
+
+/* Number of stalled RAM iterations before the controller intervenes */
+#define QEMU_MIGRATION_CONVERGENCE_STALLS 2
+
+/* Number of stalled RAM iterations before switching to post-copy */
+#define QEMU_MIGRATION_CONVERGENCE_POSTCOPY_STALLS 5
+
+/* QEMU's default for the cpu-throttle-increment migration parameter and
+ * the limit the controller will raise it to */
+#define QEMU_MIGRATION_CONVERGENCE_THROTTLE_INCREMENT 10
+#define QEMU_MIGRATION_CONVERGENCE_THROTTLE_INCREMENT_MAX 50
+
+
+/**
+ * qemuMigrationSrcConvergenceInit:
+ * @driver: qemu driver
+ * @vm: domain
+ * @asyncJob: migration job
+ * @flags: qemuMigrationCompletedFlags
+ * @conv: controller state to initialize
+ *
+ * Prepare the convergence controller for an outgoing migration if it is
+ * enabled in qemu.conf. The controller only starts from the migration
+ * parameters currently used by QEMU and never lowers them.
+ *
+ * Returns 0 on success, -1 otherwise.
+ */
+static int
+qemuMigrationSrcConvergenceInit(virQEMUDriver *driver,
+                                virDomainObj *vm,
+                                qemuDomainAsyncJob asyncJob,
+                                unsigned int flags,
+                                qemuMigrationConvergence *conv)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    g_autoptr(qemuMigrationParams) migParams = NULL;
+    unsigned long long now;
+
+    memset(conv, 0, sizeof(*conv));
+
+    if (!cfg->migrationConvergence ||
+        asyncJob != QEMU_ASYNC_JOB_MIGRATION_OUT ||
+        !virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_MIGRATION_PARAM_DOWNTIME))
+        return 0;
+
+    if (qemuMigrationParamsFetch(driver, vm, asyncJob, &migParams) < 0)
+        return -1;
+
+    if (qemuMigrationParamsGetULL(migParams,
+                                  QEMU_MIGRATION_PARAM_DOWNTIME_LIMIT,
+                                  &conv->downtime) != 0) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                       _("QEMU did not report migration downtime limit"));
+        return -1;
+    }
+
+    if (qemuMigrationParamsGetInt(migParams,
+                                  QEMU_MIGRATION_PARAM_THROTTLE_INCREMENT,
+                                  &conv->throttleIncrement) != 0)
+        conv->throttleIncrement = QEMU_MIGRATION_CONVERGENCE_THROTTLE_INCREMENT;
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+
+    conv->enabled = true;
+    conv->postcopy = !!(flags & QEMU_MIGRATION_COMPLETED_POSTCOPY);
+    conv->autoConverge = !!(priv->job.apiFlags & VIR_MIGRATE_AUTO_CONVERGE);
+    conv->maxDowntime = cfg->migrationConvergenceMaxDowntime;
+    conv->next = now + QEMU_MIGRATION_CONVERGENCE_INTERVAL;
+
+    VIR_DEBUG("Convergence controller enabled: downtime=%llu maxDowntime=%llu "
+              "postcopy=%d autoConverge=%d", conv->downtime, conv->maxDowntime,
+              conv->postcopy, conv->autoConverge);
+
+    return 0;
+}
+
+
+static int
+qemuMigrationSrcConvergenceGetDowntime(virQEMUDriver *driver,
+                                       virDomainObj *vm,
+                                       qemuDomainAsyncJob asyncJob,
+                                       unsigned long long *downtime)
+{
+    g_autoptr(qemuMigrationParams) migParams = NULL;
+
+    if (qemuMigrationParamsFetch(driver, vm, asyncJob, &migParams) < 0)
+        return -1;
+
+    if (qemuMigrationParamsGetULL(migParams,
+                                  QEMU_MIGRATION_PARAM_DOWNTIME_LIMIT,
+                                  downtime) != 0) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                       _("QEMU did not report migration downtime limit"));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+qemuMigrationSrcConvergenceSetParam(virQEMUDriver *driver,
+                                    virDomainObj *vm,
+                                    qemuDomainAsyncJob asyncJob,
+                                    qemuMigrationParam param,
+                                    unsigned long long value)
+{
+    g_autoptr(qemuMigrationParams) migParams = qemuMigrationParamsNew();
+    int rc;
+
+    if (!migParams)
+        return -1;
+
+    if (param == QEMU_MIGRATION_PARAM_THROTTLE_INCREMENT)
+        rc = qemuMigrationParamsSetInt(migParams, param, value);
+    else
+        rc = qemuMigrationParamsSetULL(migParams, param, value);
+
+    if (rc < 0)
+        return -1;
+
+    return qemuMigrationParamsUpdate(driver, vm, asyncJob, migParams);
+}
+
+
+/**
+ * qemuMigrationSrcConvergenceDecide:
+ * @conv: controller state
+ * @stats: statistics of the running migration, @ram_bps must not be 0
+ * @pageSize: size of a guest RAM page in bytes
+ * @value: filled in with the new value of the parameter to change
+ *
+ * Update @conv with the progress made by the migration since the last
+ * call and decide whether and how the migration should be tuned. At most
+ * one adjustment is made per RAM iteration. The downtime limit is raised
+ * first, as long as the expected downtime fits into the configured
+ * maximum, then the migration is switched to post-copy if that is
+ * allowed, and finally guest CPUs are throttled harder.
+ *
+ * Returns the action to take, with the new downtime limit (ms) or CPU
+ * throttle increment in @value.
+ */
+qemuMigrationConvergenceAction
+qemuMigrationSrcConvergenceDecide(qemuMigrationConvergence *conv,
+                                  qemuMonitorMigrationStats *stats,
+                                  unsigned long long pageSize,
+                                  unsigned long long *value)
+{
+    unsigned long long dirty = stats->ram_dirty_rate * pageSize;
+    unsigned long long expected = stats->ram_remaining * 1000 / stats->ram_bps;
+    bool stalled;
+
+    /* a new RAM iteration started, check how much it helped */
+    if (stats->ram_iteration != conv->iteration) {
+        if (conv->iteration > 0 &&
+            stats->ram_remaining * QEMU_MIGRATION_CONVERGENCE_PROGRESS >
+            conv->remaining * (QEMU_MIGRATION_CONVERGENCE_PROGRESS - 1))
+            conv->stalls++;
+        else
+            conv->stalls = 0;
+
+        conv->iteration = stats->ram_iteration;
+        conv->remaining = stats->ram_remaining;
+    }
+
+    /* the guest dirties memory faster than we can send it */
+    stalled = conv->stalls >= QEMU_MIGRATION_CONVERGENCE_STALLS ||
+              (stats->ram_iteration > 1 && dirty >= stats->ram_bps);
+
+    VIR_DEBUG("Migration convergence: iteration=%llu remaining=%llu "
+              "bps=%llu dirty=%llu expected=%llums stalls=%u",
+              stats->ram_iteration, stats->ram_remaining, stats->ram_bps,
+              dirty, expected, conv->stalls);
+
+    if (!stalled || expected <= conv->downtime ||
+        conv->acted == stats->ram_iteration)
+        return QEMU_MIGRATION_CONVERGENCE_NONE;
+
+    conv->acted = stats->ram_iteration;
+
+    if (expected <= conv->maxDowntime) {
+        *value = MIN(expected + expected / 10, conv->maxDowntime);
+        return QEMU_MIGRATION_CONVERGENCE_DOWNTIME;
+    }
+
+    if (conv->postcopy &&
+        conv->stalls >= QEMU_MIGRATION_CONVERGENCE_POSTCOPY_STALLS)
+        return QEMU_MIGRATION_CONVERGENCE_POSTCOPY;
+
+    if (conv->autoConverge &&
+        conv->throttleIncrement < QEMU_MIGRATION_CONVERGENCE_THROTTLE_INCREMENT_MAX) {
+        *value = MIN(conv->throttleIncrement * 2,
+                     QEMU_MIGRATION_CONVERGENCE_THROTTLE_INCREMENT_MAX);
+        return QEMU_MIGRATION_CONVERGENCE_THROTTLE;
+    }
+
+    return QEMU_MIGRATION_CONVERGENCE_NONE;
+}
+
+
+static int
+qemuMigrationSrcConvergenceAdjust(virQEMUDriver *driver,
+                                  virDomainObj *vm,
+                                  qemuDomainAsyncJob asyncJob,
+                                  qemuMigrationConvergence *conv,
+                                  qemuMonitorMigrationStats *stats)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+    unsigned long long pageSize = stats->ram_page_size;
+    unsigned long long value = 0;
+    int rc;
+
+    if (pageSize == 0)
+        pageSize = virGetSystemPageSize();
+
+    switch (qemuMigrationSrcConvergenceDecide(conv, stats, pageSize, &value)) {
+    case QEMU_MIGRATION_CONVERGENCE_DOWNTIME:
+        /* the limit may have been changed by virDomainMigrateSetMaxDowntime */
+        if (qemuMigrationSrcConvergenceGetDowntime(driver, vm, asyncJob,
+                                                   &conv->downtime) < 0)
+            return -1;
+
+        if (conv->downtime >= value)
+            return 0;
+
+        VIR_INFO("Raising downtime limit of domain %s migration from %llums "
+                 "to %llums", vm->def->name, conv->downtime, value);
+
+        if (qemuMigrationSrcConvergenceSetParam(driver, vm, asyncJob,
+                                                QEMU_MIGRATION_PARAM_DOWNTIME_LIMIT,
+                                                value) < 0)
+            return -1;
+
+        conv->downtime = value;
+        break;
+
+    case QEMU_MIGRATION_CONVERGENCE_POSTCOPY:
+        VIR_INFO("Switching domain %s migration to post-copy", vm->def->name);
+
+        if (qemuDomainObjEnterMonitorAsync(driver, vm, asyncJob) < 0)
+            return -1;
+
+        rc = qemuMonitorMigrateStartPostCopy(priv->mon);
+
+        if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0)
+            return -1;
+
+        /* nothing else to tune once post-copy starts */
+        conv->enabled = false;
+        break;
+
+    case QEMU_MIGRATION_CONVERGENCE_THROTTLE:
+        VIR_INFO("Raising CPU throttle increment of domain %s migration "
+                 "from %d to %llu", vm->def->name, conv->throttleIncrement,
+                 value);
+
+        if (qemuMigrationSrcConvergenceSetParam(driver, vm, asyncJob,
+                                                QEMU_MIGRATION_PARAM_THROTTLE_INCREMENT,
+                                                value) < 0)
+            return -1;
+
+        conv->throttleIncrement = value;
+        break;
+
+    case QEMU_MIGRATION_CONVERGENCE_NONE:
+        break;
+    }
+
+    return 0;
+}
+
+
 /**
- * Returns 1 if migration completed successfully,
- *         0 if the domain is still being migrated,
- *         -1 migration failed,
- *         -2 something else failed, we need to cancel migration.
+ * qemuMigrationSrcConvergenceUpdate:
+ * @driver: qemu driver
+ * @vm: domain
+ * @asyncJob: migration job
+ * @conv: controller state
+ *
+ * Check progress of a running pre-copy migration and tune it when it does
+ * not converge. Failing to change a migration parameter is not fatal, the
+ * controller just stops touching the migration.
+ *
+ * Returns 0 on success, -1 when the domain died.
  */
 static int
-qemuMigrationAnyCompleted(virQEMUDriver *driver,
-                          virDomainObj *vm,
-                          qemuDomainAsyncJob asyncJob,
-                          virConnectPtr dconn,
-                          unsigned int flags)
+qemuMigrationSrcConvergenceUpdate(virQEMUDriver *driver,
+                                  virDomainObj *vm,
+                                  qemuDomainAsyncJob asyncJob,
+                                  qemuMigrationConvergence *conv)
 {
     qemuDomainObjPrivate *priv = vm->privateData;
     qemuDomainJobInfo *jobInfo = priv->job.current;
-    int pauseReason;
-
-    if (qemuMigrationJobCheckStatus(driver, vm, asyncJob) < 0)
-        goto error;
-
-    /* This flag should only be set when run on src host */
-    if (flags & QEMU_MIGRATION_COMPLETED_CHECK_STORAGE &&
-        qemuMigrationSrcNBDStorageCopyReady(vm, asyncJob) < 0)
-        goto error;
-
-    if (flags & QEMU_MIGRATION_COMPLETED_ABORT_ON_ERROR &&
-        virDomainObjGetState(vm, &pauseReason) == VIR_DOMAIN_PAUSED &&
-        pauseReason == VIR_DOMAIN_PAUSED_IOERROR) {
-        virReportError(VIR_ERR_OPERATION_FAILED, _("%s: %s"),
-                       qemuMigrationJobName(vm), _("failed due to I/O error"));
-        goto error;
-    }
-
-    if (dconn && virConnectIsAlive(dconn) <= 0) {
-        virReportError(VIR_ERR_OPERATION_FAILED, "%s",
-                       _("Lost connection to destination host"));
-        goto error;
-    }
+    unsigned long long now;
 
-    /* Migration was paused before serializing device state, let's return to
-     * the caller so that it can finish all block jobs, resume migration, and
-     * wait again for the real end of the migration.
-     */
-    if (flags & QEMU_MIGRATION_COMPLETED_PRE_SWITCHOVER &&
-        jobInfo->status == QEMU_DOMAIN_JOB_STATUS_PAUSED) {
-        VIR_DEBUG("Migration paused before switchover");
-        return 1;
-    }
+    if (!conv->enabled ||
+        jobInfo->status != QEMU_DOMAIN_JOB_STATUS_MIGRATING)
+        return 0;
 
-    /* In case of postcopy the source considers migration completed at the
-     * moment it switched from active to postcopy-active state. The destination
-     * will continue waiting until the migrate state changes to completed.
-     */
-    if (flags & QEMU_MIGRATION_COMPLETED_POSTCOPY &&
-        jobInfo->status == QEMU_DOMAIN_JOB_STATUS_POSTCOPY) {
-        VIR_DEBUG("Migration switched to post-copy");
-        return 1;
-    }
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
 
-    if (jobInfo->status == QEMU_DOMAIN_JOB_STATUS_QEMU_COMPLETED)
-        return 1;
-    else
+    if (now < conv->next)
         return 0;
 
- error:
-    switch (jobInfo->status) {
-    case QEMU_DOMAIN_JOB_STATUS_MIGRATING:
-    case QEMU_DOMAIN_JOB_STATUS_POSTCOPY:
-    case QEMU_DOMAIN_JOB_STATUS_PAUSED:
-        /* The migration was aborted by us rather than QEMU itself. */
-        jobInfo->status = QEMU_DOMAIN_JOB_STATUS_FAILED;
-        return -2;
-
-    case QEMU_DOMAIN_JOB_STATUS_QEMU_COMPLETED:
-        /* Something failed after QEMU already finished the migration. */
-        jobInfo->status = QEMU_DOMAIN_JOB_STATUS_FAILED;
-        return -1;
+    conv->next = now + QEMU_MIGRATION_CONVERGENCE_INTERVAL;
 
-    case QEMU_DOMAIN_JOB_STATUS_FAILED:
-    case QEMU_DOMAIN_JOB_STATUS_CANCELED:
-        /* QEMU aborted the migration. */
-        return -1;
+    if (qemuMigrationAnyFetchStats(driver, vm, asyncJob, jobInfo, NULL) < 0 ||
+        (jobInfo->stats.mig.status == QEMU_MONITOR_MIGRATION_STATUS_ACTIVE &&
+         jobInfo->stats.mig.ram_bps > 0 &&
+         qemuMigrationSrcConvergenceAdjust(driver, vm, asyncJob, conv,
+                                           &jobInfo->stats.mig) < 0)) {
+        if (!virDomainObjIsActive(vm))
+            return -1;
 
-    case QEMU_DOMAIN_JOB_STATUS_ACTIVE:
-    case QEMU_DOMAIN_JOB_STATUS_COMPLETED:
-    case QEMU_DOMAIN_JOB_STATUS_NONE:
-        /* Impossible. */
-        break;
+        VIR_WARN("Disabling convergence controller for domain %s: %s",
+                 vm->def->name, virGetLastErrorMessage());
+        virResetLastError();
+        conv->enabled = false;
     }
 
-    return -1;
+    return 0;
 }
 
 
@@ -1878,17 +2701,35 @@ qemuMigrationSrcWaitForCompletion(virQEMUDriver *driver,
     qemuDomainObjPrivate *priv = vm->privateData;
     qemuDomainJobInfo *jobInfo = priv->job.current;
     bool events = virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_MIGRATION_EVENT);
+    qemuMigrationConvergence conv;
     int rv;
 
     jobInfo->status = QEMU_DOMAIN_JOB_STATUS_MIGRATING;
 
+    if (qemuMigrationSrcConvergenceInit(driver, vm, asyncJob, flags, &conv) < 0) {
+        if (!virDomainObjIsActive(vm))
+            return -2;
+
+        VIR_WARN("Cannot start convergence controller for domain %s: %s",
+                 vm->def->name, virGetLastErrorMessage());
+        virResetLastError();
+    }
+
     while ((rv = qemuMigrationAnyCompleted(driver, vm, asyncJob,
                                            dconn, flags)) != 1) {
         if (rv < 0)
             return rv;
 
+        if (qemuMigrationSrcConvergenceUpdate(driver, vm, asyncJob, &conv) < 0)
+            return -2;
+
         if (events) {
-            if (virDomainObjWait(vm) < 0) {
+            if (conv.enabled)
+                rv = virDomainObjWaitUntil(vm, conv.next);
+            else
+                rv = virDomainObjWait(vm);
+
+            if (rv < 0) {
                 if (virDomainObjIsActive(vm))
                     jobInfo->status = QEMU_DOMAIN_JOB_STATUS_FAILED;
                 return -2;
@@ -2728,6 +3569,26 @@ qemuMigrationDstPrepareAnyBlockDirtyBitmaps(virDomainObj *vm,
 }
 
 
+/* Data read from QEMU is handed to the sender thread in buffers of this
+ * size, each of which is sent as several stream packets no bigger than
+ * VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX. While one buffer is being sent,
+ * QEMU's output is read into the others. */
+#define TUNNEL_SEND_BUF_SIZE (1024 * 1024)
+#define TUNNEL_SEND_BUF_COUNT 8
+
+
+/* A bigger pipe means fewer wakeups of the tunnel for the same amount
+ * of data. Failing to resize it is not fatal. */
+static void
+qemuMigrationTunnelPipeResize(int fd G_GNUC_UNUSED)
+{
+#ifdef F_SETPIPE_SZ
+    if (fcntl(fd, F_SETPIPE_SZ, TUNNEL_SEND_BUF_SIZE) < 0)
+        VIR_DEBUG("Unable to resize migration pipe: %s", g_strerror(errno));
+#endif
+}
+
+
 static int
 qemuMigrationDstPrepareAny(virQEMUDriver *driver,
                            virConnectPtr dconn,
@@ -2922,9 +3783,12 @@ qemuMigrationDstPrepareAny(virQEMUDriver *driver,
     if (flags & VIR_MIGRATE_OFFLINE)
         goto done;
 
-    if (tunnel &&
-        virPipe(dataFD) < 0)
-        goto stopjob;
+    if (tunnel) {
+        if (virPipe(dataFD) < 0)
+            goto stopjob;
+
+        qemuMigrationTunnelPipeResize(dataFD[1]);
+    }
 
     startFlags = VIR_QEMU_PROCESS_START_AUTODESTROY;
 
@@ -3556,8 +4420,6 @@ struct _qemuMigrationSpec {
     } fwd;
 };
 
-#define TUNNEL_SEND_BUF_SIZE 65536
-
 typedef struct _qemuMigrationIOThread qemuMigrationIOThread;
 struct _qemuMigrationIOThread {
     virThread thread;
@@ -3566,21 +4428,150 @@ struct _qemuMigrationIOThread {
     virError err;
     int wakeupRecvFD;
     int wakeupSendFD;
+
+    /* Buffers filled by @thread and sent to @st by @sendThread */
+    virThread sendThread;
+    virMutex lock;
+    virCond cond;
+    char *buffers[TUNNEL_SEND_BUF_COUNT];
+    size_t lengths[TUNNEL_SEND_BUF_COUNT];
+    size_t head; /* the first filled buffer */
+    size_t count; /* the number of filled buffers */
+    bool eof; /* finish the stream once all buffers are sent */
+    bool abort; /* abort the stream */
+    bool sendFailed; /* sending failed, the error is in @err */
 };
 
+
+static void
+qemuMigrationSrcIOSendFunc(void *arg)
+{
+    qemuMigrationIOThread *data = arg;
+
+    VIR_DEBUG("Running migration tunnel sender; stream=%p", data->st);
+
+    virMutexLock(&data->lock);
+
+    for (;;) {
+        char *buffer;
+        size_t len;
+        size_t off;
+
+        while (data->count == 0 && !data->eof && !data->abort)
+            virCondWait(&data->cond, &data->lock);
+
+        if (data->abort) {
+            virMutexUnlock(&data->lock);
+            virStreamAbort(data->st);
+            virResetLastError();
+            return;
+        }
+
+        if (data->count == 0)
+            break;
+
+        buffer = data->buffers[data->head];
+        len = data->lengths[data->head];
+        virMutexUnlock(&data->lock);
+
+        /* The reader doesn't touch filled buffers, no need to copy.
+         * Older daemons on the destination reject stream packets bigger
+         * than the legacy payload size, send the buffer in such pieces. */
+        for (off = 0; off < len;) {
+            int rc = virStreamSend(data->st, buffer + off,
+                                   MIN(len - off,
+                                       VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX));
+
+            if (rc < 0)
+                goto error;
+            off += rc;
+        }
+
+        virMutexLock(&data->lock);
+        data->head = (data->head + 1) % TUNNEL_SEND_BUF_COUNT;
+        data->count--;
+        virCondSignal(&data->cond);
+    }
+
+    virMutexUnlock(&data->lock);
+
+    if (virStreamFinish(data->st) < 0)
+        goto error;
+
+    return;
+
+ error:
+    virMutexLock(&data->lock);
+    /* Don't copy the error for EPIPE as destination has the actual error. */
+    if (!virLastErrorIsSystemErrno(EPIPE))
+        virCopyLastError(&data->err);
+    data->sendFailed = true;
+    virCondSignal(&data->cond);
+    virMutexUnlock(&data->lock);
+    virResetLastError();
+}
+
+
+/* Returns the buffer to read data into, waiting for the sender to free
+ * one if needed, or NULL if sending failed. */
+static char *
+qemuMigrationSrcIOGetBuffer(qemuMigrationIOThread *data)
+{
+    char *buffer = NULL;
+
+    virMutexLock(&data->lock);
+
+    while (data->count == TUNNEL_SEND_BUF_COUNT && !data->sendFailed)
+        virCondWait(&data->cond, &data->lock);
+
+    if (!data->sendFailed)
+        buffer = data->buffers[(data->head + data->count) % TUNNEL_SEND_BUF_COUNT];
+
+    virMutexUnlock(&data->lock);
+    return buffer;
+}
+
+
+static void
+qemuMigrationSrcIOPutBuffer(qemuMigrationIOThread *data,
+                            size_t len)
+{
+    virMutexLock(&data->lock);
+    data->lengths[(data->head + data->count) % TUNNEL_SEND_BUF_COUNT] = len;
+    data->count++;
+    virCondSignal(&data->cond);
+    virMutexUnlock(&data->lock);
+}
+
+
+/* Tells the sender thread to finish or abort the stream and waits for it. */
+static void
+qemuMigrationSrcIOStopSend(qemuMigrationIOThread *data,
+                           bool abort)
+{
+    virMutexLock(&data->lock);
+    if (abort)
+        data->abort = true;
+    else
+        data->eof = true;
+    virCondSignal(&data->cond);
+    virMutexUnlock(&data->lock);
+
+    virThreadJoin(&data->sendThread);
+}
+
+
 static void qemuMigrationSrcIOFunc(void *arg)
 {
     qemuMigrationIOThread *data = arg;
     char *buffer = NULL;
+    size_t buflen = 0;
     struct pollfd fds[2];
     int timeout = -1;
-    virErrorPtr err = NULL;
 
     VIR_DEBUG("Running migration tunnel; stream=%p, sock=%d",
               data->st, data->sock);
 
-    buffer = g_new0(char, TUNNEL_SEND_BUF_SIZE);
-
     fds[0].fd = data->sock;
     fds[1].fd = data->wakeupRecvFD;
 
@@ -3590,7 +4581,9 @@ static void qemuMigrationSrcIOFunc(void *arg)
         fds[0].events = fds[1].events = POLLIN;
         fds[0].revents = fds[1].revents = 0;
 
-        ret = poll(fds, G_N_ELEMENTS(fds), timeout);
+        /* Don't hold a partially filled buffer back if there's
+         * nothing more to read right now */
+        ret = poll(fds, G_N_ELEMENTS(fds), buflen > 0 ? 0 : timeout);
 
         if (ret < 0) {
             if (errno == EAGAIN || errno == EINTR)
@@ -3601,6 +4594,13 @@ static void qemuMigrationSrcIOFunc(void *arg)
         }
 
         if (ret == 0) {
+            if (buflen > 0) {
+                qemuMigrationSrcIOPutBuffer(data, buflen);
+                buffer = NULL;
+                buflen = 0;
+                continue;
+            }
+
             /* We were asked to gracefully stop but reading would block. This
              * can only happen if qemu told us migration finished but didn't
              * close the migration fd. We handle this in the same way as EOF.
@@ -3628,13 +4628,24 @@ static void qemuMigrationSrcIOFunc(void *arg)
         }
 
         if (fds[0].revents & (POLLIN | POLLERR | POLLHUP)) {
-            int nbytes;
+            ssize_t nbytes;
+
+            if (!buffer &&
+                !(buffer = qemuMigrationSrcIOGetBuffer(data)))
+                goto error;
 
-            nbytes = saferead(data->sock, buffer, TUNNEL_SEND_BUF_SIZE);
+            nbytes = read(data->sock, buffer + buflen,
+                          TUNNEL_SEND_BUF_SIZE - buflen);
             if (nbytes > 0) {
-                if (virStreamSend(data->st, buffer, nbytes) < 0)
-                    goto error;
+                buflen += nbytes;
+                if (buflen == TUNNEL_SEND_BUF_SIZE) {
+                    qemuMigrationSrcIOPutBuffer(data, buflen);
+                    buffer = NULL;
+                    buflen = 0;
+                }
             } else if (nbytes < 0) {
+                if (errno == EAGAIN || errno == EINTR)
+                    continue;
                 virReportSystemError(errno, "%s",
                         _("tunnelled migration failed to read from qemu"));
                 goto abrt;
@@ -3645,31 +4656,50 @@ static void qemuMigrationSrcIOFunc(void *arg)
         }
     }
 
-    if (virStreamFinish(data->st) < 0)
-        goto error;
+    if (buflen > 0)
+        qemuMigrationSrcIOPutBuffer(data, buflen);
 
-    VIR_FORCE_CLOSE(data->sock);
-    VIR_FREE(buffer);
+    /* The sender stores its error in data->err itself */
+    qemuMigrationSrcIOStopSend(data, false);
 
+    /* Let the source qemu know if the transfer couldn't be finished. */
+    VIR_FORCE_CLOSE(data->sock);
     return;
 
  abrt:
-    virErrorPreserveLast(&err);
-    if (err && err->code == VIR_ERR_OK) {
-        virFreeError(err);
-        err = NULL;
-    }
-    virStreamAbort(data->st);
-    virErrorRestore(&err);
+    qemuMigrationSrcIOStopSend(data, true);
 
- error:
     /* Let the source qemu know that the transfer can't continue anymore.
-     * Don't copy the error for EPIPE as destination has the actual error. */
+     * Don't copy the error for EPIPE as destination has the actual error.
+     * An error of the sender, if any, takes precedence. */
     VIR_FORCE_CLOSE(data->sock);
-    if (!virLastErrorIsSystemErrno(EPIPE))
+    if (data->err.code == VIR_ERR_OK &&
+        !virLastErrorIsSystemErrno(EPIPE))
         virCopyLastError(&data->err);
     virResetLastError();
-    VIR_FREE(buffer);
+    return;
+
+ error:
+    qemuMigrationSrcIOStopSend(data, true);
+    VIR_FORCE_CLOSE(data->sock);
+}
+
+
+static void
+qemuMigrationSrcIOThreadFree(qemuMigrationIOThread *io)
+{
+    size_t i;
+
+    if (!io)
+        return;
+
+    for (i = 0; i < TUNNEL_SEND_BUF_COUNT; i++)
+        g_free(io->buffers[i]);
+    virCondDestroy(&io->cond);
+    virMutexDestroy(&io->lock);
+    VIR_FORCE_CLOSE(io->wakeupSendFD);
+    VIR_FORCE_CLOSE(io->wakeupRecvFD);
+    g_free(io);
 }
 
 
@@ -3679,9 +4709,10 @@ qemuMigrationSrcStartTunnel(virStreamPtr st,
 {
     qemuMigrationIOThread *io = NULL;
     int wakeupFD[2] = { -1, -1 };
+    size_t i;
 
     if (virPipe(wakeupFD) < 0)
-        goto error;
+        return NULL;
 
     io = g_new0(qemuMigrationIOThread, 1);
 
@@ -3690,22 +4721,57 @@ qemuMigrationSrcStartTunnel(virStreamPtr st,
     io->wakeupRecvFD = wakeupFD[0];
     io->wakeupSendFD = wakeupFD[1];
 
+    if (virMutexInit(&io->lock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to initialize mutex"));
+        VIR_FORCE_CLOSE(io->wakeupSendFD);
+        VIR_FORCE_CLOSE(io->wakeupRecvFD);
+        g_free(io);
+        return NULL;
+    }
+
+    if (virCondInit(&io->cond) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to initialize condition variable"));
+        virMutexDestroy(&io->lock);
+        VIR_FORCE_CLOSE(io->wakeupSendFD);
+        VIR_FORCE_CLOSE(io->wakeupRecvFD);
+        g_free(io);
+        return NULL;
+    }
+
+    for (i = 0; i < TUNNEL_SEND_BUF_COUNT; i++)
+        io->buffers[i] = g_new0(char, TUNNEL_SEND_BUF_SIZE);
+
+    if (virThreadCreateFull(&io->sendThread, true,
+                            qemuMigrationSrcIOSendFunc,
+                            "qemu-mig-tunnel-send",
+                            false,
+                            io) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to create migration thread"));
+        goto error;
+    }
+
     if (virThreadCreateFull(&io->thread, true,
                             qemuMigrationSrcIOFunc,
                             "qemu-mig-tunnel",
                             false,
                             io) < 0) {
+        virErrorPtr orig_err;
+
         virReportSystemError(errno, "%s",
                              _("Unable to create migration thread"));
+        virErrorPreserveLast(&orig_err);
+        qemuMigrationSrcIOStopSend(io, true);
+        virErrorRestore(&orig_err);
         goto error;
     }
 
     return io;
 
  error:
-    VIR_FORCE_CLOSE(wakeupFD[0]);
-    VIR_FORCE_CLOSE(wakeupFD[1]);
-    VIR_FREE(io);
+    qemuMigrationSrcIOThreadFree(io);
     return NULL;
 }
 
@@ -3737,9 +4803,7 @@ qemuMigrationSrcStopTunnel(qemuMigrationIOThread *io, bool error)
     rv = 0;
 
  cleanup:
-    VIR_FORCE_CLOSE(io->wakeupSendFD);
-    VIR_FORCE_CLOSE(io->wakeupRecvFD);
-    VIR_FREE(io);
+    qemuMigrationSrcIOThreadFree(io);
     return rv;
 }
 
@@ -4545,6 +5609,8 @@ qemuMigrationSrcPerformTunnel(virQEMUDriver *driver,
         goto cleanup;
     }
 
+    qemuMigrationTunnelPipeResize(spec.dest.fd.local);
+
     ret = qemuMigrationSrcRun(driver, vm, persist_xml, cookiein, cookieinlen,
                               cookieout, cookieoutlen, flags, resource, &spec,
                               dconn, graphicsuri, nmigrate_disks, migrate_disks,
@@ -6230,6 +7296,50 @@ qemuMigrationDstErrorReport(virQEMUDriver *driver,
 }
 
 
+static qemuDomainMirrorDiskStats *
+qemuMigrationSrcLookupMirrorDiskStats(qemuDomainMirrorStats *stats,
+                                      const char *dst)
+{
+    size_t i;
+
+    for (i = 0; i < stats->ndisks; i++) {
+        if (STREQ(stats->disks[i].dst, dst))
+            return stats->disks + i;
+    }
+
+    return NULL;
+}
+
+
+static void
+qemuMigrationSrcUpdateMirrorDiskStats(qemuDomainMirrorDiskStats *stats,
+                                      qemuMonitorBlockJobInfo *data,
+                                      unsigned long long now)
+{
+    stats->started = true;
+    stats->transferred = data->cur;
+    stats->total = data->end;
+    stats->bandwidth = data->bandwidth;
+    if (data->ready_present)
+        stats->ready = data->ready;
+
+    if (now == 0)
+        return;
+
+    /* the copy rate is computed over at least a second to smooth it out */
+    if (stats->sampledTime == 0 || now < stats->sampledTime) {
+        stats->sampledTime = now;
+        stats->sampledBytes = data->cur;
+    } else if (now - stats->sampledTime >= 1000) {
+        if (data->cur >= stats->sampledBytes)
+            stats->rate = (data->cur - stats->sampledBytes) * 1000 /
+                          (now - stats->sampledTime);
+        stats->sampledTime = now;
+        stats->sampledBytes = data->cur;
+    }
+}
+
+
 int
 qemuMigrationSrcFetchMirrorStats(virQEMUDriver *driver,
                                  virDomainObj *vm,
@@ -6241,6 +7351,7 @@ qemuMigrationSrcFetchMirrorStats(virQEMUDriver *driver,
     bool nbd = false;
     GHashTable *blockinfo = NULL;
     qemuDomainMirrorStats *stats = &jobInfo->mirrorStats;
+    unsigned long long now;
 
     for (i = 0; i < vm->def->ndisks; i++) {
         virDomainDiskDef *disk = vm->def->disks[i];
@@ -6261,12 +7372,17 @@ qemuMigrationSrcFetchMirrorStats(virQEMUDriver *driver,
     if (qemuDomainObjExitMonitor(driver, vm) < 0 || !blockinfo)
         return -1;
 
-    memset(stats, 0, sizeof(*stats));
+    if (virTimeMillisNow(&now) < 0)
+        now = 0;
+
+    stats->transferred = 0;
+    stats->total = 0;
 
     for (i = 0; i < vm->def->ndisks; i++) {
         virDomainDiskDef *disk = vm->def->disks[i];
         qemuDomainDiskPrivate *diskPriv = QEMU_DOMAIN_DISK_PRIVATE(disk);
         qemuMonitorBlockJobInfo *data;
+        qemuDomainMirrorDiskStats *diskStats;
 
         if (!diskPriv->migrating ||
             !(data = virHashLookup(blockinfo, disk->info.alias)))
@@ -6274,6 +7390,15 @@ qemuMigrationSrcFetchMirrorStats(virQEMUDriver *driver,
 
         stats->transferred += data->cur;
         stats->total += data->end;
+
+        if ((diskStats = qemuMigrationSrcLookupMirrorDiskStats(stats, disk->dst)))
+            qemuMigrationSrcUpdateMirrorDiskStats(diskStats, data, now);
+    }
+
+    /* disks waiting to be mirrored still need to be copied */
+    for (i = 0; i < stats->ndisks; i++) {
+        if (!stats->disks[i].started)
+            stats->total += stats->disks[i].total;
     }
 
     virHashFree(blockinfo);
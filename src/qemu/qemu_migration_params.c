@@ -880,6 +880,47 @@ qemuMigrationParamsApply(virQEMUDriver *driver,
 }
 
 
+/**
+ * qemuMigrationParamsUpdate:
+ * @driver: qemu driver
+ * @vm: domain object
+ * @asyncJob: migration job
+ * @migParams: migration parameters to change
+ *
+ * Change parameters of a migration which is already running. Capabilities
+ * in @migParams are ignored since QEMU refuses to change them while
+ * migration is in progress.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+qemuMigrationParamsUpdate(virQEMUDriver *driver,
+                          virDomainObj *vm,
+                          int asyncJob,
+                          qemuMigrationParams *migParams)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+    g_autoptr(virJSONValue) params = NULL;
+    int rc;
+
+    if (!(params = qemuMigrationParamsToJSON(migParams)))
+        return -1;
+
+    if (virJSONValueObjectKeysNumber(params) == 0)
+        return 0;
+
+    if (qemuDomainObjEnterMonitorAsync(driver, vm, asyncJob) < 0)
+        return -1;
+
+    rc = qemuMonitorSetMigrationParams(priv->mon, &params);
+
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0)
+        return -1;
+
+    return 0;
+}
+
+
 /**
  * qemuMigrationParamsSetString:
  * @migrParams: migration parameter object
@@ -1104,6 +1145,20 @@ qemuMigrationParamsSetULL(qemuMigrationParams *migParams,
 }
 
 
+int
+qemuMigrationParamsSetInt(qemuMigrationParams *migParams,
+                          qemuMigrationParam param,
+                          int value)
+{
+    if (qemuMigrationParamsCheckType(param, QEMU_MIGRATION_PARAM_TYPE_INT) < 0)
+        return -1;
+
+    migParams->params[param].value.i = value;
+    migParams->params[param].set = true;
+    return 0;
+}
+
+
 /**
  * Returns -1 on error,
  *          0 on success,
@@ -1125,6 +1180,27 @@ qemuMigrationParamsGetULL(qemuMigrationParams *migParams,
 }
 
 
+/**
+ * Returns -1 on error,
+ *          0 on success,
+ *          1 if the parameter is not supported by QEMU.
+ */
+int
+qemuMigrationParamsGetInt(qemuMigrationParams *migParams,
+                          qemuMigrationParam param,
+                          int *value)
+{
+    if (qemuMigrationParamsCheckType(param, QEMU_MIGRATION_PARAM_TYPE_INT) < 0)
+        return -1;
+
+    if (!migParams->params[param].set)
+        return 1;
+
+    *value = migParams->params[param].value.i;
+    return 0;
+}
+
+
 /**
  * qemuMigrationParamsCheck:
  *
@@ -100,6 +100,12 @@ qemuMigrationParamsApply(virQEMUDriver *driver,
                          int asyncJob,
                          qemuMigrationParams *migParams);
 
+int
+qemuMigrationParamsUpdate(virQEMUDriver *driver,
+                          virDomainObj *vm,
+                          int asyncJob,
+                          qemuMigrationParams *migParams);
+
 int
 qemuMigrationParamsEnableTLS(virQEMUDriver *driver,
                              virDomainObj *vm,
@@ -127,11 +133,21 @@ qemuMigrationParamsSetULL(qemuMigrationParams *migParams,
                           qemuMigrationParam param,
                           unsigned long long value);
 
+int
+qemuMigrationParamsSetInt(qemuMigrationParams *migParams,
+                          qemuMigrationParam param,
+                          int value);
+
 int
 qemuMigrationParamsGetULL(qemuMigrationParams *migParams,
                           qemuMigrationParam param,
                           unsigned long long *value);
 
+int
+qemuMigrationParamsGetInt(qemuMigrationParams *migParams,
+                          qemuMigrationParam param,
+                          int *value);
+
 void
 qemuMigrationParamsSetBlockDirtyBitmapMapping(qemuMigrationParams *migParams,
                                               virJSONValue **params);
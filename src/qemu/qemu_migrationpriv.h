@@ -0,0 +1,82 @@
+/*
+ * qemu_migrationpriv.h: private declarations for QEMU migration handling
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBVIRT_QEMU_MIGRATIONPRIV_H_ALLOW
+# error "qemu_migrationpriv.h may only be included by qemu_migration.c or test suites"
+#endif /* LIBVIRT_QEMU_MIGRATIONPRIV_H_ALLOW */
+
+#pragma once
+
+#include "qemu_domainjob.h"
+#include "qemu_monitor.h"
+
+typedef struct _qemuMigrationNBDMirror qemuMigrationNBDMirror;
+struct _qemuMigrationNBDMirror {
+    virDomainDiskDef *disk;
+    unsigned long long capacity;
+    unsigned long long written;     /* guest writes at the last sample */
+    unsigned long long dirtyRate;   /* guest writes in bytes/s */
+    unsigned long long bandwidth;   /* limit applied to the mirror job */
+    bool started;
+};
+
+typedef struct _qemuMigrationNBDScheduler qemuMigrationNBDScheduler;
+struct _qemuMigrationNBDScheduler {
+    qemuMigrationNBDMirror *mirrors;
+    size_t nmirrors;
+    unsigned long long speed;       /* aggregate limit in bytes/s, 0 if unlimited */
+    unsigned int maxSyncing;        /* 0 if unlimited */
+    unsigned long long sampled;     /* when guest writes were sampled */
+};
+
+qemuMigrationNBDMirror *
+qemuMigrationSrcNBDSchedulerNext(qemuMigrationNBDScheduler *sched);
+
+void
+qemuMigrationSrcNBDSchedulerSplit(qemuMigrationNBDScheduler *sched,
+                                  qemuDomainMirrorStats *stats,
+                                  unsigned long long *bandwidth);
+
+typedef struct _qemuMigrationConvergence qemuMigrationConvergence;
+struct _qemuMigrationConvergence {
+    bool enabled;
+    bool postcopy;                  /* switching to post-copy is allowed */
+    bool autoConverge;              /* guest CPUs may be throttled */
+    unsigned long long maxDowntime; /* upper limit for the downtime (ms) */
+    unsigned long long downtime;    /* current downtime limit (ms) */
+    int throttleIncrement;          /* current cpu-throttle-increment */
+    unsigned long long iteration;   /* RAM iteration seen last time */
+    unsigned long long remaining;   /* remaining RAM when @iteration started */
+    unsigned long long acted;       /* RAM iteration of the last adjustment */
+    unsigned int stalls;            /* stalled RAM iterations in a row */
+    unsigned long long next;        /* when to look at the statistics again */
+};
+
+typedef enum {
+    QEMU_MIGRATION_CONVERGENCE_NONE = 0,
+    QEMU_MIGRATION_CONVERGENCE_DOWNTIME,    /* raise the downtime limit */
+    QEMU_MIGRATION_CONVERGENCE_POSTCOPY,    /* switch to post-copy */
+    QEMU_MIGRATION_CONVERGENCE_THROTTLE,    /* raise cpu-throttle-increment */
+} qemuMigrationConvergenceAction;
+
+qemuMigrationConvergenceAction
+qemuMigrationSrcConvergenceDecide(qemuMigrationConvergence *conv,
+                                  qemuMonitorMigrationStats *stats,
+                                  unsigned long long pageSize,
+                                  unsigned long long *value);
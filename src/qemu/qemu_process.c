@@ -6155,8 +6155,84 @@ qemuProcessUpdateGuestCPU(virDomainDef *def,
 }
 
 
+/*
+ * Account vCPUs of @vm to the host NUMA nodes it was automatically
+ * placed onto so that the built-in placement engine can spread
+ * subsequently started domains. Must be called with
+ * driver->numaPlacementLock held.
+ */
+static void
+qemuProcessNUMAPlacementCharge(virQEMUDriver *driver,
+                               virDomainObj *vm)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+    unsigned int nnodes;
+
+    if (!priv->autoNodeset || priv->autoNodesetLoad > 0)
+        return;
+
+    if ((nnodes = virBitmapCountBits(priv->autoNodeset)) == 0)
+        return;
+
+    priv->autoNodesetLoad = VIR_DIV_UP(virDomainDefGetVcpus(vm->def), nnodes);
+
+    virQEMUDriverAddNUMAPlacementLoad(driver, priv->autoNodeset,
+                                      priv->autoNodesetLoad);
+}
+
+
+static void
+qemuProcessNUMAPlacementRelease(virQEMUDriver *driver,
+                                virDomainObj *vm)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+
+    if (!priv->autoNodeset || priv->autoNodesetLoad == 0)
+        return;
+
+    virMutexLock(&driver->numaPlacementLock);
+    virQEMUDriverRemoveNUMAPlacementLoad(driver, priv->autoNodeset,
+                                         priv->autoNodesetLoad);
+    virMutexUnlock(&driver->numaPlacementLock);
+    priv->autoNodesetLoad = 0;
+}
+
+
+/* Must be called with driver->numaPlacementLock held */
+static virBitmap *
+qemuProcessGetBuiltinNUMAPlacement(virQEMUDriver *driver,
+                                   virDomainObj *vm)
+{
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    g_autofree unsigned int *load = NULL;
+    size_t nload = 0;
+    unsigned int pagesize = 0;
+
+    if (vm->def->mem.nhugepages > 0) {
+        pagesize = vm->def->mem.hugepages[0].size;
+
+        if (pagesize == 0 && cfg->nhugetlbfs > 0) {
+            virHugeTLBFS *p;
+
+            if (!(p = virFileGetDefaultHugepage(cfg->hugetlbfs, cfg->nhugetlbfs)))
+                p = &cfg->hugetlbfs[0];
+
+            pagesize = p->size;
+        }
+    }
+
+    load = virQEMUDriverGetNUMAPlacementLoad(driver, &nload);
+
+    return virNumaGetBuiltinPlacementAdvice(virDomainDefGetVcpus(vm->def),
+                                            virDomainDefGetMemoryTotal(vm->def),
+                                            pagesize, load, nload);
+}
+
+
+/* Must be called with driver->numaPlacementLock held */
 static int
-qemuProcessPrepareDomainNUMAPlacement(virDomainObj *vm)
+qemuProcessPrepareDomainNUMAPlacementLocked(virQEMUDriver *driver,
+                                            virDomainObj *vm)
 {
     qemuDomainObjPrivate *priv = vm->privateData;
     g_autofree char *nodeset = NULL;
@@ -6164,24 +6240,30 @@ qemuProcessPrepareDomainNUMAPlacement(virDomainObj *vm)
     g_autoptr(virBitmap) hostMemoryNodeset = NULL;
     g_autoptr(virCapsHostNUMA) caps = NULL;
 
-    /* Get the advisory nodeset from numad if 'placement' of
-     * either <vcpu> or <numatune> is 'auto'.
-     */
-    if (!virDomainDefNeedsPlacementAdvice(vm->def))
-        return 0;
+    if (virNumaHasAutoPlacementAdvisor()) {
+        nodeset = virNumaGetAutoPlacementAdvice(virDomainDefGetVcpus(vm->def),
+                                                virDomainDefGetMemoryTotal(vm->def));
 
-    nodeset = virNumaGetAutoPlacementAdvice(virDomainDefGetVcpus(vm->def),
-                                            virDomainDefGetMemoryTotal(vm->def));
+        if (!nodeset)
+            return -1;
 
-    if (!nodeset)
-        return -1;
+        VIR_DEBUG("Nodeset returned from numad: %s", nodeset);
 
-    if (!(hostMemoryNodeset = virNumaGetHostMemoryNodeset()))
-        return -1;
+        if (virBitmapParse(nodeset, &numadNodeset, VIR_DOMAIN_CPUMASK_LEN) < 0)
+            return -1;
+    } else {
+        VIR_WARN("numad is not available, using built-in NUMA placement "
+                 "for domain %s", vm->def->name);
 
-    VIR_DEBUG("Nodeset returned from numad: %s", nodeset);
+        if (!(numadNodeset = qemuProcessGetBuiltinNUMAPlacement(driver, vm)))
+            return -1;
 
-    if (virBitmapParse(nodeset, &numadNodeset, VIR_DOMAIN_CPUMASK_LEN) < 0)
+        nodeset = virBitmapFormat(numadNodeset);
+        VIR_DEBUG("Nodeset returned from built-in placement: %s",
+                  NULLSTR(nodeset));
+    }
+
+    if (!(hostMemoryNodeset = virNumaGetHostMemoryNodeset()))
         return -1;
 
     if (!(caps = virCapabilitiesHostNUMANewHost()))
@@ -6197,10 +6279,35 @@ qemuProcessPrepareDomainNUMAPlacement(virDomainObj *vm)
 
     priv->autoNodeset = g_steal_pointer(&numadNodeset);
 
+    qemuProcessNUMAPlacementCharge(driver, vm);
+
     return 0;
 }
 
 
+static int
+qemuProcessPrepareDomainNUMAPlacement(virQEMUDriver *driver,
+                                      virDomainObj *vm)
+{
+    int ret;
+
+    /* Get the advisory nodeset from numad if 'placement' of
+     * either <vcpu> or <numatune> is 'auto'. Without numad use
+     * the built-in placement engine.
+     */
+    if (!virDomainDefNeedsPlacementAdvice(vm->def))
+        return 0;
+
+    /* The nodes are picked based on the load accounted to them, so
+     * picking and accounting must not interleave with other domains */
+    virMutexLock(&driver->numaPlacementLock);
+    ret = qemuProcessPrepareDomainNUMAPlacementLocked(driver, vm);
+    virMutexUnlock(&driver->numaPlacementLock);
+
+    return ret;
+}
+
+
 static void
 qemuProcessPrepareDomainDiskBootorder(virDomainDef *def)
 {
@@ -6452,7 +6559,7 @@ qemuProcessPrepareDomain(virQEMUDriver *driver,
         }
         virDomainAuditSecurityLabel(vm, true);
 
-        if (qemuProcessPrepareDomainNUMAPlacement(vm) < 0)
+        if (qemuProcessPrepareDomainNUMAPlacement(driver, vm) < 0)
             return -1;
     }
 
@@ -8077,6 +8184,8 @@ void qemuProcessStop(virQEMUDriver *driver,
 
     qemuSecurityReleaseLabel(driver->securityManager, vm->def);
 
+    qemuProcessNUMAPlacementRelease(driver, vm);
+
     /* clear all private data entries which are no longer needed */
     qemuDomainObjPrivateDataClear(priv);
 
@@ -8441,15 +8550,30 @@ struct qemuProcessReconnectData {
     virQEMUDriver *driver;
     virDomainObj *obj;
     virIdentity *identity;
+    unsigned int cost;
+    qemuDomainJobObj oldjob; /* job restored from the status XML */
+    bool jobStarted;
+    bool reserved; /* host resources of the domain were reserved */
+};
+
+/* Domains waiting for reconnect, processed by a bounded number of
+ * workers in the order of increasing cost */
+typedef struct _qemuProcessReconnectQueue qemuProcessReconnectQueue;
+struct _qemuProcessReconnectQueue {
+    virQEMUDriver *driver;
+    struct qemuProcessReconnectData **items;
+    size_t nitems;
+    int next; /* atomic access only */
+    int done; /* atomic access only */
 };
 /*
  * Open an existing VM's monitor, re-detect VCPU threads
  * and re-reserve the security labels in use
  *
- * This function also inherits a locked and ref'd domain object.
+ * This function also inherits a ref'd domain object, which it locks, and
+ * the job started by qemuProcessReconnectHelper.
  *
  * This function needs to:
- * 1. Enter job
  * 1. just before monitor reconnect do lightweight MonitorEnter
  *    (increase VM refcount and unlock VM)
  * 2. reconnect to monitor
@@ -8475,26 +8599,29 @@ qemuProcessReconnect(void *opaque)
     g_autoptr(virQEMUDriverConfig) cfg = NULL;
     size_t i;
     unsigned int stopFlags = 0;
-    bool jobStarted = false;
+    bool jobStarted = data->jobStarted;
+    bool reserved = data->reserved;
     bool retry = true;
     bool tryMonReconn = false;
 
+    oldjob = data->oldjob;
     virIdentitySetCurrent(data->identity);
     g_clear_object(&data->identity);
     VIR_FREE(data);
 
+    virNWFilterReadLockFilterUpdates();
+    virObjectLock(obj);
+
     cfg = virQEMUDriverGetConfig(driver);
     priv = obj->privateData;
 
-    qemuDomainObjRestoreJob(obj, &oldjob);
     if (oldjob.asyncJob == QEMU_ASYNC_JOB_MIGRATION_IN)
         stopFlags |= VIR_QEMU_PROCESS_STOP_MIGRATED;
     if (oldjob.asyncJob == QEMU_ASYNC_JOB_BACKUP && priv->backup)
         priv->backup->apiFlags = oldjob.apiFlags;
 
-    if (qemuDomainObjBeginJob(driver, obj, QEMU_JOB_MODIFY) < 0)
+    if (!jobStarted || !reserved)
         goto error;
-    jobStarted = true;
 
     /* XXX If we ever gonna change pid file pattern, come up with
      * some intelligence here to deal with old paths. */
@@ -8509,9 +8636,6 @@ qemuProcessReconnect(void *opaque)
      * allowReboot in status XML and we need to initialize it. */
     qemuProcessPrepareAllowReboot(obj);
 
-    if (qemuHostdevUpdateActiveDomainDevices(driver, obj->def) < 0)
-        goto error;
-
     if (virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_CHARDEV_FD_PASS_COMMANDLINE))
         retry = false;
 
@@ -8632,9 +8756,6 @@ qemuProcessReconnect(void *opaque)
     if (qemuProcessDetectIOThreadPIDs(driver, obj, QEMU_ASYNC_JOB_NONE) < 0)
         goto error;
 
-    if (qemuSecurityReserveLabel(driver->securityManager, obj->def, obj->pid) < 0)
-        goto error;
-
     qemuProcessNotifyNets(obj->def);
 
     qemuProcessFiltersInstantiate(obj->def);
@@ -8766,14 +8887,50 @@ qemuProcessReconnect(void *opaque)
     goto cleanup;
 }
 
+/*
+ * Rough estimate of how much work reconnecting to @obj means, mostly
+ * given by the number of devices whose state is refreshed from QEMU.
+ */
+static unsigned int
+qemuProcessReconnectCost(virDomainObj *obj)
+{
+    return 1 +
+        obj->def->ndisks +
+        obj->def->nhostdevs +
+        obj->def->nnets +
+        obj->def->nchannels;
+}
+
+
+/*
+ * Reserve host resources used by the running domain @obj so that domains
+ * started before the reconnect finishes can't claim them.
+ */
+static int
+qemuProcessReconnectReserve(virQEMUDriver *driver,
+                            virDomainObj *obj)
+{
+    if (qemuHostdevUpdateActiveDomainDevices(driver, obj->def) < 0)
+        return -1;
+
+    if (qemuSecurityReserveLabel(driver->securityManager, obj->def, obj->pid) < 0)
+        return -1;
+
+    virMutexLock(&driver->numaPlacementLock);
+    qemuProcessNUMAPlacementCharge(driver, obj);
+    virMutexUnlock(&driver->numaPlacementLock);
+
+    return 0;
+}
+
+
 static int
 qemuProcessReconnectHelper(virDomainObj *obj,
                            void *opaque)
 {
-    virThread thread;
-    struct qemuProcessReconnectData *src = opaque;
+    qemuProcessReconnectQueue *queue = opaque;
+    virQEMUDriver *driver = queue->driver;
     struct qemuProcessReconnectData *data;
-    g_autofree char *name = NULL;
 
     /* If the VM was inactive, we don't need to reconnect */
     if (!obj->pid)
@@ -8781,43 +8938,108 @@ qemuProcessReconnectHelper(virDomainObj *obj,
 
     data = g_new0(struct qemuProcessReconnectData, 1);
 
-    memcpy(data, src, sizeof(*data));
-    data->obj = obj;
+    data->driver = driver;
     data->identity = virIdentityGetCurrent();
 
-    virNWFilterReadLockFilterUpdates();
-
-    /* this lock and reference will be eventually transferred to the thread
-     * that handles the reconnect */
+    /* The reference and the job are eventually transferred to the thread
+     * that handles the reconnect. The job keeps other threads away from
+     * the domain while it waits in the queue, without holding its lock. */
     virObjectLock(obj);
-    virObjectRef(obj);
+    data->obj = virObjectRef(obj);
+    data->cost = qemuProcessReconnectCost(obj);
 
-    name = g_strdup_printf("init-%s", obj->def->name);
+    qemuDomainObjRestoreJob(obj, &data->oldjob);
 
-    if (virThreadCreateFull(&thread, false, qemuProcessReconnect,
-                            name, false, data) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Could not create thread. QEMU initialization "
-                         "might be incomplete"));
-        /* We can't spawn a thread and thus connect to monitor. Kill qemu.
-         * It's safe to call qemuProcessStop without a job here since there
-         * is no thread that could be doing anything else with the same domain
-         * object.
-         */
-        qemuProcessStop(src->driver, obj, VIR_DOMAIN_SHUTOFF_FAILED,
-                        QEMU_ASYNC_JOB_NONE, 0);
-        qemuDomainRemoveInactiveJobLocked(src->driver, obj);
+    if (qemuDomainObjBeginJob(driver, obj, QEMU_JOB_MODIFY) < 0) {
+        VIR_WARN("Unable to start job on domain %s", obj->def->name);
+        virResetLastError();
+    } else {
+        data->jobStarted = true;
 
-        virDomainObjEndAPI(&obj);
-        virNWFilterUnlockFilterUpdates();
-        g_clear_object(&data->identity);
-        VIR_FREE(data);
-        return -1;
+        if (qemuProcessReconnectReserve(driver, obj) < 0) {
+            VIR_WARN("Unable to reserve host resources of domain %s: %s",
+                     obj->def->name, virGetLastErrorMessage());
+            virResetLastError();
+        } else {
+            data->reserved = true;
+        }
     }
+    virObjectUnlock(obj);
+
+    VIR_APPEND_ELEMENT(queue->items, queue->nitems, data);
+
+    return 0;
+}
 
+
+static int
+qemuProcessReconnectSorter(const void *a,
+                           const void *b)
+{
+    const struct qemuProcessReconnectData *da = *(struct qemuProcessReconnectData **)a;
+    const struct qemuProcessReconnectData *db = *(struct qemuProcessReconnectData **)b;
+
+    if (da->cost < db->cost)
+        return -1;
+    if (da->cost > db->cost)
+        return 1;
     return 0;
 }
 
+
+static void
+qemuProcessReconnectWorker(void *opaque)
+{
+    qemuProcessReconnectQueue *queue = opaque;
+    size_t i;
+
+    while ((i = g_atomic_int_add(&queue->next, 1)) < queue->nitems) {
+        qemuProcessReconnect(g_steal_pointer(&queue->items[i]));
+
+        VIR_INFO("Reconnected to %d of %zu domains",
+                 g_atomic_int_add(&queue->done, 1) + 1, queue->nitems);
+    }
+}
+
+
+static void
+qemuProcessReconnectQueueRun(void *opaque)
+{
+    g_autofree qemuProcessReconnectQueue *queue = opaque;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(queue->driver);
+    g_autofree virThread *workers = NULL;
+    size_t nworkers = cfg->maxReconnectWorkers;
+    size_t i;
+
+    if (nworkers == 0)
+        nworkers = g_get_num_processors();
+    nworkers = MIN(nworkers, queue->nitems);
+
+    VIR_DEBUG("Reconnecting to %zu domains using %zu workers",
+              queue->nitems, nworkers);
+
+    workers = g_new0(virThread, nworkers);
+
+    for (i = 0; i < nworkers; i++) {
+        if (virThreadCreateFull(&workers[i], true, qemuProcessReconnectWorker,
+                                "qemu-reconnect", false, queue) < 0) {
+            VIR_WARN("Failed to create reconnect worker thread");
+            break;
+        }
+    }
+    nworkers = i;
+
+    /* If no worker could be created, do the work ourselves */
+    if (nworkers == 0)
+        qemuProcessReconnectWorker(queue);
+
+    for (i = 0; i < nworkers; i++)
+        virThreadJoin(&workers[i]);
+
+    g_free(queue->items);
+}
+
+
 /**
  * qemuProcessReconnectAll
  *
@@ -8827,9 +9049,49 @@ qemuProcessReconnectHelper(virDomainObj *obj,
 void
 qemuProcessReconnectAll(virQEMUDriver *driver)
 {
-    struct qemuProcessReconnectData data = {.driver = driver};
+    qemuProcessReconnectQueue *queue = g_new0(qemuProcessReconnectQueue, 1);
+
+    queue->driver = driver;
+
     virDomainObjListForEach(driver->domains, true,
-                            qemuProcessReconnectHelper, &data);
+                            qemuProcessReconnectHelper, queue);
+
+    if (queue->nitems == 0) {
+        g_free(queue);
+        return;
+    }
+
+    /* Domains with fewer devices are reconnected first so that most
+     * of them become usable as soon as possible */
+    qsort(queue->items, queue->nitems, sizeof(*queue->items),
+          qemuProcessReconnectSorter);
+
+    if (virThreadCreateFull(&driver->reconnectThread, true,
+                            qemuProcessReconnectQueueRun,
+                            "qemu-reconnect-all", false, queue) < 0) {
+        VIR_WARN("Failed to create reconnect thread, reconnecting synchronously");
+        qemuProcessReconnectQueueRun(queue);
+        return;
+    }
+
+    driver->reconnectThreadActive = true;
+}
+
+
+/**
+ * qemuProcessReconnectAllWait:
+ *
+ * Wait until reconnecting to all domains started by qemuProcessReconnectAll
+ * finishes.
+ */
+void
+qemuProcessReconnectAllWait(virQEMUDriver *driver)
+{
+    if (!driver->reconnectThreadActive)
+        return;
+
+    virThreadJoin(&driver->reconnectThread);
+    driver->reconnectThreadActive = false;
 }
 
 
@@ -48,6 +48,7 @@ int qemuProcessDestroyMemoryBackingPath(virQEMUDriver *driver,
                                         virDomainMemoryDef *mem);
 
 void qemuProcessReconnectAll(virQEMUDriver *driver);
+void qemuProcessReconnectAllWait(virQEMUDriver *driver);
 
 typedef struct _qemuProcessIncomingDef qemuProcessIncomingDef;
 struct _qemuProcessIncomingDef {
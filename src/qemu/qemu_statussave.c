@@ -0,0 +1,245 @@
+/*
+ * qemu_statussave.c: coalesced saving of domain status XML
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "qemu_statussave.h"
+#include "viralloc.h"
+#include "virlog.h"
+#include "virthread.h"
+#include "virtime.h"
+
+#define VIR_FROM_THIS VIR_FROM_QEMU
+
+VIR_LOG_INIT("qemu.qemu_statussave");
+
+/* Status changes requested within this interval (in ms) after the
+ * first one are written out together */
+#define QEMU_STATUS_SAVER_DELAY 100
+
+/*
+ * Saving the status XML of a domain means formatting the whole
+ * definition and rewriting the file including fsync(). Events like
+ * block job progress can change the status of many domains many times
+ * per second, so instead of writing the status on every change the
+ * domains are only marked as dirty and a background thread writes the
+ * latest status of each of them once the delay expires.
+ *
+ * Lock ordering: the domain object lock is acquired before @lock. The
+ * background thread never holds @lock while locking a domain object.
+ */
+struct _qemuStatusSaver {
+    virMutex lock;
+    virCond cond;     /* signalled when work is scheduled or on quit/flush */
+    virCond flushed;  /* signalled when a batch of domains is written */
+
+    qemuStatusSaverFunc func;
+
+    /* Domains whose status should be written, keyed by UUID, holding a
+     * reference of each object */
+    GHashTable *pending;
+    bool busy;
+    unsigned int flushing;
+    bool quit;
+
+    virThread thread;
+};
+
+
+static GHashTable *
+qemuStatusSaverNewTable(void)
+{
+    return g_hash_table_new_full(g_str_hash, g_str_equal,
+                                 g_free, virObjectUnref);
+}
+
+
+static void
+qemuStatusSaverWrite(qemuStatusSaver *saver,
+                     GHashTable *batch)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, batch);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        virDomainObj *vm = value;
+
+        virObjectLock(vm);
+        if (virDomainObjIsActive(vm))
+            saver->func(vm);
+        virObjectUnlock(vm);
+    }
+}
+
+
+static void
+qemuStatusSaverWorker(void *opaque)
+{
+    qemuStatusSaver *saver = opaque;
+
+    virMutexLock(&saver->lock);
+
+    while (true) {
+        g_autoptr(GHashTable) batch = NULL;
+        unsigned long long deadline;
+
+        while (!saver->quit && g_hash_table_size(saver->pending) == 0)
+            ignore_value(virCondWait(&saver->cond, &saver->lock));
+
+        if (g_hash_table_size(saver->pending) == 0)
+            break;
+
+        /* Give more changes a chance to coalesce unless somebody is
+         * waiting for the status to be written */
+        if (virTimeMillisNow(&deadline) == 0) {
+            deadline += QEMU_STATUS_SAVER_DELAY;
+
+            while (!saver->quit && saver->flushing == 0) {
+                if (virCondWaitUntil(&saver->cond, &saver->lock, deadline) < 0)
+                    break;
+            }
+        }
+
+        batch = g_steal_pointer(&saver->pending);
+        saver->pending = qemuStatusSaverNewTable();
+        saver->busy = true;
+        virMutexUnlock(&saver->lock);
+
+        VIR_DEBUG("Saving status of %u domains", g_hash_table_size(batch));
+        qemuStatusSaverWrite(saver, batch);
+        g_clear_pointer(&batch, g_hash_table_unref);
+
+        virMutexLock(&saver->lock);
+        saver->busy = false;
+        virCondBroadcast(&saver->flushed);
+    }
+
+    virMutexUnlock(&saver->lock);
+}
+
+
+qemuStatusSaver *
+qemuStatusSaverNew(qemuStatusSaverFunc func)
+{
+    g_autofree qemuStatusSaver *saver = g_new0(qemuStatusSaver, 1);
+
+    if (virMutexInit(&saver->lock) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to init mutex"));
+        return NULL;
+    }
+
+    if (virCondInit(&saver->cond) < 0 ||
+        virCondInit(&saver->flushed) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to init condition"));
+        virMutexDestroy(&saver->lock);
+        return NULL;
+    }
+
+    saver->func = func;
+    saver->pending = qemuStatusSaverNewTable();
+
+    if (virThreadCreateFull(&saver->thread, true, qemuStatusSaverWorker,
+                            "qemu-status", false, saver) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to create status saving thread"));
+        g_hash_table_unref(saver->pending);
+        virCondDestroy(&saver->flushed);
+        virCondDestroy(&saver->cond);
+        virMutexDestroy(&saver->lock);
+        return NULL;
+    }
+
+    return g_steal_pointer(&saver);
+}
+
+
+/**
+ * qemuStatusSaverFree:
+ * @saver: status saver
+ *
+ * Write the status of all pending domains and stop the background
+ * thread.
+ */
+void
+qemuStatusSaverFree(qemuStatusSaver *saver)
+{
+    if (!saver)
+        return;
+
+    virMutexLock(&saver->lock);
+    saver->quit = true;
+    virCondSignal(&saver->cond);
+    virMutexUnlock(&saver->lock);
+
+    virThreadJoin(&saver->thread);
+
+    g_hash_table_unref(saver->pending);
+    virCondDestroy(&saver->flushed);
+    virCondDestroy(&saver->cond);
+    virMutexDestroy(&saver->lock);
+    g_free(saver);
+}
+
+
+/**
+ * qemuStatusSaverSchedule:
+ * @saver: status saver
+ * @vm: locked domain object
+ *
+ * Mark the status of @vm to be written out by the background thread.
+ * Repeated requests before the status is written are merged.
+ */
+void
+qemuStatusSaverSchedule(qemuStatusSaver *saver,
+                        virDomainObj *vm)
+{
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+    virUUIDFormat(vm->def->uuid, uuidstr);
+
+    virMutexLock(&saver->lock);
+    if (!g_hash_table_contains(saver->pending, uuidstr)) {
+        g_hash_table_insert(saver->pending, g_strdup(uuidstr),
+                            virObjectRef(vm));
+        virCondSignal(&saver->cond);
+    }
+    virMutexUnlock(&saver->lock);
+}
+
+
+/**
+ * qemuStatusSaverFlush:
+ * @saver: status saver
+ *
+ * Wait until the status of all domains scheduled so far is written.
+ * Must not be called with any domain object locked.
+ */
+void
+qemuStatusSaverFlush(qemuStatusSaver *saver)
+{
+    virMutexLock(&saver->lock);
+    saver->flushing++;
+    virCondSignal(&saver->cond);
+
+    while (g_hash_table_size(saver->pending) > 0 || saver->busy)
+        ignore_value(virCondWait(&saver->flushed, &saver->lock));
+
+    saver->flushing--;
+    virMutexUnlock(&saver->lock);
+}
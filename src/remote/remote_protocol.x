@@ -230,8 +230,10 @@ const REMOTE_NODE_MEMORY_PARAMETERS_MAX = 64;
 /* Upper limit on migrate parameters */
 const REMOTE_DOMAIN_MIGRATE_PARAM_LIST_MAX = 64;
 
-/* Upper limit on number of job stats */
-const REMOTE_DOMAIN_JOB_STATS_MAX = 64;
+/* Upper limit on number of job stats. Replies are kept within 64 items,
+ * the limit of older clients, unless VIR_DOMAIN_JOB_STATS_DISK_MIRRORS
+ * was passed, which those clients cannot do. */
+const REMOTE_DOMAIN_JOB_STATS_MAX = 512;
 
 /* Upper limit on number of CPU models */
 const REMOTE_CONNECT_CPU_MODELS_MAX = 8192;
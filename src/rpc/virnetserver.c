@@ -72,6 +72,10 @@ struct _virNetServer {
     virNetServerClientPrivPreExecRestart clientPrivPreExecRestart;
     virFreeCallback clientPrivFree;
     void *clientPrivOpaque;
+
+    /* Daemon specific statistics */
+    virNetServerStatsFunc statsFunc;
+    void *statsOpaque;
 };
 
 
@@ -1154,6 +1158,50 @@ virNetServerSetClientLimits(virNetServer *srv,
     return ret;
 }
 
+/**
+ * virNetServerSetStatsCallback:
+ * @srv: server object
+ * @func: callback filling in statistics
+ * @opaque: data passed to @func
+ *
+ * Registers @func which reports statistics specific to the daemon
+ * @srv belongs to, e.g. to be queried through the admin interface.
+ */
+void
+virNetServerSetStatsCallback(virNetServer *srv,
+                             virNetServerStatsFunc func,
+                             void *opaque)
+{
+    virObjectLock(srv);
+    srv->statsFunc = func;
+    srv->statsOpaque = opaque;
+    virObjectUnlock(srv);
+}
+
+
+int
+virNetServerGetStats(virNetServer *srv,
+                     virTypedParamList *params)
+{
+    virNetServerStatsFunc func;
+    void *opaque;
+
+    virObjectLock(srv);
+    func = srv->statsFunc;
+    opaque = srv->statsOpaque;
+    virObjectUnlock(srv);
+
+    if (!func) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED,
+                       _("server '%s' doesn't provide any statistics"),
+                       srv->name);
+        return -1;
+    }
+
+    return func(srv, params, opaque);
+}
+
+
 static virNetTLSContext *
 virNetServerGetTLSContext(virNetServer *srv)
 {
@@ -28,6 +28,7 @@
 #include "virobject.h"
 #include "virjson.h"
 #include "virsystemd.h"
+#include "virtypedparam.h"
 
 
 virNetServer *virNetServerNew(const char *name,
@@ -136,3 +137,14 @@ int virNetServerSetClientLimits(virNetServer *srv,
                                 long long int maxClientsUnauth);
 
 int virNetServerUpdateTlsFiles(virNetServer *srv);
+
+typedef int (*virNetServerStatsFunc)(virNetServer *srv,
+                                     virTypedParamList *params,
+                                     void *opaque);
+
+void virNetServerSetStatsCallback(virNetServer *srv,
+                                  virNetServerStatsFunc func,
+                                  void *opaque);
+
+int virNetServerGetStats(virNetServer *srv,
+                         virTypedParamList *params);
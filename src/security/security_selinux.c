@@ -1252,6 +1252,18 @@ virSecuritySELinuxSetFileconImpl(const char *path,
     /* Be aware that this function might run in a separate process.
      * Therefore, any driver state changes would be thrown away. */
 
+    char *econ = NULL;
+
+    if (getfilecon_raw(path, &econ) >= 0) {
+        bool same = STREQ(econ, tcon);
+
+        freecon(econ);
+        if (same) {
+            VIR_DEBUG("SELinux context on '%s' is already '%s'", path, tcon);
+            return 0;
+        }
+    }
+
     VIR_INFO("Setting SELinux context on '%s' to '%s'", path, tcon);
 
     if (setfilecon_raw(path, (const char *)tcon) < 0) {
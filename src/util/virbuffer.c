@@ -124,6 +124,38 @@ virBufferInitialize(virBuffer *buf)
 }
 
 
+/**
+ * virBufferReserve:
+ * @buf: the buffer
+ * @len: expected length of the complete content
+ *
+ * Preallocates @buf so that content up to @len bytes long can be added
+ * without any further reallocation. Useful when the size of the content
+ * is known in advance, e.g. from formatting the same object previously.
+ */
+void
+virBufferReserve(virBuffer *buf,
+                 size_t len)
+{
+    size_t used;
+
+    if (!buf || len == 0)
+        return;
+
+    if (!buf->str) {
+        buf->str = g_string_sized_new(len);
+        return;
+    }
+
+    if (buf->str->allocated_len > len)
+        return;
+
+    used = buf->str->len;
+    g_string_set_size(buf->str, len);
+    g_string_truncate(buf->str, used);
+}
+
+
 static void
 virBufferApplyIndent(virBuffer *buf)
 {
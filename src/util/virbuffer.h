@@ -55,6 +55,7 @@ void virBufferFreeAndReset(virBuffer *buf);
 G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(virBuffer, virBufferFreeAndReset);
 
 size_t virBufferUse(const virBuffer *buf);
+void virBufferReserve(virBuffer *buf, size_t len);
 void virBufferAdd(virBuffer *buf, const char *str, int len);
 void virBufferAddBuffer(virBuffer *buf, virBuffer *toadd);
 void virBufferAddChar(virBuffer *buf, char c);
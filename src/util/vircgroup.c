@@ -594,6 +594,169 @@ virCgroupGetValueStr(virCgroup *group,
 }
 
 
+typedef struct _virCgroupStatFile virCgroupStatFile;
+struct _virCgroupStatFile {
+    int fd;
+    size_t sizeHint; /* size of the last read, used to size the next buffer */
+};
+
+
+static void
+virCgroupStatFileFree(void *opaque)
+{
+    virCgroupStatFile *file = opaque;
+
+    if (!file)
+        return;
+
+    VIR_FORCE_CLOSE(file->fd);
+    g_free(file);
+}
+
+
+static virCgroupStatFile *
+virCgroupStatFileGet(virCgroup *group,
+                     const char *path)
+{
+    virCgroupStatFile *file;
+    int fd;
+
+    if (!group->statFiles)
+        group->statFiles = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                 g_free, virCgroupStatFileFree);
+
+    if ((file = g_hash_table_lookup(group->statFiles, path)))
+        return file;
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+        virReportSystemError(errno, _("Unable to open '%s'"), path);
+        return NULL;
+    }
+
+    file = g_new0(virCgroupStatFile, 1);
+    file->fd = fd;
+    file->sizeHint = BUFSIZ;
+
+    g_hash_table_insert(group->statFiles, g_strdup(path), file);
+
+    return file;
+}
+
+
+static int
+virCgroupStatFileRead(virCgroupStatFile *file,
+                      char **value)
+{
+    const size_t maxlen = 1024 * 1024;
+    g_autofree char *buf = NULL;
+    size_t alloc = file->sizeHint + BUFSIZ;
+    size_t len = 0;
+
+    buf = g_new0(char, alloc);
+
+    for (;;) {
+        ssize_t got;
+
+        if (alloc - len <= 1) {
+            if (len > maxlen) {
+                errno = EOVERFLOW;
+                return -1;
+            }
+            VIR_RESIZE_N(buf, alloc, len, BUFSIZ);
+        }
+
+        got = pread(file->fd, buf + len, alloc - len - 1, len);
+        if (got < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        if (got == 0)
+            break;
+
+        len += got;
+    }
+
+    file->sizeHint = len;
+
+    if (len > 0 && buf[len - 1] == '\n')
+        len--;
+    buf[len] = '\0';
+
+    *value = g_steal_pointer(&buf);
+    return 0;
+}
+
+
+/**
+ * virCgroupGetValueStat:
+ * @group: the cgroup the statistics file belongs to
+ * @controller: controller providing the file
+ * @key: name of the statistics file, e.g. "cpu.stat"
+ * @value: filled with the contents of the file
+ *
+ * Variant of virCgroupGetValueStr() for statistics files which are
+ * polled periodically. The file descriptor is opened on first use and
+ * cached in @group until it is freed, subsequent reads only cost a
+ * pread() from offset zero. The caller must serialize access to @group
+ * which for domain cgroups is guaranteed by the domain object lock.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virCgroupGetValueStat(virCgroup *group,
+                      int controller,
+                      const char *key,
+                      char **value)
+{
+    g_autofree char *keypath = NULL;
+    virCgroupStatFile *file;
+
+    *value = NULL;
+
+    if (virCgroupPathOfController(group, controller, key, &keypath) < 0)
+        return -1;
+
+    VIR_DEBUG("Get stat value %s", keypath);
+
+    if (!(file = virCgroupStatFileGet(group, keypath)))
+        return -1;
+
+    if (virCgroupStatFileRead(file, value) < 0) {
+        virReportSystemError(errno, _("Unable to read from '%s'"), keypath);
+        /* The cgroup might have been removed and recreated behind our
+         * back, don't keep a stale descriptor around. */
+        g_hash_table_remove(group->statFiles, keypath);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int
+virCgroupGetValueStatU64(virCgroup *group,
+                         int controller,
+                         const char *key,
+                         unsigned long long int *value)
+{
+    g_autofree char *strval = NULL;
+
+    if (virCgroupGetValueStat(group, controller, key, &strval) < 0)
+        return -1;
+
+    if (virStrToLong_ull(strval, NULL, 10, value) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unable to parse '%s' as an integer"),
+                       strval);
+        return -1;
+    }
+
+    return 0;
+}
+
+
 int
 virCgroupGetValueForBlkDev(const char *str,
                            const char *path,
@@ -2442,37 +2605,50 @@ virCgroupGetPercpuStats(virCgroup *group,
 }
 
 
+static int
+virCgroupGetCpuacctTimes(virCgroup *group,
+                         unsigned long long *usage,
+                         unsigned long long *user,
+                         unsigned long long *sys)
+{
+    virCgroup *parent = virCgroupGetNested(group);
+
+    VIR_CGROUP_BACKEND_CALL(parent, VIR_CGROUP_CONTROLLER_CPUACCT,
+                            getCpuacctTimes, -1, usage, user, sys);
+}
+
+
 int
 virCgroupGetDomainTotalCpuStats(virCgroup *group,
                                 virTypedParameterPtr params,
                                 int nparams)
 {
     unsigned long long cpu_time;
+    unsigned long long user = 0;
+    unsigned long long sys = 0;
     int ret;
 
     if (nparams == 0) /* return supported number of params */
         return CGROUP_NB_TOTAL_CPU_STAT_PARAM;
-    /* entry 0 is cputime */
-    ret = virCgroupGetCpuacctUsage(group, &cpu_time);
+
+    /* Fetch all the times at once so that backends which report them
+     * in a single file need to read and parse it just once */
+    if (nparams > 1)
+        ret = virCgroupGetCpuacctTimes(group, &cpu_time, &user, &sys);
+    else
+        ret = virCgroupGetCpuacctUsage(group, &cpu_time);
+
     if (ret < 0) {
         virReportSystemError(-ret, "%s", _("unable to get cpu account"));
         return -1;
     }
 
+    /* entry 0 is cputime */
     if (virTypedParameterAssign(&params[0], VIR_DOMAIN_CPU_STATS_CPUTIME,
                                 VIR_TYPED_PARAM_ULLONG, cpu_time) < 0)
         return -1;
 
     if (nparams > 1) {
-        unsigned long long user;
-        unsigned long long sys;
-
-        ret = virCgroupGetCpuacctStat(group, &user, &sys);
-        if (ret < 0) {
-            virReportSystemError(-ret, "%s", _("unable to get cpu account"));
-            return -1;
-        }
-
         if (virTypedParameterAssign(&params[1],
                                     VIR_DOMAIN_CPU_STATS_USERTIME,
                                     VIR_TYPED_PARAM_ULLONG, user) < 0)
@@ -2633,6 +2809,10 @@ virCgroupRemove(virCgroup *group)
 {
     size_t i;
 
+    /* Don't pin the files of a group that is going away */
+    if (group->statFiles)
+        g_hash_table_remove_all(group->statFiles);
+
     for (i = 0; i < VIR_CGROUP_BACKEND_TYPE_LAST; i++) {
         if (group->backends[i]) {
             int rc = group->backends[i]->remove(group);
@@ -3834,6 +4014,9 @@ virCgroupFree(virCgroup *group)
     g_free(group->unified.placement);
     g_free(group->unitName);
 
+    if (group->statFiles)
+        g_hash_table_unref(group->statFiles);
+
     virCgroupFree(group->nested);
 
     g_free(group);
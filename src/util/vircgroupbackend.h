@@ -337,6 +337,12 @@ typedef int
                              unsigned long long *user,
                              unsigned long long *sys);
 
+typedef int
+(*virCgroupGetCpuacctTimesCB)(virCgroup *group,
+                              unsigned long long *usage,
+                              unsigned long long *user,
+                              unsigned long long *sys);
+
 typedef int
 (*virCgroupSetFreezerStateCB)(virCgroup *group,
                               const char *state);
@@ -438,6 +444,7 @@ struct _virCgroupBackend {
     virCgroupGetCpuacctUsageCB getCpuacctUsage;
     virCgroupGetCpuacctPercpuUsageCB getCpuacctPercpuUsage;
     virCgroupGetCpuacctStatCB getCpuacctStat;
+    virCgroupGetCpuacctTimesCB getCpuacctTimes;
 
     virCgroupSetFreezerStateCB setFreezerState;
     virCgroupGetFreezerStateCB getFreezerState;
@@ -64,6 +64,9 @@ struct _virCgroup {
 
     char *unitName;
     virCgroup *nested;
+
+    /* Cached descriptors of statistics files, keyed by path */
+    GHashTable *statFiles;
 };
 
 #define virCgroupGetNested(cgroup) \
@@ -89,6 +92,16 @@ int virCgroupGetValueStr(virCgroup *group,
                          const char *key,
                          char **value);
 
+int virCgroupGetValueStat(virCgroup *group,
+                          int controller,
+                          const char *key,
+                          char **value);
+
+int virCgroupGetValueStatU64(virCgroup *group,
+                             int controller,
+                             const char *key,
+                             unsigned long long int *value);
+
 int virCgroupSetValueU64(virCgroup *group,
                          int controller,
                          const char *key,
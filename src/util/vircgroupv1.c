@@ -1088,14 +1088,14 @@ virCgroupV1GetBlkioIoServiced(virCgroup *group,
     *requests_read = 0;
     *requests_write = 0;
 
-    if (virCgroupGetValueStr(group,
-                             VIR_CGROUP_CONTROLLER_BLKIO,
-                             "blkio.throttle.io_service_bytes", &str1) < 0)
+    if (virCgroupGetValueStat(group,
+                              VIR_CGROUP_CONTROLLER_BLKIO,
+                              "blkio.throttle.io_service_bytes", &str1) < 0)
         return -1;
 
-    if (virCgroupGetValueStr(group,
-                             VIR_CGROUP_CONTROLLER_BLKIO,
-                             "blkio.throttle.io_serviced", &str2) < 0)
+    if (virCgroupGetValueStat(group,
+                              VIR_CGROUP_CONTROLLER_BLKIO,
+                              "blkio.throttle.io_serviced", &str2) < 0)
         return -1;
 
     /* sum up all entries of the same kind, from all devices */
@@ -1178,14 +1178,14 @@ virCgroupV1GetBlkioIoDeviceServiced(virCgroup *group,
         requests_write
     };
 
-    if (virCgroupGetValueStr(group,
-                             VIR_CGROUP_CONTROLLER_BLKIO,
-                             "blkio.throttle.io_service_bytes", &str1) < 0)
+    if (virCgroupGetValueStat(group,
+                              VIR_CGROUP_CONTROLLER_BLKIO,
+                              "blkio.throttle.io_service_bytes", &str1) < 0)
         return -1;
 
-    if (virCgroupGetValueStr(group,
-                             VIR_CGROUP_CONTROLLER_BLKIO,
-                             "blkio.throttle.io_serviced", &str2) < 0)
+    if (virCgroupGetValueStat(group,
+                              VIR_CGROUP_CONTROLLER_BLKIO,
+                              "blkio.throttle.io_serviced", &str2) < 0)
         return -1;
 
     if (!(str3 = virCgroupGetBlockDevString(path)))
@@ -1609,10 +1609,10 @@ virCgroupV1GetMemoryStat(virCgroup *group,
     unsigned long long inactiveFileVal = 0;
     unsigned long long unevictableVal = 0;
 
-    if (virCgroupGetValueStr(group,
-                             VIR_CGROUP_CONTROLLER_MEMORY,
-                             "memory.stat",
-                             &stat) < 0) {
+    if (virCgroupGetValueStat(group,
+                              VIR_CGROUP_CONTROLLER_MEMORY,
+                              "memory.stat",
+                              &stat) < 0) {
         return -1;
     }
 
@@ -2027,9 +2027,9 @@ static int
 virCgroupV1GetCpuacctUsage(virCgroup *group,
                            unsigned long long *usage)
 {
-    return virCgroupGetValueU64(group,
-                                VIR_CGROUP_CONTROLLER_CPUACCT,
-                                "cpuacct.usage", usage);
+    return virCgroupGetValueStatU64(group,
+                                    VIR_CGROUP_CONTROLLER_CPUACCT,
+                                    "cpuacct.usage", usage);
 }
 
 
@@ -2037,8 +2037,8 @@ static int
 virCgroupV1GetCpuacctPercpuUsage(virCgroup *group,
                                  char **usage)
 {
-    return virCgroupGetValueStr(group, VIR_CGROUP_CONTROLLER_CPUACCT,
-                                "cpuacct.usage_percpu", usage);
+    return virCgroupGetValueStat(group, VIR_CGROUP_CONTROLLER_CPUACCT,
+                                 "cpuacct.usage_percpu", usage);
 }
 
 
@@ -2051,8 +2051,8 @@ virCgroupV1GetCpuacctStat(virCgroup *group,
     char *p;
     static double scale = -1.0;
 
-    if (virCgroupGetValueStr(group, VIR_CGROUP_CONTROLLER_CPUACCT,
-                             "cpuacct.stat", &str) < 0)
+    if (virCgroupGetValueStat(group, VIR_CGROUP_CONTROLLER_CPUACCT,
+                              "cpuacct.stat", &str) < 0)
         return -1;
 
     if (!(p = STRSKIP(str, "user ")) ||
@@ -2088,6 +2088,21 @@ virCgroupV1GetCpuacctStat(virCgroup *group,
 }
 
 
+static int
+virCgroupV1GetCpuacctTimes(virCgroup *group,
+                           unsigned long long *usage,
+                           unsigned long long *user,
+                           unsigned long long *sys)
+{
+    /* cgroup v1 reports the total usage and the user/system split in
+     * separate files */
+    if (virCgroupV1GetCpuacctUsage(group, usage) < 0)
+        return -1;
+
+    return virCgroupV1GetCpuacctStat(group, user, sys);
+}
+
+
 static int
 virCgroupV1SetFreezerState(virCgroup *group,
                            const char *state)
@@ -2244,6 +2259,7 @@ virCgroupBackend virCgroupV1Backend = {
     .getCpuacctUsage = virCgroupV1GetCpuacctUsage,
     .getCpuacctPercpuUsage = virCgroupV1GetCpuacctPercpuUsage,
     .getCpuacctStat = virCgroupV1GetCpuacctStat,
+    .getCpuacctTimes = virCgroupV1GetCpuacctTimes,
 
     .setFreezerState = virCgroupV1SetFreezerState,
     .getFreezerState = virCgroupV1GetFreezerState,
@@ -751,34 +751,44 @@ virCgroupV2GetBlkioIoServiced(virCgroup *group,
     *requests_read = 0;
     *requests_write = 0;
 
-    if (virCgroupGetValueStr(group,
-                             VIR_CGROUP_CONTROLLER_BLKIO,
-                             "io.stat", &str1) < 0) {
+    if (virCgroupGetValueStat(group,
+                              VIR_CGROUP_CONTROLLER_BLKIO,
+                              "io.stat", &str1) < 0) {
         return -1;
     }
 
-    /* sum up all entries of the same kind, from all devices */
-    for (i = 0; i < G_N_ELEMENTS(value_names); i++) {
-        p1 = str1;
-
-        while ((p1 = strstr(p1, value_names[i]))) {
-            p1 += strlen(value_names[i]);
-            if (virStrToLong_ll(p1, &p1, 10, &stats_val) < 0) {
-                virReportError(VIR_ERR_INTERNAL_ERROR,
-                               _("Cannot parse byte '%s' stat '%s'"),
-                               value_names[i], p1);
-                return -1;
-            }
+    /* sum up all entries of the same kind, from all devices, walking
+     * the "key=value" tokens just once */
+    p1 = str1;
+    while (*p1) {
+        p1 += strspn(p1, " \n");
 
-            if (stats_val < 0 ||
-                (stats_val > 0 && *value_ptrs[i] > (LLONG_MAX - stats_val))) {
-                virReportError(VIR_ERR_OVERFLOW,
-                               _("Sum of byte '%s' stat overflows"),
-                               value_names[i]);
-                return -1;
-            }
-            *value_ptrs[i] += stats_val;
+        for (i = 0; i < G_N_ELEMENTS(value_names); i++) {
+            if (STRPREFIX(p1, value_names[i]))
+                break;
+        }
+
+        if (i == G_N_ELEMENTS(value_names)) {
+            p1 += strcspn(p1, " \n");
+            continue;
         }
+
+        p1 += strlen(value_names[i]);
+        if (virStrToLong_ll(p1, &p1, 10, &stats_val) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Cannot parse byte '%s' stat '%s'"),
+                           value_names[i], p1);
+            return -1;
+        }
+
+        if (stats_val < 0 ||
+            (stats_val > 0 && *value_ptrs[i] > (LLONG_MAX - stats_val))) {
+            virReportError(VIR_ERR_OVERFLOW,
+                           _("Sum of byte '%s' stat overflows"),
+                           value_names[i]);
+            return -1;
+        }
+        *value_ptrs[i] += stats_val;
     }
 
     return 0;
@@ -811,9 +821,9 @@ virCgroupV2GetBlkioIoDeviceServiced(virCgroup *group,
         requests_write
     };
 
-    if (virCgroupGetValueStr(group,
-                             VIR_CGROUP_CONTROLLER_BLKIO,
-                             "io.stat", &str1) < 0) {
+    if (virCgroupGetValueStat(group,
+                              VIR_CGROUP_CONTROLLER_BLKIO,
+                              "io.stat", &str1) < 0) {
         return -1;
     }
 
@@ -1247,10 +1257,10 @@ virCgroupV2GetMemoryStat(virCgroup *group,
     unsigned long long inactiveFileVal = 0;
     unsigned long long unevictableVal = 0;
 
-    if (virCgroupGetValueStr(group,
-                             VIR_CGROUP_CONTROLLER_MEMORY,
-                             "memory.stat",
-                             &stat) < 0) {
+    if (virCgroupGetValueStat(group,
+                              VIR_CGROUP_CONTROLLER_MEMORY,
+                              "memory.stat",
+                              &stat) < 0) {
         return -1;
     }
 
@@ -1667,82 +1677,78 @@ virCgroupV2SupportsCpuBW(virCgroup *cgroup)
 }
 
 
+/*
+ * Parses the usage, user and system times out of a single read of the
+ * "cpu.stat" file. Any of the output arguments may be NULL if the caller
+ * isn't interested in the value. The times are reported in nanoseconds.
+ */
 static int
-virCgroupV2GetCpuacctUsage(virCgroup *group,
-                           unsigned long long *usage)
+virCgroupV2GetCpuStat(virCgroup *group,
+                      unsigned long long *usage,
+                      unsigned long long *user,
+                      unsigned long long *sys)
 {
     g_autofree char *str = NULL;
-    char *tmp;
+    const char *names[] = { "usage_usec ", "user_usec ", "system_usec " };
+    unsigned long long *values[] = { usage, user, sys };
+    size_t i;
 
-    if (virCgroupGetValueStr(group, VIR_CGROUP_CONTROLLER_CPUACCT,
-                             "cpu.stat", &str) < 0) {
+    if (virCgroupGetValueStat(group, VIR_CGROUP_CONTROLLER_CPUACCT,
+                              "cpu.stat", &str) < 0) {
         return -1;
     }
 
-    if (!(tmp = strstr(str, "usage_usec "))) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("cannot parse cpu usage stat '%s'"), str);
-        return -1;
-    }
-    tmp += strlen("usage_usec ");
+    for (i = 0; i < G_N_ELEMENTS(names); i++) {
+        char *tmp;
 
-    if (virStrToLong_ull(tmp, &tmp, 10, usage) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("Failed to parse value '%s' as number."), tmp);
-        return -1;
-    }
+        if (!values[i])
+            continue;
 
-    *usage *= 1000;
+        if (!(tmp = strstr(str, names[i]))) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("cannot parse cpu stat '%s' from '%s'"),
+                           names[i], str);
+            return -1;
+        }
+        tmp += strlen(names[i]);
+
+        if (virStrToLong_ull(tmp, &tmp, 10, values[i]) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Failed to parse value '%s' as number."), tmp);
+            return -1;
+        }
+
+        *values[i] *= 1000;
+    }
 
     return 0;
 }
 
 
+static int
+virCgroupV2GetCpuacctUsage(virCgroup *group,
+                           unsigned long long *usage)
+{
+    return virCgroupV2GetCpuStat(group, usage, NULL, NULL);
+}
+
+
 static int
 virCgroupV2GetCpuacctStat(virCgroup *group,
                           unsigned long long *user,
                           unsigned long long *sys)
 {
-    g_autofree char *str = NULL;
-    char *tmp;
-    unsigned long long userVal = 0;
-    unsigned long long sysVal = 0;
-
-    if (virCgroupGetValueStr(group, VIR_CGROUP_CONTROLLER_CPUACCT,
-                             "cpu.stat", &str) < 0) {
-        return -1;
-    }
-
-    if (!(tmp = strstr(str, "user_usec "))) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("cannot parse cpu user stat '%s'"), str);
-        return -1;
-    }
-    tmp += strlen("user_usec ");
-
-    if (virStrToLong_ull(tmp, &tmp, 10, &userVal) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("Failed to parse value '%s' as number."), tmp);
-        return -1;
-    }
-
-    if (!(tmp = strstr(str, "system_usec "))) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("cannot parse cpu sys stat '%s'"), str);
-        return -1;
-    }
-    tmp += strlen("system_usec ");
-
-    if (virStrToLong_ull(tmp, &tmp, 10, &sysVal) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("Failed to parse value '%s' as number."), tmp);
-        return -1;
-    }
+    return virCgroupV2GetCpuStat(group, NULL, user, sys);
+}
 
-    *user = userVal * 1000;
-    *sys = sysVal * 1000;
 
-    return 0;
+static int
+virCgroupV2GetCpuacctTimes(virCgroup *group,
+                           unsigned long long *usage,
+                           unsigned long long *user,
+                           unsigned long long *sys)
+{
+    return virCgroupV2GetCpuStat(group, usage, user, sys);
 }
 
 
@@ -1970,6 +1976,7 @@ virCgroupBackend virCgroupV2Backend = {
 
     .getCpuacctUsage = virCgroupV2GetCpuacctUsage,
     .getCpuacctStat = virCgroupV2GetCpuacctStat,
+    .getCpuacctTimes = virCgroupV2GetCpuacctTimes,
 
     .setCpusetMems = virCgroupV2SetCpusetMems,
     .getCpusetMems = virCgroupV2GetCpusetMems,
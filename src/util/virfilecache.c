@@ -34,6 +34,7 @@
 #include "virlog.h"
 #include "virobject.h"
 #include "virstring.h"
+#include "virthread.h"
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -43,11 +44,29 @@
 
 VIR_LOG_INIT("util.filecache");
 
+/* Minimal time between two background refreshes of the same name */
+#define VIR_FILE_CACHE_REFRESH_INTERVAL (10 * G_USEC_PER_SEC)
+
+/*
+ * Per-name state which allows validating and creating data for one name
+ * without holding the lock of the whole cache.
+ */
+typedef struct _virFileCacheEntry virFileCacheEntry;
+struct _virFileCacheEntry {
+    virMutex lock;
+    virCond cond;
+    bool busy; /* a lookup is validating or creating the data */
+    bool refreshing; /* new data is being created in the background */
+    gint64 refreshStarted; /* monotonic time of the last background refresh */
+    gint64 validUntil; /* monotonic time until which isValid is skipped */
+};
+
 
 struct _virFileCache {
     virObjectLockable parent;
 
     GHashTable *table;
+    GHashTable *entries;
 
     char *dir;
     char *suffix;
@@ -55,6 +74,9 @@ struct _virFileCache {
     void *priv;
 
     virFileCacheHandlers handlers;
+
+    unsigned int validityTTL; /* milliseconds */
+    bool refreshInBackground;
 };
 
 
@@ -78,11 +100,43 @@ virFileCacheDispose(void *obj)
     g_free(cache->suffix);
 
     virHashFree(cache->table);
+    virHashFree(cache->entries);
 
     virFileCachePrivFree(cache);
 }
 
 
+static void
+virFileCacheEntryFree(void *opaque)
+{
+    virFileCacheEntry *entry = opaque;
+
+    virMutexDestroy(&entry->lock);
+    virCondDestroy(&entry->cond);
+    g_free(entry);
+}
+
+
+static virFileCacheEntry *
+virFileCacheEntryNew(void)
+{
+    g_autofree virFileCacheEntry *entry = g_new0(virFileCacheEntry, 1);
+
+    if (virMutexInit(&entry->lock) < 0) {
+        virReportSystemError(errno, "%s", _("unable to init mutex"));
+        return NULL;
+    }
+
+    if (virCondInit(&entry->cond) < 0) {
+        virReportSystemError(errno, "%s", _("unable to init condition"));
+        virMutexDestroy(&entry->lock);
+        return NULL;
+    }
+
+    return g_steal_pointer(&entry);
+}
+
+
 static int
 virFileCacheOnceInit(void)
 {
@@ -243,6 +297,7 @@ virFileCacheNew(const char *dir,
         return NULL;
 
     cache->table = virHashNew(virObjectFreeHashData);
+    cache->entries = virHashNew(virFileCacheEntryFree);
 
     cache->dir = g_strdup(dir);
 
@@ -254,30 +309,262 @@ virFileCacheNew(const char *dir,
 }
 
 
+/**
+ * virFileCacheSetValidityTTL:
+ * @cache: existing cache object
+ * @ttl: time in milliseconds
+ *
+ * Once the data for a name was successfully validated or created,
+ * subsequent lookups within @ttl milliseconds return it without calling
+ * isValid() again. Zero (the default) validates the data on each lookup.
+ */
+void
+virFileCacheSetValidityTTL(virFileCache *cache,
+                           unsigned int ttl)
+{
+    virObjectLock(cache);
+    cache->validityTTL = ttl;
+    virObjectUnlock(cache);
+}
+
+
+/**
+ * virFileCacheSetRefreshInBackground:
+ * @cache: existing cache object
+ * @enable: whether to refresh outdated data in the background
+ *
+ * When enabled, a lookup which finds the cached data outdated starts
+ * creating new data in a separate thread and returns the outdated data
+ * instead of waiting for the new one. Lookups keep returning the
+ * outdated data until the new data is ready. Only a lookup which finds
+ * no data at all has to wait for the data to be created.
+ *
+ * If the background refresh fails, the outdated data is dropped so that
+ * the next lookup creates the data itself and sees the error. The data
+ * for one name is refreshed in the background at most once every ten
+ * seconds, more frequent refreshes are done by the lookup itself.
+ *
+ * Disabled by default.
+ */
+void
+virFileCacheSetRefreshInBackground(virFileCache *cache,
+                                   bool enable)
+{
+    virObjectLock(cache);
+    cache->refreshInBackground = enable;
+    virObjectUnlock(cache);
+}
+
+
+static virFileCacheEntry *
+virFileCacheGetEntry(virFileCache *cache,
+                     const char *name)
+{
+    virFileCacheEntry *entry;
+
+    virObjectLock(cache);
+
+    if (!(entry = virHashLookup(cache->entries, name)) &&
+        (entry = virFileCacheEntryNew()) &&
+        virHashAddEntry(cache->entries, name, entry) < 0) {
+        virFileCacheEntryFree(entry);
+        entry = NULL;
+    }
+
+    virObjectUnlock(cache);
+
+    return entry;
+}
+
+
+static void *
+virFileCacheGetData(virFileCache *cache,
+                    const char *name)
+{
+    void *data;
+
+    virObjectLock(cache);
+    data = virObjectRef(virHashLookup(cache->table, name));
+    virObjectUnlock(cache);
+
+    return data;
+}
+
+
+static int
+virFileCacheSetData(virFileCache *cache,
+                    const char *name,
+                    void *data)
+{
+    int ret;
+
+    virObjectLock(cache);
+    ret = virHashUpdateEntry(cache->table, name, virObjectRef(data));
+    virObjectUnlock(cache);
+
+    if (ret < 0)
+        virObjectUnref(data);
+
+    return ret;
+}
+
+
+static gint64
+virFileCacheValidUntil(virFileCache *cache)
+{
+    unsigned int ttl;
+
+    virObjectLock(cache);
+    ttl = cache->validityTTL;
+    virObjectUnlock(cache);
+
+    return g_get_monotonic_time() + ttl * 1000ll;
+}
+
+
+struct virFileCacheRefreshData {
+    virFileCache *cache;
+    virFileCacheEntry *entry;
+    char *name;
+};
+
+
 static void
+virFileCacheRefreshThread(void *opaque)
+{
+    struct virFileCacheRefreshData *refresh = opaque;
+    virFileCache *cache = refresh->cache;
+    virFileCacheEntry *entry = refresh->entry;
+    void *data;
+    bool ok = false;
+
+    VIR_DEBUG("Refreshing data for '%s' in the background", refresh->name);
+
+    if ((data = virFileCacheNewData(cache, refresh->name))) {
+        ok = virFileCacheSetData(cache, refresh->name, data) == 0;
+        virObjectUnref(data);
+    }
+
+    if (!ok) {
+        VIR_WARN("Failed to refresh cached data for '%s': %s",
+                 refresh->name, virGetLastErrorMessage());
+        virResetLastError();
+
+        /* don't keep serving the outdated data */
+        virObjectLock(cache);
+        virHashRemoveEntry(cache->table, refresh->name);
+        virObjectUnlock(cache);
+    }
+
+    virMutexLock(&entry->lock);
+    entry->refreshing = false;
+    if (ok)
+        entry->validUntil = virFileCacheValidUntil(cache);
+    virCondBroadcast(&entry->cond);
+    virMutexUnlock(&entry->lock);
+
+    g_free(refresh->name);
+    g_free(refresh);
+    virObjectUnref(cache);
+}
+
+
+static int
+virFileCacheStartRefresh(virFileCache *cache,
+                         virFileCacheEntry *entry,
+                         const char *name)
+{
+    struct virFileCacheRefreshData *refresh;
+    virThread thread;
+
+    refresh = g_new0(struct virFileCacheRefreshData, 1);
+    refresh->cache = virObjectRef(cache);
+    refresh->entry = entry;
+    refresh->name = g_strdup(name);
+
+    if (virThreadCreateFull(&thread, false, virFileCacheRefreshThread,
+                            "file-cache-refresh", false, refresh) < 0) {
+        VIR_WARN("Failed to create thread for refreshing '%s'", name);
+        virResetLastError();
+        virObjectUnref(cache);
+        g_free(refresh->name);
+        g_free(refresh);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Validates the data cached for @name, or creates new data if there's
+ * none or it is outdated. Called with @entry->busy set and no lock held,
+ * consumes the reference of @data and returns a new one.
+ */
+static void *
 virFileCacheValidate(virFileCache *cache,
+                     virFileCacheEntry *entry,
                      const char *name,
-                     void **data)
+                     void *data,
+                     bool *valid)
 {
-    if (*data && !cache->handlers.isValid(*data, cache->priv)) {
-        VIR_DEBUG("Cached data '%p' no longer valid for '%s'",
-                  *data, NULLSTR(name));
-        if (name)
-            virHashRemoveEntry(cache->table, name);
-        *data = NULL;
-    }
+    bool background;
+
+    *valid = false;
+
+    if (data) {
+        if (cache->handlers.isValid(data, cache->priv)) {
+            *valid = true;
+            return data;
+        }
+
+        VIR_DEBUG("Cached data '%p' no longer valid for '%s'", data, name);
 
-    if (!*data && name) {
-        VIR_DEBUG("Creating data for '%s'", name);
-        *data = virFileCacheNewData(cache, name);
-        if (*data) {
-            VIR_DEBUG("Caching data '%p' for '%s'", *data, name);
-            if (virHashAddEntry(cache->table, name, *data) < 0) {
-                virObjectUnref(*data);
-                *data = NULL;
+        virObjectLock(cache);
+        background = cache->refreshInBackground;
+        virObjectUnlock(cache);
+
+        if (background) {
+            gint64 now = g_get_monotonic_time();
+
+            virMutexLock(&entry->lock);
+            if (entry->refreshStarted &&
+                now < entry->refreshStarted + VIR_FILE_CACHE_REFRESH_INTERVAL) {
+                background = false;
+            } else {
+                entry->refreshing = true;
+                entry->refreshStarted = now;
             }
+            virMutexUnlock(&entry->lock);
+        }
+
+        if (background) {
+            if (virFileCacheStartRefresh(cache, entry, name) == 0)
+                return data;
+
+            virMutexLock(&entry->lock);
+            entry->refreshing = false;
+            virMutexUnlock(&entry->lock);
         }
+
+        virObjectLock(cache);
+        virHashRemoveEntry(cache->table, name);
+        virObjectUnlock(cache);
+        g_clear_pointer(&data, virObjectUnref);
+    }
+
+    VIR_DEBUG("Creating data for '%s'", name);
+    if (!(data = virFileCacheNewData(cache, name)))
+        return NULL;
+
+    VIR_DEBUG("Caching data '%p' for '%s'", data, name);
+    if (virFileCacheSetData(cache, name, data) < 0) {
+        virObjectUnref(data);
+        return NULL;
     }
+
+    *valid = true;
+    return data;
 }
 
 
@@ -290,6 +577,10 @@ virFileCacheValidate(virFileCache *cache,
  * cached data, if it doesn't exist or is no longer valid new data
  * is created.
  *
+ * Validating and creating the data is done without holding the lock
+ * of @cache, so lookups of other names are not blocked by it. Concurrent
+ * lookups of the same name wait for the first one to finish.
+ *
  * Returns data object or NULL on error.  The caller is responsible for
  * unrefing the data.
  */
@@ -297,15 +588,49 @@ void *
 virFileCacheLookup(virFileCache *cache,
                    const char *name)
 {
+    virFileCacheEntry *entry;
     void *data = NULL;
+    bool valid;
 
-    virObjectLock(cache);
+    if (!(entry = virFileCacheGetEntry(cache, name)))
+        return NULL;
 
-    data = virHashLookup(cache->table, name);
-    virFileCacheValidate(cache, name, &data);
+    virMutexLock(&entry->lock);
 
-    virObjectRef(data);
-    virObjectUnlock(cache);
+    while (true) {
+        data = virFileCacheGetData(cache, name);
+
+        /* Recently validated data or outdated data being replaced in the
+         * background can be returned right away */
+        if (data &&
+            (entry->refreshing || g_get_monotonic_time() < entry->validUntil)) {
+            virMutexUnlock(&entry->lock);
+            return data;
+        }
+
+        if (!entry->busy)
+            break;
+
+        g_clear_pointer(&data, virObjectUnref);
+
+        if (virCondWait(&entry->cond, &entry->lock) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("failed to wait for cached data"));
+            virMutexUnlock(&entry->lock);
+            return NULL;
+        }
+    }
+
+    entry->busy = true;
+    virMutexUnlock(&entry->lock);
+
+    data = virFileCacheValidate(cache, entry, name, data, &valid);
+
+    virMutexLock(&entry->lock);
+    entry->busy = false;
+    entry->validUntil = valid ? virFileCacheValidUntil(cache) : 0;
+    virCondBroadcast(&entry->cond);
+    virMutexUnlock(&entry->lock);
 
     return data;
 }
@@ -327,18 +652,16 @@ virFileCacheLookupByFunc(virFileCache *cache,
                          virHashSearcher iter,
                          const void *iterData)
 {
-    void *data = NULL;
     g_autofree char *name = NULL;
 
     virObjectLock(cache);
-
-    data = virHashSearch(cache->table, iter, iterData, &name);
-    virFileCacheValidate(cache, name, &data);
-
-    virObjectRef(data);
+    ignore_value(virHashSearch(cache->table, iter, iterData, &name));
     virObjectUnlock(cache);
 
-    return data;
+    if (!name)
+        return NULL;
+
+    return virFileCacheLookup(cache, name);
 }
 
 
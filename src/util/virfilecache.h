@@ -27,6 +27,18 @@
 #include "virhash.h"
 
 typedef struct _virFileCache virFileCache;
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virFileCache, virObjectUnref);
+
+/*
+ * Thread safety of handlers:
+ *
+ * The cache calls isValid, newData, loadFile and saveFile without holding
+ * its lock. The calls are serialized per name, but handlers for different
+ * names may run concurrently with each other and with the caller of
+ * virFileCacheGetPriv. Any state in @priv that is modified after the cache
+ * was created must be protected by the owner of @priv. privFree is called
+ * once no other handler can run.
+ */
 
 /**
  * virFileCacheIsValidPtr:
@@ -115,6 +127,14 @@ virFileCacheNew(const char *dir,
                 const char *suffix,
                 virFileCacheHandlers *handlers);
 
+void
+virFileCacheSetValidityTTL(virFileCache *cache,
+                           unsigned int ttl);
+
+void
+virFileCacheSetRefreshInBackground(virFileCache *cache,
+                                   bool enable);
+
 void *
 virFileCacheLookup(virFileCache *cache,
                    const char *name);
@@ -49,6 +49,7 @@
 #include "virstring.h"
 #include "virnuma.h"
 #include "virlog.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -189,8 +190,36 @@ virHostCPUGetStatsFreeBSD(int cpuNum,
 
 # define LINUX_NB_CPU_STATS 4
 
-int
-virHostCPUGetSocket(unsigned int cpu, unsigned int *socket)
+/* Host CPU topology cache */
+typedef struct _virHostCPUTopology virHostCPUTopology;
+struct _virHostCPUTopology {
+    bool valid;
+    unsigned int socket;
+    unsigned int die;
+    unsigned int core;
+    virBitmap *siblings;
+};
+
+/* Topology of CPUs doesn't change unless they are hot(un)plugged or
+ * (off|on)lined which is reflected in the 'present' and 'online' CPU
+ * lists. Those are rechecked at most once per this interval (in us). */
+# define VIR_HOST_CPU_TOPOLOGY_CHECK_INTERVAL (1000 * 1000)
+
+static virMutex virHostCPUTopologyLock = VIR_MUTEX_INITIALIZER;
+static virHostCPUTopology *virHostCPUTopologyCPUs;
+static size_t virHostCPUTopologyNCPUs;
+static char *virHostCPUTopologyPresent;
+static char *virHostCPUTopologyOnline;
+static gint64 virHostCPUTopologyChecked;
+
+static virMutex virHostCPUStatsLock = VIR_MUTEX_INITIALIZER;
+static virHostCPUStatsLinux *virHostCPUStatsCache;
+static size_t virHostCPUStatsCacheLen;
+static gint64 virHostCPUStatsCacheTime;
+
+
+static int
+virHostCPUReadSocket(unsigned int cpu, unsigned int *socket)
 {
     int tmp;
     int ret = virFileReadValueInt(&tmp,
@@ -214,8 +243,8 @@ virHostCPUGetSocket(unsigned int cpu, unsigned int *socket)
     return 0;
 }
 
-int
-virHostCPUGetDie(unsigned int cpu, unsigned int *die)
+static int
+virHostCPUReadDie(unsigned int cpu, unsigned int *die)
 {
     int die_id;
     int ret = virFileReadValueInt(&die_id,
@@ -237,8 +266,8 @@ virHostCPUGetDie(unsigned int cpu, unsigned int *die)
     return 0;
 }
 
-int
-virHostCPUGetCore(unsigned int cpu, unsigned int *core)
+static int
+virHostCPUReadCore(unsigned int cpu, unsigned int *core)
 {
     int ret = virFileReadValueUint(core,
                                    "%s/cpu/cpu%u/topology/core_id",
@@ -253,8 +282,8 @@ virHostCPUGetCore(unsigned int cpu, unsigned int *core)
     return 0;
 }
 
-virBitmap *
-virHostCPUGetSiblingsList(unsigned int cpu)
+static virBitmap *
+virHostCPUReadSiblingsList(unsigned int cpu)
 {
     virBitmap *ret = NULL;
     int rv = -1;
@@ -271,6 +300,165 @@ virHostCPUGetSiblingsList(unsigned int cpu)
     return ret;
 }
 
+
+/* Must be called with virHostCPUTopologyLock held */
+static void
+virHostCPUTopologyCacheClearLocked(void)
+{
+    size_t i;
+
+    for (i = 0; i < virHostCPUTopologyNCPUs; i++)
+        virBitmapFree(virHostCPUTopologyCPUs[i].siblings);
+
+    g_clear_pointer(&virHostCPUTopologyCPUs, g_free);
+    virHostCPUTopologyNCPUs = 0;
+    g_clear_pointer(&virHostCPUTopologyPresent, g_free);
+    g_clear_pointer(&virHostCPUTopologyOnline, g_free);
+    virHostCPUTopologyChecked = 0;
+}
+
+
+/**
+ * virHostCPUTopologyCacheClear:
+ *
+ * Drop the cached topology of host CPUs so that it's read again from
+ * sysfs on the next use.
+ */
+void
+virHostCPUTopologyCacheClear(void)
+{
+    virMutexLock(&virHostCPUTopologyLock);
+    virHostCPUTopologyCacheClearLocked();
+    virMutexUnlock(&virHostCPUTopologyLock);
+}
+
+
+/* Must be called with virHostCPUTopologyLock held */
+static void
+virHostCPUTopologyCacheValidateLocked(void)
+{
+    gint64 now = g_get_monotonic_time();
+    g_autofree char *present = NULL;
+    g_autofree char *online = NULL;
+
+    if (virHostCPUTopologyChecked != 0 &&
+        now - virHostCPUTopologyChecked < VIR_HOST_CPU_TOPOLOGY_CHECK_INTERVAL)
+        return;
+
+    ignore_value(virFileReadValueString(&present, "%s/cpu/present",
+                                        SYSFS_SYSTEM_PATH));
+    ignore_value(virFileReadValueString(&online, "%s/cpu/online",
+                                        SYSFS_SYSTEM_PATH));
+
+    if (STRNEQ_NULLABLE(present, virHostCPUTopologyPresent) ||
+        STRNEQ_NULLABLE(online, virHostCPUTopologyOnline)) {
+        VIR_DEBUG("Host CPUs changed, dropping cached topology");
+        virHostCPUTopologyCacheClearLocked();
+        virHostCPUTopologyPresent = g_steal_pointer(&present);
+        virHostCPUTopologyOnline = g_steal_pointer(&online);
+    }
+
+    virHostCPUTopologyChecked = now;
+}
+
+
+/*
+ * Look up topology of @cpu, reading it from sysfs if not cached yet.
+ * The returned pointer is valid only while virHostCPUTopologyLock is
+ * held.
+ */
+static virHostCPUTopology *
+virHostCPUTopologyGetLocked(unsigned int cpu)
+{
+    virHostCPUTopology *topo;
+
+    virHostCPUTopologyCacheValidateLocked();
+
+    if (cpu >= virHostCPUTopologyNCPUs)
+        VIR_EXPAND_N(virHostCPUTopologyCPUs, virHostCPUTopologyNCPUs,
+                     cpu + 1 - virHostCPUTopologyNCPUs);
+
+    topo = &virHostCPUTopologyCPUs[cpu];
+
+    if (topo->valid)
+        return topo;
+
+    if (virHostCPUReadSocket(cpu, &topo->socket) < 0 ||
+        virHostCPUReadDie(cpu, &topo->die) < 0 ||
+        virHostCPUReadCore(cpu, &topo->core) < 0 ||
+        !(topo->siblings = virHostCPUReadSiblingsList(cpu)))
+        return NULL;
+
+    topo->valid = true;
+    return topo;
+}
+
+
+int
+virHostCPUGetSocket(unsigned int cpu, unsigned int *socket)
+{
+    virHostCPUTopology *topo;
+    int ret = -1;
+
+    virMutexLock(&virHostCPUTopologyLock);
+    if ((topo = virHostCPUTopologyGetLocked(cpu))) {
+        *socket = topo->socket;
+        ret = 0;
+    }
+    virMutexUnlock(&virHostCPUTopologyLock);
+
+    return ret;
+}
+
+
+int
+virHostCPUGetDie(unsigned int cpu, unsigned int *die)
+{
+    virHostCPUTopology *topo;
+    int ret = -1;
+
+    virMutexLock(&virHostCPUTopologyLock);
+    if ((topo = virHostCPUTopologyGetLocked(cpu))) {
+        *die = topo->die;
+        ret = 0;
+    }
+    virMutexUnlock(&virHostCPUTopologyLock);
+
+    return ret;
+}
+
+
+int
+virHostCPUGetCore(unsigned int cpu, unsigned int *core)
+{
+    virHostCPUTopology *topo;
+    int ret = -1;
+
+    virMutexLock(&virHostCPUTopologyLock);
+    if ((topo = virHostCPUTopologyGetLocked(cpu))) {
+        *core = topo->core;
+        ret = 0;
+    }
+    virMutexUnlock(&virHostCPUTopologyLock);
+
+    return ret;
+}
+
+
+virBitmap *
+virHostCPUGetSiblingsList(unsigned int cpu)
+{
+    virHostCPUTopology *topo;
+    virBitmap *ret = NULL;
+
+    virMutexLock(&virHostCPUTopologyLock);
+    if ((topo = virHostCPUTopologyGetLocked(cpu)))
+        ret = virBitmapNewCopy(topo->siblings);
+    virMutexUnlock(&virHostCPUTopologyLock);
+
+    return ret;
+}
+
 static unsigned long
 virHostCPUCountThreadSiblings(unsigned int cpu)
 {
@@ -848,6 +1036,182 @@ virHostCPUGetStatsLinux(FILE *procstat,
 }
 
 
+/**
+ * virHostCPUReadStatsLinux:
+ * @procstat: opened /proc/stat
+ * @stats: filled with the parsed statistics
+ * @nstats: filled with the number of items in @stats
+ *
+ * Parse statistics of all CPUs in a single pass over @procstat. The
+ * first item of @stats holds the aggregate of all CPUs, CPU 'n' is
+ * at index 'n + 1'. Items of CPUs missing in @procstat (e.g. offline
+ * ones) have @present set to false.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virHostCPUReadStatsLinux(FILE *procstat,
+                         virHostCPUStatsLinux **stats,
+                         size_t *nstats)
+{
+    g_autofree virHostCPUStatsLinux *ret = NULL;
+    size_t nret = 1;
+    char line[1024];
+
+    ret = g_new0(virHostCPUStatsLinux, nret);
+
+    while (fgets(line, sizeof(line), procstat) != NULL) {
+        unsigned long long usr, ni, sys, idle, iowait;
+        unsigned long long irq = 0, softirq = 0;
+        unsigned long long steal, guest, guest_nice;
+        virHostCPUStatsLinux *stat;
+        unsigned int cpu;
+        char *tmp;
+
+        if (!(tmp = STRSKIP(line, "cpu")))
+            continue;
+
+        if (*tmp == ' ') {
+            stat = &ret[0];
+        } else if (virStrToLong_ui(tmp, &tmp, 10, &cpu) == 0 && *tmp == ' ') {
+            if (cpu + 1 >= nret)
+                VIR_EXPAND_N(ret, nret, cpu + 2 - nret);
+            stat = &ret[cpu + 1];
+        } else {
+            continue;
+        }
+
+        if (sscanf(tmp,
+                   "%llu %llu %llu %llu %llu" /* user ~ iowait */
+                   "%llu %llu %llu %llu %llu", /* irq  ~ guest_nice */
+                   &usr, &ni, &sys, &idle, &iowait,
+                   &irq, &softirq, &steal, &guest, &guest_nice) < 4)
+            continue;
+
+        stat->present = true;
+        stat->kernel = (sys + irq + softirq) * TICK_TO_NSEC;
+        stat->user = (usr + ni) * TICK_TO_NSEC;
+        stat->idle = idle * TICK_TO_NSEC;
+        stat->iowait = iowait * TICK_TO_NSEC;
+    }
+
+    *stats = g_steal_pointer(&ret);
+    *nstats = nret;
+    return 0;
+}
+
+
+/**
+ * virHostCPUFillStatsLinux:
+ * @stats: statistics as returned by virHostCPUReadStatsLinux
+ * @nstats: number of items in @stats
+ * @cpuNum: number of the CPU or VIR_NODE_CPU_STATS_ALL_CPUS
+ * @params: array of statistics to fill
+ * @nparams: size of @params
+ *
+ * Same as virHostCPUGetStatsLinux, only using already parsed @stats.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virHostCPUFillStatsLinux(virHostCPUStatsLinux *stats,
+                         size_t nstats,
+                         int cpuNum,
+                         virNodeCPUStatsPtr params,
+                         int *nparams)
+{
+    virHostCPUStatsLinux *stat = NULL;
+
+    if ((*nparams) == 0) {
+        /* Current number of cpu stats supported by linux */
+        *nparams = LINUX_NB_CPU_STATS;
+        return 0;
+    }
+
+    if ((*nparams) != LINUX_NB_CPU_STATS) {
+        virReportInvalidArg(*nparams,
+                            _("nparams in %s must be equal to %d"),
+                            __FUNCTION__, LINUX_NB_CPU_STATS);
+        return -1;
+    }
+
+    if (cpuNum == VIR_NODE_CPU_STATS_ALL_CPUS)
+        stat = &stats[0];
+    else if (cpuNum >= 0 && cpuNum + 1 < nstats)
+        stat = &stats[cpuNum + 1];
+
+    if (!stat || !stat->present) {
+        virReportInvalidArg(cpuNum,
+                            _("Invalid cpuNum in %s"),
+                            __FUNCTION__);
+        return -1;
+    }
+
+    if (virHostCPUStatsAssign(&params[0], VIR_NODE_CPU_STATS_KERNEL,
+                              stat->kernel) < 0 ||
+        virHostCPUStatsAssign(&params[1], VIR_NODE_CPU_STATS_USER,
+                              stat->user) < 0 ||
+        virHostCPUStatsAssign(&params[2], VIR_NODE_CPU_STATS_IDLE,
+                              stat->idle) < 0 ||
+        virHostCPUStatsAssign(&params[3], VIR_NODE_CPU_STATS_IOWAIT,
+                              stat->iowait) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+/*
+ * Statistics in /proc/stat are accounted in clock ticks. Parse the file
+ * at most once per tick and serve all CPUs from the result, so that
+ * callers iterating over all host CPUs don't reparse it for each one.
+ */
+static int
+virHostCPUGetStatsCached(int cpuNum,
+                         virNodeCPUStatsPtr params,
+                         int *nparams)
+{
+    gint64 now = g_get_monotonic_time();
+    gint64 tick = 1000 * 1000 / sysconf(_SC_CLK_TCK);
+    int ret = -1;
+
+    if ((*nparams) == 0)
+        return virHostCPUFillStatsLinux(NULL, 0, cpuNum, params, nparams);
+
+    virMutexLock(&virHostCPUStatsLock);
+
+    if (!virHostCPUStatsCache || now - virHostCPUStatsCacheTime >= tick) {
+        FILE *procstat = fopen(PROCSTAT_PATH, "r");
+        virHostCPUStatsLinux *stats = NULL;
+        size_t nstats = 0;
+
+        if (!procstat) {
+            virReportSystemError(errno,
+                                 _("cannot open %s"), PROCSTAT_PATH);
+            goto cleanup;
+        }
+
+        ret = virHostCPUReadStatsLinux(procstat, &stats, &nstats);
+        VIR_FORCE_FCLOSE(procstat);
+        if (ret < 0)
+            goto cleanup;
+
+        g_free(virHostCPUStatsCache);
+        virHostCPUStatsCache = stats;
+        virHostCPUStatsCacheLen = nstats;
+        virHostCPUStatsCacheTime = now;
+    }
+
+    ret = virHostCPUFillStatsLinux(virHostCPUStatsCache,
+                                   virHostCPUStatsCacheLen,
+                                   cpuNum, params, nparams);
+
+ cleanup:
+    virMutexUnlock(&virHostCPUStatsLock);
+    return ret;
+}
+
+
 /* Determine the number of CPUs (maximum CPU id + 1) present in
  * the host. */
 static int
@@ -980,19 +1344,7 @@ virHostCPUGetStats(int cpuNum G_GNUC_UNUSED,
     virCheckFlags(0, -1);
 
 #ifdef __linux__
-    {
-        int ret;
-        FILE *procstat = fopen(PROCSTAT_PATH, "r");
-        if (!procstat) {
-            virReportSystemError(errno,
-                                 _("cannot open %s"), PROCSTAT_PATH);
-            return -1;
-        }
-        ret = virHostCPUGetStatsLinux(procstat, cpuNum, params, nparams);
-        VIR_FORCE_FCLOSE(procstat);
-
-        return ret;
-    }
+    return virHostCPUGetStatsCached(cpuNum, params, nparams);
 #elif defined(__FreeBSD__)
     return virHostCPUGetStatsFreeBSD(cpuNum, params, nparams);
 #else
@@ -70,6 +70,8 @@ int virHostCPUGetDie(unsigned int cpu, unsigned int *die);
 int virHostCPUGetCore(unsigned int cpu, unsigned int *core);
 
 virBitmap *virHostCPUGetSiblingsList(unsigned int cpu);
+
+void virHostCPUTopologyCacheClear(void);
 #endif
 
 int virHostCPUGetOnline(unsigned int cpu, bool *online);
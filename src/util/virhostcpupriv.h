@@ -41,6 +41,26 @@ int virHostCPUGetStatsLinux(FILE *procstat,
                             int cpuNum,
                             virNodeCPUStatsPtr params,
                             int *nparams);
+
+typedef struct _virHostCPUStatsLinux virHostCPUStatsLinux;
+struct _virHostCPUStatsLinux {
+    bool present;
+    /* All in nanoseconds */
+    unsigned long long kernel;
+    unsigned long long user;
+    unsigned long long idle;
+    unsigned long long iowait;
+};
+
+int virHostCPUReadStatsLinux(FILE *procstat,
+                             virHostCPUStatsLinux **stats,
+                             size_t *nstats);
+
+int virHostCPUFillStatsLinux(virHostCPUStatsLinux *stats,
+                             size_t nstats,
+                             int cpuNum,
+                             virNodeCPUStatsPtr params,
+                             int *nparams);
 #endif
 
 int virHostCPUReadSignature(virArch arch,
@@ -39,8 +39,6 @@
 
 VIR_LOG_INIT("util.lockspace");
 
-#define VIR_LOCKSPACE_TABLE_SIZE 10
-
 typedef struct _virLockSpaceResource virLockSpaceResource;
 struct _virLockSpaceResource {
     char *name;
@@ -50,6 +48,7 @@ struct _virLockSpaceResource {
     unsigned int flags;
     size_t nOwners;
     pid_t *owners;
+    gint64 acquired; /* monotonic time the lock was taken at */
 };
 
 struct _virLockSpace {
@@ -57,9 +56,63 @@ struct _virLockSpace {
     virMutex lock;
 
     GHashTable *resources;
+
+    /* Index of resources held by each owner: maps owner PID to a
+     * table of resource names whose values count how many times the
+     * owner holds the resource. */
+    GHashTable *owners;
+
+    /* Statistics */
+    unsigned long long nacquired;
+    unsigned long long nbusy;
+    unsigned long long nreleased;
+    unsigned long long holdTime;
+    unsigned long long holdTimeMax;
 };
 
 
+/* Must be called with @lockspace locked */
+static void
+virLockSpaceOwnerAddResource(virLockSpace *lockspace,
+                             pid_t owner,
+                             const char *resname)
+{
+    GHashTable *held;
+    size_t count;
+
+    if (!(held = g_hash_table_lookup(lockspace->owners, GINT_TO_POINTER(owner)))) {
+        held = virHashNew(NULL);
+        g_hash_table_insert(lockspace->owners, GINT_TO_POINTER(owner), held);
+    }
+
+    count = GPOINTER_TO_SIZE(virHashLookup(held, resname));
+    g_hash_table_insert(held, g_strdup(resname), GSIZE_TO_POINTER(count + 1));
+}
+
+
+/* Must be called with @lockspace locked */
+static void
+virLockSpaceOwnerRemoveResource(virLockSpace *lockspace,
+                                pid_t owner,
+                                const char *resname)
+{
+    GHashTable *held;
+    size_t count;
+
+    if (!(held = g_hash_table_lookup(lockspace->owners, GINT_TO_POINTER(owner))))
+        return;
+
+    count = GPOINTER_TO_SIZE(virHashLookup(held, resname));
+    if (count > 1)
+        g_hash_table_insert(held, g_strdup(resname), GSIZE_TO_POINTER(count - 1));
+    else
+        g_hash_table_remove(held, resname);
+
+    if (g_hash_table_size(held) == 0)
+        g_hash_table_remove(lockspace->owners, GINT_TO_POINTER(owner));
+}
+
+
 static char *virLockSpaceGetResourcePath(virLockSpace *lockspace,
                                          const char *resname)
 {
@@ -211,6 +264,7 @@ virLockSpaceResourceNew(virLockSpace *lockspace,
         }
     }
     res->lockHeld = true;
+    res->acquired = g_get_monotonic_time();
 
     VIR_EXPAND_N(res->owners, res->nOwners, 1);
     res->owners[res->nOwners-1] = owner;
@@ -230,13 +284,10 @@ static void virLockSpaceResourceDataFree(void *opaque)
 }
 
 
-virLockSpace *virLockSpaceNew(const char *directory)
+static virLockSpace *
+virLockSpaceAlloc(void)
 {
-    virLockSpace *lockspace;
-
-    VIR_DEBUG("directory=%s", NULLSTR(directory));
-
-    lockspace = g_new0(virLockSpace, 1);
+    virLockSpace *lockspace = g_new0(virLockSpace, 1);
 
     if (virMutexInit(&lockspace->lock) < 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
@@ -245,9 +296,24 @@ virLockSpace *virLockSpaceNew(const char *directory)
         return NULL;
     }
 
-    lockspace->dir = g_strdup(directory);
-
     lockspace->resources = virHashNew(virLockSpaceResourceDataFree);
+    lockspace->owners = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                              NULL, (GDestroyNotify)g_hash_table_unref);
+
+    return lockspace;
+}
+
+
+virLockSpace *virLockSpaceNew(const char *directory)
+{
+    virLockSpace *lockspace;
+
+    VIR_DEBUG("directory=%s", NULLSTR(directory));
+
+    if (!(lockspace = virLockSpaceAlloc()))
+        return NULL;
+
+    lockspace->dir = g_strdup(directory);
 
     if (directory) {
         if (virFileExists(directory)) {
@@ -284,16 +350,8 @@ virLockSpace *virLockSpaceNewPostExecRestart(virJSONValue *object)
 
     VIR_DEBUG("object=%p", object);
 
-    lockspace = g_new0(virLockSpace, 1);
-
-    if (virMutexInit(&lockspace->lock) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Unable to initialize lockspace mutex"));
-        VIR_FREE(lockspace);
+    if (!(lockspace = virLockSpaceAlloc()))
         return NULL;
-    }
-
-    lockspace->resources = virHashNew(virLockSpaceResourceDataFree);
 
     if (virJSONValueObjectHasKey(object, "directory")) {
         const char *dir = virJSONValueObjectGetString(object, "directory");
@@ -394,10 +452,16 @@ virLockSpace *virLockSpaceNewPostExecRestart(virJSONValue *object)
             res->owners[j] = (pid_t)owner;
         }
 
+        /* Hold times start from the restart */
+        res->acquired = g_get_monotonic_time();
+
         if (virHashAddEntry(lockspace->resources, res->name, res) < 0) {
             virLockSpaceResourceFree(res);
             goto error;
         }
+
+        for (j = 0; j < res->nOwners; j++)
+            virLockSpaceOwnerAddResource(lockspace, res->owners[j], res->name);
     }
 
     return lockspace;
@@ -408,6 +472,43 @@ virLockSpace *virLockSpaceNewPostExecRestart(virJSONValue *object)
 }
 
 
+static int
+virLockSpaceResourcePreExecRestart(virLockSpaceResource *res,
+                                   virJSONValue *resources)
+{
+    g_autoptr(virJSONValue) child = virJSONValueNewObject();
+    g_autoptr(virJSONValue) owners = virJSONValueNewArray();
+    size_t i;
+
+    if (virJSONValueObjectAppendString(child, "name", res->name) < 0 ||
+        virJSONValueObjectAppendString(child, "path", res->path) < 0 ||
+        virJSONValueObjectAppendNumberInt(child, "fd", res->fd) < 0 ||
+        virJSONValueObjectAppendBoolean(child, "lockHeld", res->lockHeld) < 0 ||
+        virJSONValueObjectAppendNumberUint(child, "flags", res->flags) < 0)
+        return -1;
+
+    if (virSetInherit(res->fd, true) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Cannot disable close-on-exec flag"));
+        return -1;
+    }
+
+    for (i = 0; i < res->nOwners; i++) {
+        g_autoptr(virJSONValue) owner = virJSONValueNewNumberUlong(res->owners[i]);
+        if (!owner)
+            return -1;
+
+        if (virJSONValueArrayAppend(owners, &owner) < 0)
+            return -1;
+    }
+
+    if (virJSONValueObjectAppend(child, "owners", &owners) < 0)
+        return -1;
+
+    return virJSONValueArrayAppend(resources, &child);
+}
+
+
 virJSONValue *virLockSpacePreExecRestart(virLockSpace *lockspace)
 {
     g_autoptr(virJSONValue) object = virJSONValueNewObject();
@@ -421,40 +522,10 @@ virJSONValue *virLockSpacePreExecRestart(virLockSpace *lockspace)
         virJSONValueObjectAppendString(object, "directory", lockspace->dir) < 0)
         goto error;
 
-
     tmp = pairs = virHashGetItems(lockspace->resources, NULL, false);
     while (tmp && tmp->value) {
-        virLockSpaceResource *res = (virLockSpaceResource *)tmp->value;
-        g_autoptr(virJSONValue) child = virJSONValueNewObject();
-        g_autoptr(virJSONValue) owners = virJSONValueNewArray();
-        size_t i;
-
-        if (virJSONValueObjectAppendString(child, "name", res->name) < 0 ||
-            virJSONValueObjectAppendString(child, "path", res->path) < 0 ||
-            virJSONValueObjectAppendNumberInt(child, "fd", res->fd) < 0 ||
-            virJSONValueObjectAppendBoolean(child, "lockHeld", res->lockHeld) < 0 ||
-            virJSONValueObjectAppendNumberUint(child, "flags", res->flags) < 0)
-            goto error;
-
-        if (virSetInherit(res->fd, true) < 0) {
-            virReportSystemError(errno, "%s",
-                                 _("Cannot disable close-on-exec flag"));
-            goto error;
-        }
-
-        for (i = 0; i < res->nOwners; i++) {
-            g_autoptr(virJSONValue) owner = virJSONValueNewNumberUlong(res->owners[i]);
-            if (!owner)
-                goto error;
-
-            if (virJSONValueArrayAppend(owners, &owner) < 0)
-                goto error;
-        }
-
-        if (virJSONValueObjectAppend(child, "owners", &owners) < 0)
-            goto error;
-
-        if (virJSONValueArrayAppend(resources, &child) < 0)
+        if (virLockSpaceResourcePreExecRestart((virLockSpaceResource *)tmp->value,
+                                               resources) < 0)
             goto error;
 
         tmp++;
@@ -478,8 +549,9 @@ void virLockSpaceFree(virLockSpace *lockspace)
         return;
 
     virHashFree(lockspace->resources);
-    g_free(lockspace->dir);
+    g_hash_table_unref(lockspace->owners);
     virMutexDestroy(&lockspace->lock);
+    g_free(lockspace->dir);
     g_free(lockspace);
 }
 
@@ -557,22 +629,15 @@ int virLockSpaceDeleteResource(virLockSpace *lockspace,
 }
 
 
-int virLockSpaceAcquireResource(virLockSpace *lockspace,
-                                const char *resname,
-                                pid_t owner,
-                                unsigned int flags)
+/* Must be called with @lockspace locked */
+static int
+virLockSpaceAcquireResourceLocked(virLockSpace *lockspace,
+                                  const char *resname,
+                                  pid_t owner,
+                                  unsigned int flags)
 {
-    int ret = -1;
     virLockSpaceResource *res;
 
-    VIR_DEBUG("lockspace=%p resname=%s flags=0x%x owner=%lld",
-              lockspace, resname, flags, (unsigned long long)owner);
-
-    virCheckFlags(VIR_LOCK_SPACE_ACQUIRE_SHARED |
-                  VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE, -1);
-
-    virMutexLock(&lockspace->lock);
-
     if ((res = virHashLookup(lockspace->resources, resname))) {
         if ((res->flags & VIR_LOCK_SPACE_ACQUIRE_SHARED) &&
             (flags & VIR_LOCK_SPACE_ACQUIRE_SHARED)) {
@@ -585,44 +650,56 @@ int virLockSpaceAcquireResource(virLockSpace *lockspace,
         virReportError(VIR_ERR_RESOURCE_BUSY,
                        _("Lockspace resource '%s' is locked"),
                        resname);
-        goto cleanup;
+        lockspace->nbusy++;
+        return -1;
     }
 
-    if (!(res = virLockSpaceResourceNew(lockspace, resname, flags, owner)))
-        goto cleanup;
+    if (!(res = virLockSpaceResourceNew(lockspace, resname, flags, owner))) {
+        if (virGetLastErrorCode() == VIR_ERR_RESOURCE_BUSY)
+            lockspace->nbusy++;
+        return -1;
+    }
 
     if (virHashAddEntry(lockspace->resources, resname, res) < 0) {
         virLockSpaceResourceFree(res);
-        goto cleanup;
+        return -1;
     }
 
  done:
-    ret = 0;
+    lockspace->nacquired++;
+    virLockSpaceOwnerAddResource(lockspace, owner, resname);
+    return 0;
+}
 
- cleanup:
-    virMutexUnlock(&lockspace->lock);
-    return ret;
+
+/* Must be called with @lockspace locked */
+static void
+virLockSpaceResourceRemoved(virLockSpace *lockspace,
+                            virLockSpaceResource *res)
+{
+    unsigned long long held = g_get_monotonic_time() - res->acquired;
+
+    lockspace->nreleased++;
+    lockspace->holdTime += held;
+    if (held > lockspace->holdTimeMax)
+        lockspace->holdTimeMax = held;
 }
 
 
-int virLockSpaceReleaseResource(virLockSpace *lockspace,
-                                const char *resname,
-                                pid_t owner)
+/* Must be called with @lockspace locked */
+static int
+virLockSpaceReleaseResourceLocked(virLockSpace *lockspace,
+                                  const char *resname,
+                                  pid_t owner)
 {
-    int ret = -1;
     virLockSpaceResource *res;
     size_t i;
 
-    VIR_DEBUG("lockspace=%p resname=%s owner=%lld",
-              lockspace, resname, (unsigned long long)owner);
-
-    virMutexLock(&lockspace->lock);
-
     if (!(res = virHashLookup(lockspace->resources, resname))) {
         virReportError(VIR_ERR_RESOURCE_BUSY,
                        _("Lockspace resource '%s' is not locked"),
                        resname);
-        goto cleanup;
+        return -1;
     }
 
     for (i = 0; i < res->nOwners; i++) {
@@ -634,85 +711,229 @@ int virLockSpaceReleaseResource(virLockSpace *lockspace,
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("owner %lld does not hold the resource lock"),
                        (unsigned long long)owner);
-        goto cleanup;
+        return -1;
     }
 
     VIR_DELETE_ELEMENT(res->owners, i, res->nOwners);
 
-    if ((res->nOwners == 0) &&
-        virHashRemoveEntry(lockspace->resources, resname) < 0)
-        goto cleanup;
+    if (res->nOwners == 0) {
+        virLockSpaceResourceRemoved(lockspace, res);
+        if (virHashRemoveEntry(lockspace->resources, resname) < 0)
+            return -1;
+    }
 
-    ret = 0;
+    /* Done last, @resname may point into the owner index */
+    virLockSpaceOwnerRemoveResource(lockspace, owner, resname);
 
- cleanup:
+    return 0;
+}
+
+
+int virLockSpaceAcquireResource(virLockSpace *lockspace,
+                                const char *resname,
+                                pid_t owner,
+                                unsigned int flags)
+{
+    int ret;
+
+    VIR_DEBUG("lockspace=%p resname=%s flags=0x%x owner=%lld",
+              lockspace, resname, flags, (unsigned long long)owner);
+
+    virCheckFlags(VIR_LOCK_SPACE_ACQUIRE_SHARED |
+                  VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE, -1);
+
+    virMutexLock(&lockspace->lock);
+    ret = virLockSpaceAcquireResourceLocked(lockspace, resname, owner, flags);
     virMutexUnlock(&lockspace->lock);
+
     return ret;
 }
 
 
-struct virLockSpaceRemoveData {
-    pid_t owner;
-    size_t count;
+typedef struct _virLockSpaceBatchItem virLockSpaceBatchItem;
+struct _virLockSpaceBatchItem {
+    const char *name;
+    unsigned int flags;
 };
 
 
 static int
-virLockSpaceRemoveResourcesForOwner(const void *payload,
-                                    const char *name G_GNUC_UNUSED,
-                                    const void *opaque)
+virLockSpaceBatchItemCompare(const void *a,
+                             const void *b)
+{
+    const virLockSpaceBatchItem *ia = a;
+    const virLockSpaceBatchItem *ib = b;
+
+    return strcmp(ia->name, ib->name);
+}
+
+
+/**
+ * virLockSpaceAcquireResources:
+ * @lockspace: lockspace object
+ * @nres: number of resources
+ * @resnames: names of the resources to acquire
+ * @flags: virLockSpaceAcquireFlags for each of @resnames
+ * @owner: PID of the owner
+ *
+ * Acquires all of @resnames on behalf of @owner, or none of them.
+ * Resources are always locked in the order of their names so that
+ * two callers acquiring overlapping sets can't deadlock. A lock held
+ * by somebody else is never waited for, the whole batch fails with
+ * VIR_ERR_RESOURCE_BUSY instead.
+ *
+ * Returns: 0 on success,
+ *         -1 otherwise.
+ */
+int virLockSpaceAcquireResources(virLockSpace *lockspace,
+                                 size_t nres,
+                                 const char **resnames,
+                                 const unsigned int *flags,
+                                 pid_t owner)
 {
-    virLockSpaceResource *res = (virLockSpaceResource *)payload;
-    struct virLockSpaceRemoveData *data = (struct virLockSpaceRemoveData *)opaque;
+    g_autofree virLockSpaceBatchItem *items = NULL;
     size_t i;
+    int ret = -1;
 
-    VIR_DEBUG("res %s owner %lld", res->name, (unsigned long long)data->owner);
+    VIR_DEBUG("lockspace=%p nres=%zu owner=%lld",
+              lockspace, nres, (unsigned long long)owner);
+
+    items = g_new0(virLockSpaceBatchItem, nres);
+    for (i = 0; i < nres; i++) {
+        if (flags[i] & ~(VIR_LOCK_SPACE_ACQUIRE_SHARED |
+                         VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE)) {
+            virReportError(VIR_ERR_INVALID_ARG,
+                           _("unsupported flags (0x%x) for resource '%s'"),
+                           flags[i], resnames[i]);
+            return -1;
+        }
 
-    for (i = 0; i < res->nOwners; i++) {
-        if (res->owners[i] == data->owner)
-            break;
+        items[i].name = resnames[i];
+        items[i].flags = flags[i];
     }
 
-    if (i == res->nOwners)
-        return 0;
+    qsort(items, nres, sizeof(*items), virLockSpaceBatchItemCompare);
 
-    data->count++;
+    virMutexLock(&lockspace->lock);
 
-    VIR_DELETE_ELEMENT(res->owners, i, res->nOwners);
+    for (i = 0; i < nres; i++) {
+        if (virLockSpaceAcquireResourceLocked(lockspace, items[i].name,
+                                              owner, items[i].flags) < 0)
+            break;
+    }
 
-    if (res->nOwners) {
-        VIR_DEBUG("Other shared owners remain");
-        return 0;
+    if (i == nres) {
+        ret = 0;
+    } else {
+        virErrorPtr origerr;
+
+        virErrorPreserveLast(&origerr);
+        while (i-- > 0)
+            virLockSpaceReleaseResourceLocked(lockspace, items[i].name, owner);
+        virErrorRestore(&origerr);
     }
 
-    VIR_DEBUG("No more owners, remove it");
-    return 1;
+    virMutexUnlock(&lockspace->lock);
+    return ret;
+}
+
+
+int virLockSpaceReleaseResource(virLockSpace *lockspace,
+                                const char *resname,
+                                pid_t owner)
+{
+    int ret;
+
+    VIR_DEBUG("lockspace=%p resname=%s owner=%lld",
+              lockspace, resname, (unsigned long long)owner);
+
+    virMutexLock(&lockspace->lock);
+    ret = virLockSpaceReleaseResourceLocked(lockspace, resname, owner);
+    virMutexUnlock(&lockspace->lock);
+
+    return ret;
 }
 
 
+/**
+ * virLockSpaceReleaseResourcesForOwner:
+ * @lockspace: lockspace object
+ * @owner: PID of the owner
+ *
+ * Releases all resources held by @owner. Only the resources recorded
+ * in the owner index are visited, not the whole lockspace.
+ *
+ * Returns: the number of released resources,
+ *          -1 on error.
+ */
 int virLockSpaceReleaseResourcesForOwner(virLockSpace *lockspace,
                                          pid_t owner)
 {
-    int ret = 0;
-    struct virLockSpaceRemoveData data = {
-        owner, 0
-    };
+    GHashTable *held;
+    g_autofree virHashKeyValuePair *pairs = NULL;
+    g_auto(GStrv) names = NULL;
+    g_autofree size_t *counts = NULL;
+    size_t nnames;
+    size_t i;
+    int ret = -1;
 
     VIR_DEBUG("lockspace=%p owner=%lld", lockspace, (unsigned long long)owner);
 
     virMutexLock(&lockspace->lock);
 
-    if (virHashRemoveSet(lockspace->resources,
-                         virLockSpaceRemoveResourcesForOwner,
-                         &data) < 0)
-        goto error;
+    if (!(held = g_hash_table_lookup(lockspace->owners, GINT_TO_POINTER(owner)))) {
+        ret = 0;
+        goto cleanup;
+    }
 
-    ret = data.count;
+    /* @held is updated, and its keys freed, by the release itself,
+     * so work on a copy */
+    nnames = virHashSize(held);
+    names = g_new0(char *, nnames + 1);
+    counts = g_new0(size_t, nnames);
+    pairs = virHashGetItems(held, NULL, false);
+    for (i = 0; i < nnames; i++) {
+        names[i] = g_strdup(pairs[i].key);
+        counts[i] = GPOINTER_TO_SIZE(pairs[i].value);
+    }
+
+    for (i = 0; i < nnames; i++) {
+        VIR_DEBUG("res %s owner %lld", names[i], (unsigned long long)owner);
 
+        while (counts[i]-- > 0) {
+            if (virLockSpaceReleaseResourceLocked(lockspace, names[i], owner) < 0)
+                goto cleanup;
+        }
+    }
+
+    ret = nnames;
+
+ cleanup:
     virMutexUnlock(&lockspace->lock);
     return ret;
+}
 
- error:
+
+/**
+ * virLockSpaceGetStats:
+ * @lockspace: lockspace object
+ * @stats: filled with the statistics
+ *
+ * Collects statistics of @lockspace. Hold times are in microseconds
+ * and only count resources which were released already.
+ */
+void virLockSpaceGetStats(virLockSpace *lockspace,
+                          virLockSpaceStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    virMutexLock(&lockspace->lock);
+    stats->resources = virHashSize(lockspace->resources);
+    stats->owners = g_hash_table_size(lockspace->owners);
+    stats->acquired = lockspace->nacquired;
+    stats->busy = lockspace->nbusy;
+    stats->released = lockspace->nreleased;
+    stats->holdTime = lockspace->holdTime;
+    stats->holdTimeMax = lockspace->holdTimeMax;
     virMutexUnlock(&lockspace->lock);
-    return -1;
 }
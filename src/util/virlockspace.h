@@ -50,9 +50,29 @@ int virLockSpaceAcquireResource(virLockSpace *lockspace,
                                 pid_t owner,
                                 unsigned int flags);
 
+int virLockSpaceAcquireResources(virLockSpace *lockspace,
+                                 size_t nres,
+                                 const char **resnames,
+                                 const unsigned int *flags,
+                                 pid_t owner);
+
 int virLockSpaceReleaseResource(virLockSpace *lockspace,
                                 const char *resname,
                                 pid_t owner);
 
 int virLockSpaceReleaseResourcesForOwner(virLockSpace *lockspace,
                                          pid_t owner);
+
+typedef struct _virLockSpaceStats virLockSpaceStats;
+struct _virLockSpaceStats {
+    size_t resources; /* currently locked resources */
+    size_t owners; /* owners holding at least one resource */
+    unsigned long long acquired; /* successful acquisitions */
+    unsigned long long busy; /* acquisitions refused as busy */
+    unsigned long long released; /* resources no longer locked */
+    unsigned long long holdTime; /* total hold time in microseconds */
+    unsigned long long holdTimeMax; /* longest hold time in microseconds */
+};
+
+void virLockSpaceGetStats(virLockSpace *lockspace,
+                          virLockSpaceStats *stats);
@@ -33,6 +33,7 @@
 #include "virerror.h"
 #include "viralloc.h"
 #include "virsocket.h"
+#include "virfile.h"
 
 #define VIR_FROM_THIS VIR_FROM_NET
 
@@ -43,6 +44,8 @@ VIR_LOG_INIT("util.netlink");
 #if defined(WITH_LIBNL)
 
 # include <linux/veth.h>
+# include <linux/genetlink.h>
+# include <linux/taskstats.h>
 
 # define NETLINK_MSG_NEST_START(msg, container, attrtype) \
 do { \
@@ -800,6 +803,226 @@ virNetlinkGetErrorCode(struct nlmsghdr *resp, unsigned int recvbuflen)
 }
 
 
+/*
+ * Send @nl_msg over an already connected generic netlink socket and
+ * receive the reply. Unlike virNetlinkCommand() this allows issuing
+ * many requests over a single socket.
+ */
+static int
+virNetlinkGenericTalk(virNetlinkHandle *nlhandle,
+                      struct nl_msg *nl_msg,
+                      struct nlmsghdr **resp)
+{
+    struct sockaddr_nl nladdr;
+    g_autofree struct nlmsghdr *temp_resp = NULL;
+    int len;
+
+    if (nl_send_auto_complete(nlhandle, nl_msg) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot send to netlink socket"));
+        return -1;
+    }
+
+    len = nl_recv(nlhandle, &nladdr, (unsigned char **)&temp_resp, NULL);
+    if (len <= 0) {
+        virReportSystemError(len < 0 ? errno : EIO, "%s",
+                             _("nl_recv failed"));
+        return -1;
+    }
+
+    if (len < NLMSG_LENGTH(GENL_HDRLEN) || temp_resp->nlmsg_len > len)
+        goto malformed_resp;
+
+    if (temp_resp->nlmsg_type == NLMSG_ERROR) {
+        struct nlmsgerr *err = (struct nlmsgerr *) NLMSG_DATA(temp_resp);
+
+        if (temp_resp->nlmsg_len < NLMSG_LENGTH(sizeof(*err)))
+            goto malformed_resp;
+
+        virReportSystemError(-err->error, "%s", _("netlink error"));
+        return -1;
+    }
+
+    *resp = g_steal_pointer(&temp_resp);
+    return 0;
+
+ malformed_resp:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("malformed netlink response message"));
+    return -1;
+}
+
+
+static int
+virNetlinkGenericGetFamily(virNetlinkHandle *nlhandle,
+                           const char *name,
+                           uint16_t *family)
+{
+    struct genlmsghdr genlhdr = {
+        .cmd = CTRL_CMD_GETFAMILY,
+        .version = 1,
+    };
+    g_autoptr(virNetlinkMsg) nl_msg = NULL;
+    g_autofree struct nlmsghdr *resp = NULL;
+    struct nlattr *tb[CTRL_ATTR_MAX + 1] = { NULL };
+
+    nl_msg = virNetlinkMsgNew(GENL_ID_CTRL, NLM_F_REQUEST);
+
+    NETLINK_MSG_APPEND(nl_msg, sizeof(genlhdr), &genlhdr);
+    NETLINK_MSG_PUT(nl_msg, CTRL_ATTR_FAMILY_NAME, strlen(name) + 1, name);
+
+    if (virNetlinkGenericTalk(nlhandle, nl_msg, &resp) < 0)
+        return -1;
+
+    if (nlmsg_parse(resp, GENL_HDRLEN, tb, CTRL_ATTR_MAX, NULL) < 0 ||
+        !tb[CTRL_ATTR_FAMILY_ID]) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("malformed reply when resolving netlink family '%s'"),
+                       name);
+        return -1;
+    }
+
+    *family = nla_get_u16(tb[CTRL_ATTR_FAMILY_ID]);
+    return 0;
+}
+
+
+static int
+virNetlinkTaskStatsQuery(virNetlinkHandle *nlhandle,
+                         uint16_t family,
+                         pid_t tid,
+                         virNetlinkTaskStats *stats)
+{
+    struct genlmsghdr genlhdr = {
+        .cmd = TASKSTATS_CMD_GET,
+        .version = TASKSTATS_GENL_VERSION,
+    };
+    uint32_t pid = tid;
+    g_autoptr(virNetlinkMsg) nl_msg = NULL;
+    g_autofree struct nlmsghdr *resp = NULL;
+    struct nlattr *tb[TASKSTATS_TYPE_MAX + 1] = { NULL };
+    struct nlattr *aggr[TASKSTATS_TYPE_MAX + 1] = { NULL };
+    struct taskstats ts;
+
+    nl_msg = virNetlinkMsgNew(family, NLM_F_REQUEST);
+
+    NETLINK_MSG_APPEND(nl_msg, sizeof(genlhdr), &genlhdr);
+    NETLINK_MSG_PUT(nl_msg, TASKSTATS_CMD_ATTR_PID, sizeof(pid), &pid);
+
+    if (virNetlinkGenericTalk(nlhandle, nl_msg, &resp) < 0)
+        return -1;
+
+    if (nlmsg_parse(resp, GENL_HDRLEN, tb, TASKSTATS_TYPE_MAX, NULL) < 0 ||
+        !tb[TASKSTATS_TYPE_AGGR_PID] ||
+        nla_parse_nested(aggr, TASKSTATS_TYPE_MAX,
+                         tb[TASKSTATS_TYPE_AGGR_PID], NULL) < 0 ||
+        !aggr[TASKSTATS_TYPE_STATS]) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("malformed taskstats reply for thread %lld"),
+                       (long long) tid);
+        return -1;
+    }
+
+    /* Older kernels send a shorter structure, newer ones may append
+     * fields we don't know about */
+    memset(&ts, 0, sizeof(ts));
+    memcpy(&ts, nla_data(aggr[TASKSTATS_TYPE_STATS]),
+           MIN(nla_len(aggr[TASKSTATS_TYPE_STATS]), sizeof(ts)));
+
+    stats->cpuTime = (ts.ac_utime + ts.ac_stime) * 1000ULL;
+    stats->cpuDelay = ts.cpu_delay_total;
+
+    return 0;
+}
+
+
+/* Family ID of TASKSTATS, 0 if not resolved yet */
+static int taskstatsFamily;
+/* Set once we've found out that TASKSTATS can't be used, either because
+ * the kernel lacks it or because we're not allowed to query it */
+static int taskstatsUnsupported;
+
+
+static bool
+virNetlinkTaskStatsIsUnsupported(void)
+{
+    return virLastErrorIsSystemErrno(ENOENT) ||
+           virLastErrorIsSystemErrno(EPERM) ||
+           virLastErrorIsSystemErrno(EACCES) ||
+           virLastErrorIsSystemErrno(EPROTONOSUPPORT);
+}
+
+/**
+ * virNetlinkGetTaskStats:
+ * @tids: array of thread IDs to query
+ * @ntids: number of items in @tids
+ * @stats: array of @ntids items to fill
+ *
+ * Fetch the CPU accounting data of all the threads in @tids through the
+ * TASKSTATS generic netlink family. All the queries are issued over a
+ * single netlink socket which makes this considerably cheaper than
+ * parsing several procfs files for each thread.
+ *
+ * Delay accounting may be disabled at runtime (kernel.task_delayacct)
+ * in which case @hasDelay of each item is set to false and the
+ * caller is expected to get the delay elsewhere.
+ *
+ * Once TASKSTATS turn out to be missing or not permitted, all subsequent
+ * calls fail right away with VIR_ERR_OPERATION_UNSUPPORTED.
+ *
+ * Returns 0 on success, -1 on error (with error reported).
+ */
+int
+virNetlinkGetTaskStats(const pid_t *tids,
+                       size_t ntids,
+                       virNetlinkTaskStats *stats)
+{
+    g_autoptr(virNetlinkHandle) nlhandle = NULL;
+    uint16_t family = g_atomic_int_get(&taskstatsFamily);
+    bool hasDelay = true;
+    int delayacct;
+    size_t i;
+
+    if (g_atomic_int_get(&taskstatsUnsupported)) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                       _("taskstats are not available"));
+        return -1;
+    }
+
+    if (!(nlhandle = virNetlinkCreateSocket(NETLINK_GENERIC)))
+        goto error;
+
+    if (family == 0) {
+        if (virNetlinkGenericGetFamily(nlhandle, TASKSTATS_GENL_NAME,
+                                       &family) < 0)
+            goto error;
+        g_atomic_int_set(&taskstatsFamily, family);
+    }
+
+    /* The sysctl exists since kernel 5.14, older kernels have delay
+     * accounting enabled unless booted with 'nodelayacct' */
+    if (virFileReadValueInt(&delayacct, "/proc/sys/kernel/task_delayacct") == 0 &&
+        delayacct == 0)
+        hasDelay = false;
+
+    for (i = 0; i < ntids; i++) {
+        if (virNetlinkTaskStatsQuery(nlhandle, family, tids[i], &stats[i]) < 0)
+            goto error;
+
+        stats[i].hasDelay = hasDelay;
+    }
+
+    return 0;
+
+ error:
+    if (virNetlinkTaskStatsIsUnsupported()) {
+        VIR_DEBUG("Not using taskstats anymore: %s", virGetLastErrorMessage());
+        g_atomic_int_set(&taskstatsUnsupported, 1);
+    }
+    return -1;
+}
+
+
 static void
 virNetlinkEventServerLock(virNetlinkEventSrvPrivate *driver)
 {
@@ -1397,4 +1620,14 @@ virNetlinkGetErrorCode(struct nlmsghdr *resp G_GNUC_UNUSED,
     return -EINVAL;
 }
 
+
+int
+virNetlinkGetTaskStats(const pid_t *tids G_GNUC_UNUSED,
+                       size_t ntids G_GNUC_UNUSED,
+                       virNetlinkTaskStats *stats G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s", _(unsupported));
+    return -1;
+}
+
 #endif /* WITH_LIBNL */
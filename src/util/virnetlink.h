@@ -78,6 +78,17 @@ int virNetlinkDelLink(const char *ifname, virNetlinkTalkFallback fallback);
 
 int virNetlinkGetErrorCode(struct nlmsghdr *resp, unsigned int recvbuflen);
 
+typedef struct _virNetlinkTaskStats virNetlinkTaskStats;
+struct _virNetlinkTaskStats {
+    unsigned long long cpuTime;  /* user + system time in nanoseconds */
+    unsigned long long cpuDelay; /* time spent waiting on a runqueue in ns */
+    bool hasDelay;               /* false if delay accounting is disabled */
+};
+
+int virNetlinkGetTaskStats(const pid_t *tids,
+                           size_t ntids,
+                           virNetlinkTaskStats *stats);
+
 int virNetlinkDumpLink(const char *ifname, int ifindex,
                        void **nlData, struct nlattr **tb,
                        uint32_t src_pid, uint32_t dst_pid)
@@ -76,7 +76,21 @@ virNumaGetAutoPlacementAdvice(unsigned short vcpus,
 
     return output;
 }
+
+
+bool
+virNumaHasAutoPlacementAdvisor(void)
+{
+    return virFileIsExecutable(NUMAD);
+}
 #else /* !WITH_NUMAD */
+bool
+virNumaHasAutoPlacementAdvisor(void)
+{
+    return false;
+}
+
+
 char *
 virNumaGetAutoPlacementAdvice(unsigned short vcpus G_GNUC_UNUSED,
                               unsigned long long balloon G_GNUC_UNUSED)
@@ -1033,3 +1047,182 @@ virNumaGetHostMemoryNodeset(void)
 
     return nodeset;
 }
+
+
+typedef struct _virNumaPlacementNode virNumaPlacementNode;
+struct _virNumaPlacementNode {
+    bool usable;
+    unsigned long long memfree; /* in KiB */
+    unsigned int ncpus;
+    unsigned int load;
+};
+
+
+/* Returns true if @a is a better candidate to host @vcpus than @b */
+static bool
+virNumaPlacementNodeIsBetter(virNumaPlacementNode *a,
+                             virNumaPlacementNode *b,
+                             unsigned int vcpus)
+{
+    /* Compare the ratios of vCPUs to host CPUs after the placement */
+    unsigned long long ratioA = (a->load + vcpus) * (unsigned long long) b->ncpus;
+    unsigned long long ratioB = (b->load + vcpus) * (unsigned long long) a->ncpus;
+
+    if (ratioA != ratioB)
+        return ratioA < ratioB;
+
+    return a->memfree > b->memfree;
+}
+
+
+/**
+ * virNumaGetBuiltinPlacementAdvice:
+ * @vcpus: number of vCPUs of the guest
+ * @memory: size of the guest memory in KiB
+ * @pagesize: size of the pages backing guest memory in KiB, 0 for default
+ * @nodeLoad: number of vCPUs already placed onto each node, may be NULL
+ * @nnodeLoad: size of @nodeLoad
+ *
+ * Compute the set of host NUMA nodes a guest should be placed onto
+ * without the help of numad. The least loaded node which has enough
+ * free memory and CPUs for the whole guest is preferred. If there's no
+ * such node, the node with the most free memory is extended with its
+ * nearest neighbours until the guest fits.
+ *
+ * Returns the advised nodeset, or NULL on error.
+ */
+virBitmap *
+virNumaGetBuiltinPlacementAdvice(unsigned int vcpus,
+                                 unsigned long long memory,
+                                 unsigned int pagesize,
+                                 const unsigned int *nodeLoad,
+                                 size_t nnodeLoad)
+{
+    unsigned int systemPageSize = virGetSystemPageSizeKB();
+    g_autofree virNumaPlacementNode *nodes = NULL;
+    g_autofree int *distances = NULL;
+    g_autoptr(virBitmap) nodeset = NULL;
+    unsigned long long memfree = 0;
+    unsigned int ncpus = 0;
+    int ndistances = 0;
+    int maxnode;
+    int seed = -1;
+    size_t i;
+
+    if ((maxnode = virNumaGetMaxNode()) < 0)
+        return NULL;
+
+    if (pagesize == 0)
+        pagesize = systemPageSize;
+
+    nodes = g_new0(virNumaPlacementNode, maxnode + 1);
+    nodeset = virBitmapNew(maxnode + 1);
+
+    for (i = 0; i <= maxnode; i++) {
+        virNumaPlacementNode *node = &nodes[i];
+        g_autoptr(virBitmap) cpus = NULL;
+        unsigned long long nodeFree = 0;
+        unsigned long long pagesFree = 0;
+        int rc;
+
+        if (!virNumaNodeIsAvailable(i))
+            continue;
+
+        if ((rc = virNumaGetNodeCPUs(i, &cpus)) == -1)
+            return NULL;
+
+        node->ncpus = MAX(rc, 0);
+
+        if (pagesize == systemPageSize) {
+            if (virNumaGetNodeMemory(i, NULL, &nodeFree) < 0) {
+                virReportError(VIR_ERR_INTERNAL_ERROR,
+                               _("Unable to get free memory of NUMA node %zu"),
+                               i);
+                return NULL;
+            }
+            node->memfree = nodeFree / 1024;
+        } else {
+            if (virNumaGetPageInfo(i, pagesize, 0, NULL, &pagesFree) < 0)
+                return NULL;
+            node->memfree = pagesFree * pagesize;
+        }
+
+        if (i < nnodeLoad)
+            node->load = nodeLoad[i];
+
+        node->usable = node->ncpus > 0 && node->memfree > 0;
+
+        VIR_DEBUG("node=%zu cpus=%u free=%llu KiB load=%u",
+                  i, node->ncpus, node->memfree, node->load);
+    }
+
+    /* Look for the best node able to host the whole guest */
+    for (i = 0; i <= maxnode; i++) {
+        virNumaPlacementNode *node = &nodes[i];
+
+        if (!node->usable ||
+            node->memfree < memory ||
+            node->ncpus < vcpus)
+            continue;
+
+        if (seed < 0 ||
+            virNumaPlacementNodeIsBetter(node, &nodes[seed], vcpus))
+            seed = i;
+    }
+
+    if (seed >= 0) {
+        ignore_value(virBitmapSetBit(nodeset, seed));
+        return g_steal_pointer(&nodeset);
+    }
+
+    /* Otherwise start with the node with the most free memory ... */
+    for (i = 0; i <= maxnode; i++) {
+        if (nodes[i].usable &&
+            (seed < 0 || nodes[i].memfree > nodes[seed].memfree))
+            seed = i;
+    }
+
+    if (seed < 0) {
+        virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                       _("No usable host NUMA node found"));
+        return NULL;
+    }
+
+    if (virNumaGetDistances(seed, &distances, &ndistances) < 0)
+        return NULL;
+
+    /* ... and add its closest neighbours until the guest fits */
+    while (seed >= 0) {
+        int next = -1;
+
+        ignore_value(virBitmapSetBit(nodeset, seed));
+        memfree += nodes[seed].memfree;
+        ncpus += nodes[seed].ncpus;
+        nodes[seed].usable = false;
+
+        if (memfree >= memory && ncpus >= vcpus)
+            break;
+
+        for (i = 0; i <= maxnode; i++) {
+            int dist = i < ndistances ? distances[i] : 0;
+            int nextDist;
+
+            if (!nodes[i].usable)
+                continue;
+
+            if (next < 0) {
+                next = i;
+                continue;
+            }
+
+            nextDist = next < ndistances ? distances[next] : 0;
+            if (dist < nextDist ||
+                (dist == nextDist && nodes[i].memfree > nodes[next].memfree))
+                next = i;
+        }
+
+        seed = next;
+    }
+
+    return g_steal_pointer(&nodeset);
+}
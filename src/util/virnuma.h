@@ -27,6 +27,12 @@
 
 char *virNumaGetAutoPlacementAdvice(unsigned short vcpus,
                                     unsigned long long balloon);
+bool virNumaHasAutoPlacementAdvisor(void);
+virBitmap *virNumaGetBuiltinPlacementAdvice(unsigned int vcpus,
+                                            unsigned long long memory,
+                                            unsigned int pagesize,
+                                            const unsigned int *nodeLoad,
+                                            size_t nnodeLoad);
 
 int virNumaSetupMemoryPolicy(virDomainNumatuneMemMode mode,
                              virBitmap *nodeset);
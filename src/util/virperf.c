@@ -54,6 +54,8 @@ VIR_ENUM_IMPL(virPerfEvent,
 struct virPerfEvent {
     int fd;
     bool enabled;
+    bool grouped;  /* member of the group led by virPerf.groupFd */
+    uint64_t id;   /* kernel assigned ID, used to match group reads */
     union {
         /* cmt */
         struct {
@@ -64,6 +66,11 @@ struct virPerfEvent {
 
 struct _virPerf {
     struct virPerfEvent events[VIR_PERF_EVENT_LAST];
+
+    /* Leader of the group of generic hardware and software events which
+     * allows fetching all their counts with a single read() */
+    int groupFd;
+    size_t ngrouped;
 };
 
 #if defined(__linux__) && defined(WITH_SYS_SYSCALL_H)
@@ -200,12 +207,132 @@ virPerfRdtAttrInit(void)
 }
 
 
+static void
+virPerfEventClose(virPerf *perf,
+                  virPerfEventType type)
+{
+    struct virPerfEvent *event = &perf->events[type];
+
+    VIR_FORCE_CLOSE(event->fd);
+
+    if (event->grouped) {
+        event->grouped = false;
+        event->id = 0;
+        if (--perf->ngrouped == 0)
+            VIR_FORCE_CLOSE(perf->groupFd);
+    }
+}
+
+
+/* Layout of a read() of an event opened with VIR_PERF_READ_FORMAT */
+struct virPerfEventValue {
+    uint64_t value;
+    uint64_t timeEnabled;
+    uint64_t timeRunning;
+};
+
+/* Layout of a read() of the group leader */
+struct virPerfGroupValues {
+    uint64_t nr;
+    uint64_t timeEnabled;
+    uint64_t timeRunning;
+    struct {
+        uint64_t value;
+        uint64_t id;
+    } counts[VIR_PERF_EVENT_LAST + 1];
+};
+
+# define VIR_PERF_READ_FORMAT \
+    (PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING)
+
+# define VIR_PERF_GROUP_READ_FORMAT \
+    (VIR_PERF_READ_FORMAT | PERF_FORMAT_GROUP | PERF_FORMAT_ID)
+
+
+static int
+virPerfEventOpen(virPerfEventType type,
+                 pid_t pid,
+                 int groupFd,
+                 uint64_t readFormat)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.inherit = 1;
+    attr.disabled = 1;
+    attr.enable_on_exec = 0;
+    attr.read_format = readFormat;
+
+    if (type == VIR_PERF_EVENT_LAST) {
+        /* The group leader, it doesn't count anything by itself */
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_DUMMY;
+        attr.disabled = 0;
+    } else {
+        attr.type = attrs[type].attrType;
+        attr.config = attrs[type].attrConfig;
+    }
+
+    return syscall(__NR_perf_event_open, &attr, pid, -1, groupFd, 0);
+}
+
+
+/*
+ * Try to add the event to the group of @perf, creating the group if
+ * needed. The kernel refuses members which can't be scheduled along
+ * with the rest of the group (e.g. when running out of hardware
+ * counters) in which case the event is opened on its own.
+ */
+static int
+virPerfEventOpenGrouped(virPerf *perf,
+                        virPerfEventType type,
+                        pid_t pid)
+{
+    struct virPerfEvent *event = &perf->events[type];
+    int fd;
+
+    if (attrs[type].attrType != PERF_TYPE_HARDWARE &&
+        attrs[type].attrType != PERF_TYPE_SOFTWARE)
+        return -1;
+
+    if (perf->groupFd < 0 &&
+        (perf->groupFd = virPerfEventOpen(VIR_PERF_EVENT_LAST, pid, -1,
+                                          VIR_PERF_GROUP_READ_FORMAT)) < 0) {
+        VIR_DEBUG("Unable to create perf event group: %s", g_strerror(errno));
+        return -1;
+    }
+
+    if ((fd = virPerfEventOpen(type, pid, perf->groupFd,
+                               VIR_PERF_GROUP_READ_FORMAT)) < 0) {
+        VIR_DEBUG("Unable to add perf event %s to group: %s",
+                  virPerfEventTypeToString(type), g_strerror(errno));
+        goto error;
+    }
+
+    if (ioctl(fd, PERF_EVENT_IOC_ID, &event->id) < 0) {
+        VIR_DEBUG("Unable to get ID of perf event %s: %s",
+                  virPerfEventTypeToString(type), g_strerror(errno));
+        VIR_FORCE_CLOSE(fd);
+        goto error;
+    }
+
+    event->grouped = true;
+    perf->ngrouped++;
+    return fd;
+
+ error:
+    if (perf->ngrouped == 0)
+        VIR_FORCE_CLOSE(perf->groupFd);
+    return -1;
+}
+
+
 int
 virPerfEventEnable(virPerf *perf,
                    virPerfEventType type,
                    pid_t pid)
 {
-    struct perf_event_attr attr;
     struct virPerfEvent *event = &(perf->events[type]);
     struct virPerfEventAttr *event_attr = &attrs[type];
 
@@ -235,15 +362,9 @@ virPerfEventEnable(virPerf *perf,
         }
     }
 
-    memset(&attr, 0, sizeof(attr));
-    attr.size = sizeof(attr);
-    attr.inherit = 1;
-    attr.disabled = 1;
-    attr.enable_on_exec = 0;
-    attr.type = event_attr->attrType;
-    attr.config = event_attr->attrConfig;
+    if ((event->fd = virPerfEventOpenGrouped(perf, type, pid)) < 0)
+        event->fd = virPerfEventOpen(type, pid, -1, VIR_PERF_READ_FORMAT);
 
-    event->fd = syscall(__NR_perf_event_open, &attr, pid, -1, -1, 0);
     if (event->fd < 0) {
         virReportSystemError(errno,
                              _("unable to open host cpu perf event for %s"),
@@ -262,7 +383,7 @@ virPerfEventEnable(virPerf *perf,
     return 0;
 
  error:
-    VIR_FORCE_CLOSE(event->fd);
+    virPerfEventClose(perf, type);
     return -1;
 }
 
@@ -283,7 +404,7 @@ virPerfEventDisable(virPerf *perf,
     }
 
     event->enabled = false;
-    VIR_FORCE_CLOSE(event->fd);
+    virPerfEventClose(perf, type);
     return 0;
 }
 
@@ -293,6 +414,78 @@ bool virPerfEventIsEnabled(virPerf *perf,
     return perf && perf->events[type].enabled;
 }
 
+
+/*
+ * Extrapolate the count of an event which was multiplexed with other
+ * events and thus counted only for a part of the time it was enabled.
+ */
+static uint64_t
+virPerfEventScale(uint64_t value,
+                  uint64_t timeEnabled,
+                  uint64_t timeRunning)
+{
+    if (timeRunning == 0)
+        return 0;
+
+    if (timeRunning >= timeEnabled)
+        return value;
+
+    return (double) value * timeEnabled / timeRunning;
+}
+
+
+static int
+virPerfReadGroup(virPerf *perf,
+                 uint64_t *values)
+{
+    struct virPerfGroupValues group;
+    size_t i;
+    size_t j;
+
+    if (read(perf->groupFd, &group, sizeof(group)) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to read perf event group"));
+        return -1;
+    }
+
+    for (i = 0; i < group.nr && i < G_N_ELEMENTS(group.counts); i++) {
+        for (j = 0; j < VIR_PERF_EVENT_LAST; j++) {
+            struct virPerfEvent *event = &perf->events[j];
+
+            if (!event->enabled || !event->grouped ||
+                event->id != group.counts[i].id)
+                continue;
+
+            values[j] = virPerfEventScale(group.counts[i].value,
+                                          group.timeEnabled,
+                                          group.timeRunning);
+            break;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+virPerfReadOne(virPerf *perf,
+               virPerfEventType type,
+               uint64_t *value)
+{
+    struct virPerfEvent *event = &perf->events[type];
+    struct virPerfEventValue val;
+
+    if (saferead(event->fd, &val, sizeof(val)) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to read cache data"));
+        return -1;
+    }
+
+    *value = virPerfEventScale(val.value, val.timeEnabled, val.timeRunning);
+    return 0;
+}
+
+
 int
 virPerfReadEvent(virPerf *perf,
                  virPerfEventType type,
@@ -302,9 +495,14 @@ virPerfReadEvent(virPerf *perf,
     if (!event->enabled)
         return -1;
 
-    if (saferead(event->fd, value, sizeof(uint64_t)) < 0) {
-        virReportSystemError(errno, "%s",
-                             _("Unable to read cache data"));
+    if (event->grouped) {
+        uint64_t values[VIR_PERF_EVENT_LAST] = { 0 };
+
+        if (virPerfReadGroup(perf, values) < 0)
+            return -1;
+
+        *value = values[type];
+    } else if (virPerfReadOne(perf, type, value) < 0) {
         return -1;
     }
 
@@ -314,6 +512,46 @@ virPerfReadEvent(virPerf *perf,
     return 0;
 }
 
+
+/**
+ * virPerfReadEvents:
+ * @perf: perf events
+ * @values: array of VIR_PERF_EVENT_LAST items to fill
+ *
+ * Read the counts of all the enabled events. All grouped events are
+ * read at once with a single read() of the group leader. Counts of
+ * events which were multiplexed with others are scaled to the time the
+ * events were enabled. Items of disabled events are left untouched.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virPerfReadEvents(virPerf *perf,
+                  uint64_t *values)
+{
+    size_t i;
+
+    if (perf->ngrouped > 0 &&
+        virPerfReadGroup(perf, values) < 0)
+        return -1;
+
+    for (i = 0; i < VIR_PERF_EVENT_LAST; i++) {
+        struct virPerfEvent *event = &perf->events[i];
+
+        if (!event->enabled)
+            continue;
+
+        if (!event->grouped &&
+            virPerfReadOne(perf, i, &values[i]) < 0)
+            return -1;
+
+        if (i == VIR_PERF_EVENT_CMT)
+            values[i] *= event->efields.cmt.scale;
+    }
+
+    return 0;
+}
+
 #else
 static int
 virPerfRdtAttrInit(void)
@@ -358,6 +596,15 @@ virPerfReadEvent(virPerf *perf G_GNUC_UNUSED,
     return -1;
 }
 
+int
+virPerfReadEvents(virPerf *perf G_GNUC_UNUSED,
+                  uint64_t *values G_GNUC_UNUSED)
+{
+    virReportSystemError(ENXIO, "%s",
+                         _("Perf not supported on this platform"));
+    return -1;
+}
+
 #endif
 
 virPerf *
@@ -367,6 +614,7 @@ virPerfNew(void)
     virPerf *perf;
 
     perf = g_new0(virPerf, 1);
+    perf->groupFd = -1;
 
     for (i = 0; i < VIR_PERF_EVENT_LAST; i++) {
         perf->events[i].fd = -1;
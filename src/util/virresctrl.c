@@ -342,6 +342,27 @@ struct _virResctrlAlloc {
     char *path;
 };
 
+/*
+ * virResctrlMonitorDataNode caches a node directory found under
+ * 'mon_data' of a monitor, e.g. 'mon_L3_00', together with the
+ * descriptors of the resource utilization files read from it so far.
+ */
+typedef struct _virResctrlMonitorDataFile virResctrlMonitorDataFile;
+struct _virResctrlMonitorDataFile {
+    char *resource;
+    int fd;
+};
+
+typedef struct _virResctrlMonitorDataNode virResctrlMonitorDataNode;
+struct _virResctrlMonitorDataNode {
+    unsigned int id;
+    char *name;
+    int dirfd;
+
+    virResctrlMonitorDataFile *files;
+    size_t nfiles;
+};
+
 /*
  * virResctrlMonitor is the data structure for resctrl monitor. Resctrl
  * monitor represents a resctrl monitoring group, which can be used to
@@ -364,6 +385,13 @@ struct _virResctrlMonitor {
     /* libvirt-generated path in /sys/fs/resctrl for this particular
      * monitor */
     char *path;
+
+    /* Layout of 'mon_data' of @path, sorted by node id. The directories
+     * are the same for the whole lifetime of the monitoring group so
+     * they are looked up only once, @nodesLoaded tells if it was done. */
+    virResctrlMonitorDataNode *nodes;
+    size_t nnodes;
+    bool nodesLoaded;
 };
 
 
@@ -416,11 +444,36 @@ virResctrlAllocDispose(void *obj)
 }
 
 
+static void
+virResctrlMonitorDataNodesClear(virResctrlMonitor *monitor)
+{
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < monitor->nnodes; i++) {
+        virResctrlMonitorDataNode *node = &monitor->nodes[i];
+
+        for (j = 0; j < node->nfiles; j++) {
+            VIR_FORCE_CLOSE(node->files[j].fd);
+            g_free(node->files[j].resource);
+        }
+        g_free(node->files);
+        g_free(node->name);
+        VIR_FORCE_CLOSE(node->dirfd);
+    }
+
+    g_clear_pointer(&monitor->nodes, g_free);
+    monitor->nnodes = 0;
+    monitor->nodesLoaded = false;
+}
+
+
 static void
 virResctrlMonitorDispose(void *obj)
 {
     virResctrlMonitor *monitor = obj;
 
+    virResctrlMonitorDataNodesClear(monitor);
     virObjectUnref(monitor->alloc);
     g_free(monitor->id);
     g_free(monitor->path);
@@ -2525,6 +2578,8 @@ virResctrlMonitorRemove(virResctrlMonitor *monitor)
     if (!monitor->path)
         return 0;
 
+    virResctrlMonitorDataNodesClear(monitor);
+
     if (STREQ(monitor->path, monitor->alloc->path))
         return 0;
 
@@ -2539,57 +2594,30 @@ virResctrlMonitorRemove(virResctrlMonitor *monitor)
 
 
 static int
-virResctrlMonitorStatsSorter(const void *a,
-                             const void *b)
+virResctrlMonitorDataNodeSorter(const void *a,
+                                const void *b)
 {
-    return (*(virResctrlMonitorStats **)a)->id
-        - (*(virResctrlMonitorStats **)b)->id;
+    return ((const virResctrlMonitorDataNode *)a)->id
+        - ((const virResctrlMonitorDataNode *)b)->id;
 }
 
 
-/*
- * virResctrlMonitorGetStats
- *
- * @monitor: The monitor that the statistic data will be retrieved from.
- * @resources: A string list for the monitor feature names.
- * @stats: Pointer of of virResctrlMonitorStats * array for holding cache or
- * memory bandwidth usage data.
- * @nstats: A size_t pointer to hold the returned array length of @stats
- *
- * Get cache or memory bandwidth utilization information.
- *
- * Returns 0 on success, -1 on error.
- */
-int
-virResctrlMonitorGetStats(virResctrlMonitor *monitor,
-                          const char **resources,
-                          virResctrlMonitorStats ***stats,
-                          size_t *nstats)
+static int
+virResctrlMonitorDataNodesLoad(virResctrlMonitor *monitor)
 {
-    int rv = -1;
-    int ret = -1;
-    size_t i = 0;
-    unsigned long long val = 0;
     g_autoptr(DIR) dirp = NULL;
     g_autofree char *datapath = NULL;
     struct dirent *ent = NULL;
-    virResctrlMonitorStats *stat = NULL;
-    size_t nresources = g_strv_length((char **) resources);
-
-    if (!monitor) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Invalid resctrl monitor"));
-        return -1;
-    }
+    int rc;
 
     datapath = g_strdup_printf("%s/mon_data", monitor->path);
 
     if (virDirOpen(&dirp, datapath) < 0)
-        goto cleanup;
+        return -1;
 
-    *nstats = 0;
-    while (virDirRead(dirp, &ent, datapath) > 0) {
+    while ((rc = virDirRead(dirp, &ent, datapath)) > 0) {
         g_autofree char *filepath = NULL;
+        virResctrlMonitorDataNode node = { .dirfd = -1 };
         char *node_id = NULL;
 
         /* Looking for directory that contains resource utilization
@@ -2616,36 +2644,163 @@ virResctrlMonitorGetStats(virResctrlMonitor *monitor,
         if (!(node_id = STRSKIP(node_id, "_")))
             continue;
 
-        stat = g_new0(virResctrlMonitorStats, 1);
-        stat->features = g_new0(char *, nresources + 1);
-
         /* The node ID number should be here, parsing it. */
-        if (virStrToLong_uip(node_id, NULL, 0, &stat->id) < 0)
-            goto cleanup;
+        if (virStrToLong_uip(node_id, NULL, 0, &node.id) < 0)
+            goto error;
+
+        if ((node.dirfd = open(filepath,
+                               O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+            virReportSystemError(errno, _("Unable to open '%s'"), filepath);
+            goto error;
+        }
+
+        node.name = g_strdup(ent->d_name);
+
+        VIR_APPEND_ELEMENT(monitor->nodes, monitor->nnodes, node);
+    }
+
+    if (rc < 0)
+        goto error;
+
+    /* Sort in id's ascending order */
+    if (monitor->nnodes)
+        qsort(monitor->nodes, monitor->nnodes, sizeof(*monitor->nodes),
+              virResctrlMonitorDataNodeSorter);
+
+    monitor->nodesLoaded = true;
+    return 0;
+
+ error:
+    virResctrlMonitorDataNodesClear(monitor);
+    return -1;
+}
+
+
+static int
+virResctrlMonitorDataNodeRead(virResctrlMonitor *monitor,
+                              virResctrlMonitorDataNode *node,
+                              const char *resource,
+                              unsigned long long *value)
+{
+    virResctrlMonitorDataFile *file = NULL;
+    char buf[VIR_INT64_STR_BUFLEN];
+    ssize_t len;
+    size_t i;
+
+    for (i = 0; i < node->nfiles; i++) {
+        if (STREQ(node->files[i].resource, resource)) {
+            file = &node->files[i];
+            break;
+        }
+    }
+
+    if (!file) {
+        virResctrlMonitorDataFile newfile = { .fd = -1 };
 
-        for (i = 0; resources[i]; i++) {
-            rv = virFileReadValueUllong(&val, "%s/%s/%s", datapath,
-                                        ent->d_name, resources[i]);
-            if (rv == -2) {
+        if ((newfile.fd = openat(node->dirfd, resource,
+                                 O_RDONLY | O_CLOEXEC)) < 0) {
+            if (errno == ENOENT) {
                 virReportError(VIR_ERR_INTERNAL_ERROR,
-                               _("File '%s/%s/%s' does not exist."),
-                               datapath, ent->d_name, resources[i]);
+                               _("File '%s/mon_data/%s/%s' does not exist."),
+                               monitor->path, node->name, resource);
+            } else {
+                virReportSystemError(errno,
+                                     _("Unable to open '%s/mon_data/%s/%s'"),
+                                     monitor->path, node->name, resource);
             }
-            if (rv < 0)
+            return -1;
+        }
+
+        newfile.resource = g_strdup(resource);
+        VIR_APPEND_ELEMENT(node->files, node->nfiles, newfile);
+        file = &node->files[node->nfiles - 1];
+    }
+
+    /* The counters are regenerated on every read from the beginning of
+     * the file so there's no need to reopen it. */
+    if ((len = pread(file->fd, buf, sizeof(buf) - 1, 0)) < 0) {
+        virReportSystemError(errno, _("Unable to read '%s/mon_data/%s/%s'"),
+                             monitor->path, node->name, resource);
+        return -1;
+    }
+    buf[len] = '\0';
+
+    virStringTrimOptionalNewline(buf);
+
+    if (virStrToLong_ullp(buf, NULL, 10, value) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Invalid unsigned long long value '%s' in file '%s/mon_data/%s/%s'"),
+                       buf, monitor->path, node->name, resource);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * virResctrlMonitorGetStats
+ *
+ * @monitor: The monitor that the statistic data will be retrieved from.
+ * @resources: A string list for the monitor feature names.
+ * @stats: Pointer of of virResctrlMonitorStats * array for holding cache or
+ * memory bandwidth usage data.
+ * @nstats: A size_t pointer to hold the returned array length of @stats
+ *
+ * Get cache or memory bandwidth utilization information. The layout of
+ * the monitoring group and the descriptors of the files read are cached
+ * in @monitor so that subsequent calls only read the counters.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virResctrlMonitorGetStats(virResctrlMonitor *monitor,
+                          const char **resources,
+                          virResctrlMonitorStats ***stats,
+                          size_t *nstats)
+{
+    int ret = -1;
+    size_t i = 0;
+    size_t j = 0;
+    unsigned long long val = 0;
+    virResctrlMonitorStats *stat = NULL;
+    size_t nresources = g_strv_length((char **) resources);
+
+    if (!monitor) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Invalid resctrl monitor"));
+        return -1;
+    }
+
+    if (!monitor->nodesLoaded &&
+        virResctrlMonitorDataNodesLoad(monitor) < 0)
+        return -1;
+
+    *nstats = 0;
+    for (i = 0; i < monitor->nnodes; i++) {
+        virResctrlMonitorDataNode *node = &monitor->nodes[i];
+
+        stat = g_new0(virResctrlMonitorStats, 1);
+        stat->features = g_new0(char *, nresources + 1);
+        stat->id = node->id;
+
+        for (j = 0; resources[j]; j++) {
+            if (virResctrlMonitorDataNodeRead(monitor, node,
+                                              resources[j], &val) < 0) {
+                /* The group might have been recreated behind our back,
+                 * look it up again next time. */
+                virResctrlMonitorDataNodesClear(monitor);
                 goto cleanup;
+            }
 
             VIR_APPEND_ELEMENT(stat->vals, stat->nvals, val);
 
-            stat->features[i] = g_strdup(resources[i]);
+            stat->features[j] = g_strdup(resources[j]);
         }
 
         VIR_APPEND_ELEMENT(*stats, *nstats, stat);
     }
 
-    /* Sort in id's ascending order */
-    if (*nstats)
-        qsort(*stats, *nstats, sizeof(**stats), virResctrlMonitorStatsSorter);
-
     ret = 0;
  cleanup:
     virResctrlMonitorStatsFree(stat);
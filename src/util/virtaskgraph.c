@@ -0,0 +1,319 @@
+/*
+ * virtaskgraph.c: running interdependent tasks concurrently
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "virtaskgraph.h"
+#include "viralloc.h"
+#include "virerror.h"
+#include "viridentity.h"
+#include "virlog.h"
+#include "virthread.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+VIR_LOG_INIT("util.taskgraph");
+
+typedef enum {
+    VIR_TASK_GRAPH_TASK_PENDING,
+    VIR_TASK_GRAPH_TASK_RUNNING,
+    VIR_TASK_GRAPH_TASK_DONE,
+    VIR_TASK_GRAPH_TASK_FAILED,
+} virTaskGraphTaskState;
+
+typedef struct _virTaskGraphTask virTaskGraphTask;
+struct _virTaskGraphTask {
+    char *name;
+    virTaskGraphFunc func;
+    void *opaque;
+    size_t *deps;
+    size_t ndeps;
+    virTaskGraphTaskState state;
+};
+
+struct _virTaskGraph {
+    virTaskGraphTask *tasks;
+    size_t ntasks;
+
+    /* the following are valid only while virTaskGraphRun is running */
+    virMutex lock;
+    virCond cond;
+    size_t nfinished;
+    bool failed;
+    virErrorPtr error; /* error of the first failed task */
+    virIdentity *identity; /* identity of the thread running the graph */
+};
+
+
+/**
+ * virTaskGraphNew:
+ *
+ * Creates an empty graph of tasks.
+ */
+virTaskGraph *
+virTaskGraphNew(void)
+{
+    return g_new0(virTaskGraph, 1);
+}
+
+
+void
+virTaskGraphFree(virTaskGraph *graph)
+{
+    size_t i;
+
+    if (!graph)
+        return;
+
+    for (i = 0; i < graph->ntasks; i++) {
+        g_free(graph->tasks[i].name);
+        g_free(graph->tasks[i].deps);
+    }
+
+    g_free(graph->tasks);
+    virFreeError(graph->error);
+    g_free(graph);
+}
+
+
+/**
+ * virTaskGraphAdd:
+ * @graph: graph of tasks
+ * @name: name of the task used in debug messages
+ * @func: function implementing the task
+ * @opaque: data passed to @func
+ * @deps: IDs of tasks which have to finish successfully before this one
+ * @ndeps: number of items in @deps
+ *
+ * Adds a new task to @graph. Dependencies can only refer to tasks which
+ * were added before, which makes cycles impossible.
+ *
+ * Returns the ID of the new task or -1 on error.
+ */
+ssize_t
+virTaskGraphAdd(virTaskGraph *graph,
+                const char *name,
+                virTaskGraphFunc func,
+                void *opaque,
+                const size_t *deps,
+                size_t ndeps)
+{
+    virTaskGraphTask task = { 0 };
+    size_t i;
+
+    for (i = 0; i < ndeps; i++) {
+        if (deps[i] >= graph->ntasks) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("task '%s' depends on unknown task %zu"),
+                           name, deps[i]);
+            return -1;
+        }
+    }
+
+    task.name = g_strdup(name);
+    task.func = func;
+    task.opaque = opaque;
+    task.ndeps = ndeps;
+
+    if (ndeps > 0) {
+        task.deps = g_new0(size_t, ndeps);
+        memcpy(task.deps, deps, sizeof(*deps) * ndeps);
+    }
+
+    VIR_APPEND_ELEMENT(graph->tasks, graph->ntasks, task);
+
+    return graph->ntasks - 1;
+}
+
+
+/* Returns a task ready to be run or NULL if there's none at the moment.
+ * Tasks depending on a failed task are marked as failed. Called with
+ * the graph locked. */
+static virTaskGraphTask *
+virTaskGraphPickTask(virTaskGraph *graph)
+{
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < graph->ntasks; i++) {
+        virTaskGraphTask *task = graph->tasks + i;
+        bool ready = true;
+
+        if (task->state != VIR_TASK_GRAPH_TASK_PENDING)
+            continue;
+
+        for (j = 0; j < task->ndeps && ready; j++) {
+            virTaskGraphTask *dep = graph->tasks + task->deps[j];
+
+            if (dep->state == VIR_TASK_GRAPH_TASK_FAILED) {
+                task->state = VIR_TASK_GRAPH_TASK_FAILED;
+                graph->nfinished++;
+                ready = false;
+            } else if (dep->state != VIR_TASK_GRAPH_TASK_DONE) {
+                ready = false;
+            }
+        }
+
+        if (ready)
+            return task;
+    }
+
+    return NULL;
+}
+
+
+static void
+virTaskGraphWorker(void *opaque)
+{
+    virTaskGraph *graph = opaque;
+
+    virMutexLock(&graph->lock);
+
+    while (graph->nfinished < graph->ntasks && !graph->failed) {
+        virTaskGraphTask *task;
+        int rc;
+
+        if (!(task = virTaskGraphPickTask(graph))) {
+            if (graph->nfinished < graph->ntasks &&
+                virCondWait(&graph->cond, &graph->lock) < 0) {
+                VIR_WARN("Unable to wait on task graph condition");
+                break;
+            }
+            continue;
+        }
+
+        task->state = VIR_TASK_GRAPH_TASK_RUNNING;
+        virMutexUnlock(&graph->lock);
+
+        VIR_DEBUG("Running task '%s'", task->name);
+        rc = task->func(task->opaque);
+
+        virMutexLock(&graph->lock);
+
+        if (rc < 0) {
+            VIR_DEBUG("Task '%s' failed", task->name);
+            task->state = VIR_TASK_GRAPH_TASK_FAILED;
+            if (!graph->failed)
+                virErrorPreserveLast(&graph->error);
+            graph->failed = true;
+        } else {
+            task->state = VIR_TASK_GRAPH_TASK_DONE;
+        }
+
+        graph->nfinished++;
+        virCondBroadcast(&graph->cond);
+    }
+
+    virCondBroadcast(&graph->cond);
+    virMutexUnlock(&graph->lock);
+}
+
+
+static void
+virTaskGraphWorkerThread(void *opaque)
+{
+    virTaskGraph *graph = opaque;
+
+    /* Tasks run on behalf of the caller of virTaskGraphRun */
+    virIdentitySetCurrent(graph->identity);
+
+    virTaskGraphWorker(graph);
+
+    virIdentitySetCurrent(NULL);
+}
+
+
+/**
+ * virTaskGraphRun:
+ * @graph: graph of tasks
+ * @maxWorkers: maximum number of tasks running at the same time
+ *
+ * Runs all tasks in @graph, each of them once all its dependencies
+ * finished successfully. The calling thread is used as one of the
+ * workers and the others run with its identity. Once a task fails, no
+ * new tasks are started, but the ones already running are waited for.
+ *
+ * Returns 0 if all tasks succeeded, -1 otherwise with the error of the
+ * first failed task reported.
+ */
+int
+virTaskGraphRun(virTaskGraph *graph,
+                size_t maxWorkers)
+{
+    g_autofree virThread *workers = NULL;
+    size_t nworkers = 0;
+    size_t i;
+    int ret = -1;
+
+    if (graph->ntasks == 0)
+        return 0;
+
+    if (virMutexInit(&graph->lock) < 0) {
+        virReportSystemError(errno, "%s", _("unable to init mutex"));
+        return -1;
+    }
+
+    if (virCondInit(&graph->cond) < 0) {
+        virReportSystemError(errno, "%s", _("unable to init condition"));
+        virMutexDestroy(&graph->lock);
+        return -1;
+    }
+
+    graph->nfinished = 0;
+    graph->failed = false;
+    for (i = 0; i < graph->ntasks; i++)
+        graph->tasks[i].state = VIR_TASK_GRAPH_TASK_PENDING;
+
+    maxWorkers = MIN(MAX(maxWorkers, 1), graph->ntasks);
+
+    if (maxWorkers > 1) {
+        workers = g_new0(virThread, maxWorkers - 1);
+        graph->identity = virIdentityGetCurrent();
+
+        for (nworkers = 0; nworkers < maxWorkers - 1; nworkers++) {
+            if (virThreadCreateFull(&workers[nworkers], true, virTaskGraphWorkerThread,
+                                    "task-graph", false, graph) < 0) {
+                /* the calling thread will do the work anyway */
+                VIR_WARN("Failed to create task graph worker thread");
+                virResetLastError();
+                break;
+            }
+        }
+    }
+
+    virTaskGraphWorker(graph);
+
+    for (i = 0; i < nworkers; i++)
+        virThreadJoin(&workers[i]);
+
+    g_clear_object(&graph->identity);
+
+    if (graph->failed) {
+        virErrorRestore(&graph->error);
+    } else if (graph->nfinished < graph->ntasks) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("not all tasks were run"));
+    } else {
+        ret = 0;
+    }
+
+    virCondDestroy(&graph->cond);
+    virMutexDestroy(&graph->lock);
+
+    return ret;
+}
@@ -0,0 +1,50 @@
+/*
+ * virtaskgraph.h: running interdependent tasks concurrently
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "internal.h"
+
+typedef struct _virTaskGraph virTaskGraph;
+
+/**
+ * virTaskGraphFunc:
+ * @opaque: data passed to virTaskGraphAdd
+ *
+ * Returns 0 on success, -1 on error with an error reported.
+ */
+typedef int (*virTaskGraphFunc)(void *opaque);
+
+virTaskGraph *
+virTaskGraphNew(void);
+
+void
+virTaskGraphFree(virTaskGraph *graph);
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virTaskGraph, virTaskGraphFree);
+
+ssize_t
+virTaskGraphAdd(virTaskGraph *graph,
+                const char *name,
+                virTaskGraphFunc func,
+                void *opaque,
+                const size_t *deps,
+                size_t ndeps);
+
+int
+virTaskGraphRun(virTaskGraph *graph,
+                size_t maxWorkers);
@@ -19,6 +19,8 @@
 
 #include <config.h>
 
+#include <fcntl.h>
+
 #include "testutils.h"
 #include "testutilsqemu.h"
 #include "qemumonitortestutils.h"
@@ -167,6 +169,55 @@ testQemuCapsCopy(const void *opaque)
 }
 
 
+static int
+testQemuCapsBinary(const void *opaque)
+{
+    const testQemuData *data = opaque;
+    g_autofree char *capsFile = NULL;
+    g_autofree char *binFile = NULL;
+    g_autoptr(virQEMUCaps) orig = NULL;
+    g_autoptr(virQEMUCaps) loaded = NULL;
+    g_autoptr(GByteArray) bin = NULL;
+    g_autofree char *actual = NULL;
+    virArch arch = virArchFromString(data->archName);
+    VIR_AUTOCLOSE fd = -1;
+    int ret = -1;
+
+    capsFile = g_strdup_printf("%s/%s_%s.%s.xml",
+                               data->outputDir, data->prefix, data->version,
+                               data->archName);
+    binFile = g_strdup_printf("%s/qemucapabilitiestest-%s_%s.%s.bin",
+                              abs_builddir, data->prefix, data->version,
+                              data->archName);
+
+    if (!(orig = qemuTestParseCapabilitiesArch(arch, capsFile)))
+        return -1;
+
+    bin = virQEMUCapsFormatCacheBinary(orig);
+
+    if ((fd = open(binFile, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0 ||
+        safewrite(fd, bin->data, bin->len) != bin->len) {
+        fprintf(stderr, "Failed to write '%s'\n", binFile);
+        goto cleanup;
+    }
+
+    if (!(loaded = virQEMUCapsNewBinary(virQEMUCapsGetBinary(orig))) ||
+        virQEMUCapsLoadCacheBinary(arch, loaded, binFile, true) < 0)
+        goto cleanup;
+
+    if (!(actual = virQEMUCapsFormatCache(loaded)))
+        goto cleanup;
+
+    if (virTestCompareToFile(actual, capsFile) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    unlink(binFile);
+    return ret;
+}
+
+
 static int
 doCapsTest(const char *inputDir,
            const char *prefix,
@@ -178,9 +229,11 @@ doCapsTest(const char *inputDir,
     testQemuData *data = (testQemuData *) opaque;
     g_autofree char *title = NULL;
     g_autofree char *copyTitle = NULL;
+    g_autofree char *binaryTitle = NULL;
 
     title = g_strdup_printf("%s (%s)", version, archName);
     copyTitle = g_strdup_printf("copy %s (%s)", version, archName);
+    binaryTitle = g_strdup_printf("binary %s (%s)", version, archName);
 
     data->inputDir = inputDir;
     data->prefix = prefix;
@@ -194,6 +247,9 @@ doCapsTest(const char *inputDir,
     if (virTestRun(copyTitle, testQemuCapsCopy, data) < 0)
         data->ret = -1;
 
+    if (virTestRun(binaryTitle, testQemuCapsBinary, data) < 0)
+        data->ret = -1;
+
     return 0;
 }
 
@@ -0,0 +1,445 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+
+#ifdef WITH_QEMU
+
+# include "qemu/qemu_migration.h"
+# define LIBVIRT_QEMU_MIGRATIONPRIV_H_ALLOW
+# include "qemu/qemu_migrationpriv.h"
+# include "virtypedparam.h"
+
+# define VIR_FROM_THIS VIR_FROM_QEMU
+
+# define NMIRRORS 4
+
+struct testMirrorData {
+    unsigned long long capacity;
+    unsigned long long dirtyRate;
+    bool started;
+    bool diskStarted;
+    unsigned long long total;
+    unsigned long long transferred;
+};
+
+struct testSchedData {
+    unsigned long long speed;
+    const struct testMirrorData *mirrors;
+    size_t nmirrors;
+    const size_t *order;
+    size_t norder;
+    const unsigned long long *bandwidth;
+};
+
+
+static void
+testSchedInit(const struct testSchedData *data,
+              qemuMigrationNBDScheduler *sched,
+              qemuMigrationNBDMirror *mirrors,
+              qemuDomainMirrorStats *stats,
+              qemuDomainMirrorDiskStats *disks)
+{
+    size_t i;
+
+    sched->mirrors = mirrors;
+    sched->nmirrors = data->nmirrors;
+    sched->speed = data->speed;
+
+    stats->disks = disks;
+    stats->ndisks = data->nmirrors;
+
+    for (i = 0; i < data->nmirrors; i++) {
+        mirrors[i].capacity = data->mirrors[i].capacity;
+        mirrors[i].dirtyRate = data->mirrors[i].dirtyRate;
+        mirrors[i].started = data->mirrors[i].started;
+
+        disks[i].started = data->mirrors[i].diskStarted;
+        disks[i].total = data->mirrors[i].total;
+        disks[i].transferred = data->mirrors[i].transferred;
+    }
+}
+
+
+static int
+testSchedOrder(const void *opaque)
+{
+    const struct testSchedData *data = opaque;
+    qemuMigrationNBDScheduler sched = { 0 };
+    qemuMigrationNBDMirror mirrors[NMIRRORS] = { 0 };
+    qemuDomainMirrorStats stats = { 0 };
+    qemuDomainMirrorDiskStats disks[NMIRRORS] = { 0 };
+    qemuMigrationNBDMirror *next;
+    size_t i = 0;
+
+    testSchedInit(data, &sched, mirrors, &stats, disks);
+
+    while ((next = qemuMigrationSrcNBDSchedulerNext(&sched))) {
+        size_t idx = next - mirrors;
+
+        if (i >= data->norder || data->order[i] != idx) {
+            fprintf(stderr, "mirror %zu started as number %zu\n", idx, i);
+            return -1;
+        }
+
+        next->started = true;
+        i++;
+    }
+
+    if (i != data->norder) {
+        fprintf(stderr, "only %zu of %zu mirrors started\n", i, data->norder);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testSchedSplit(const void *opaque)
+{
+    const struct testSchedData *data = opaque;
+    qemuMigrationNBDScheduler sched = { 0 };
+    qemuMigrationNBDMirror mirrors[NMIRRORS] = { 0 };
+    qemuDomainMirrorStats stats = { 0 };
+    qemuDomainMirrorDiskStats disks[NMIRRORS] = { 0 };
+    unsigned long long bandwidth[NMIRRORS] = { 0 };
+    size_t i;
+
+    testSchedInit(data, &sched, mirrors, &stats, disks);
+
+    qemuMigrationSrcNBDSchedulerSplit(&sched, &stats, bandwidth);
+
+    for (i = 0; i < data->nmirrors; i++) {
+        if (bandwidth[i] != data->bandwidth[i]) {
+            fprintf(stderr, "mirror %zu: expected bandwidth %llu, got %llu\n",
+                    i, data->bandwidth[i], bandwidth[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+testMirrorStatsParams(const void *opaque G_GNUC_UNUSED)
+{
+    qemuDomainMirrorDiskStats disks[] = {
+        { .dst = (char *) "vda", .started = true, .total = 4096,
+          .transferred = 1024, .bandwidth = 2048, .rate = 1000 },
+        { .dst = (char *) "vdb", .started = true, .ready = true,
+          .total = 100, .transferred = 100 },
+        { .dst = (char *) "vdc", .total = 512 },
+    };
+    qemuDomainMirrorStats stats = {
+        .ndisks = G_N_ELEMENTS(disks),
+        .disks = disks,
+    };
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    int maxparams = 0;
+    unsigned int count;
+    unsigned long long ull;
+    const char *str;
+    int ready;
+    int ret = -1;
+
+    if (qemuDomainMirrorStatsToParams(&stats, &params, &nparams,
+                                      &maxparams) < 0)
+        goto cleanup;
+
+# define CHECK(cond, msg) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s\n", msg); \
+            goto cleanup; \
+        } \
+    } while (0)
+
+    CHECK(nparams == 18, "unexpected number of fields");
+
+    CHECK(virTypedParamsGetUInt(params, nparams, "disk_mirror.count",
+                                &count) == 1 && count == 3,
+          "wrong mirror count");
+
+    CHECK(virTypedParamsGetString(params, nparams, "disk_mirror.0.name",
+                                  &str) == 1 && STREQ(str, "vda"),
+          "wrong name of mirror 0");
+    CHECK(virTypedParamsGetULLong(params, nparams, "disk_mirror.0.remaining",
+                                  &ull) == 1 && ull == 3072,
+          "wrong remaining data of mirror 0");
+    CHECK(virTypedParamsGetULLong(params, nparams, "disk_mirror.0.bandwidth",
+                                  &ull) == 1 && ull == 2048,
+          "wrong bandwidth of mirror 0");
+    CHECK(virTypedParamsGetBoolean(params, nparams, "disk_mirror.0.ready",
+                                   &ready) == 1 && !ready,
+          "mirror 0 reported as ready");
+    CHECK(virTypedParamsGetULLong(params, nparams, "disk_mirror.0.eta",
+                                  &ull) == 1 && ull == 3072,
+          "wrong ETA of mirror 0");
+
+    CHECK(virTypedParamsGetULLong(params, nparams, "disk_mirror.1.remaining",
+                                  &ull) == 1 && ull == 0,
+          "wrong remaining data of mirror 1");
+    CHECK(virTypedParamsGetBoolean(params, nparams, "disk_mirror.1.ready",
+                                   &ready) == 1 && ready,
+          "mirror 1 not reported as ready");
+    CHECK(virTypedParamsGetULLong(params, nparams, "disk_mirror.1.bandwidth",
+                                  &ull) == 0,
+          "unlimited bandwidth of mirror 1 reported");
+    CHECK(virTypedParamsGetULLong(params, nparams, "disk_mirror.1.eta",
+                                  &ull) == 0,
+          "ETA of a ready mirror reported");
+
+    CHECK(virTypedParamsGetULLong(params, nparams, "disk_mirror.2.remaining",
+                                  &ull) == 1 && ull == 512,
+          "wrong remaining data of mirror 2");
+    CHECK(virTypedParamsGetULLong(params, nparams, "disk_mirror.2.eta",
+                                  &ull) == 0,
+          "ETA of a mirror which was not started reported");
+
+# undef CHECK
+
+    ret = 0;
+
+ cleanup:
+    virTypedParamsFree(params, nparams);
+    return ret;
+}
+
+
+/* Each row describes the controller state, the migration statistics with
+ * 4 KiB pages, and the expected action, value, and number of stalled
+ * RAM iterations afterwards. */
+struct testConvergenceData {
+    const char *name;
+
+    bool postcopy;
+    bool autoConverge;
+    unsigned long long downtime;
+    unsigned long long maxDowntime;
+    int throttleIncrement;
+    unsigned long long iteration;
+    unsigned long long remaining;
+    unsigned long long acted;
+    unsigned int stalls;
+
+    unsigned long long ramIteration;
+    unsigned long long ramRemaining;
+    unsigned long long ramBps;
+    unsigned long long ramDirtyRate;
+
+    qemuMigrationConvergenceAction action;
+    unsigned long long value;
+    unsigned int stallsAfter;
+};
+
+# define NONE QEMU_MIGRATION_CONVERGENCE_NONE
+# define DOWNTIME QEMU_MIGRATION_CONVERGENCE_DOWNTIME
+# define POSTCOPY QEMU_MIGRATION_CONVERGENCE_POSTCOPY
+# define THROTTLE QEMU_MIGRATION_CONVERGENCE_THROTTLE
+
+/* The dirty rows send 1 MB/s with 1 MB left, i.e. 1 s of downtime, while
+ * the guest dirties 1 MB/s. In the stalled rows the third RAM iteration
+ * starts with 95 % of the memory the second one had and 9.5 s of
+ * downtime at 100 kB/s. */
+static const struct testConvergenceData convergenceTests[] = {
+    /* name                      pc ac  down  max    thr it rem    act st   iter rem     bps     dirty  action    value st */
+    { "progressing",             0, 0,  300,  2000,  10, 2, 1000000, 0, 0,  3, 500000,  1000000, 0,   NONE,     0,    0 },
+    { "first iteration",         0, 0,  300,  2000,  10, 0, 0,       0, 0,  1, 1000000, 1000000, 250, NONE,     0,    0 },
+
+    { "downtime",                0, 0,  300,  2000,  10, 2, 1000000, 0, 0,  2, 1000000, 1000000, 250, DOWNTIME, 1100, 0 },
+    { "downtime capped",         0, 0,  300,  1050,  10, 2, 1000000, 0, 0,  2, 1000000, 1000000, 250, DOWNTIME, 1050, 0 },
+    { "downtime sufficient",     0, 0,  1000, 2000,  10, 2, 1000000, 0, 0,  2, 1000000, 1000000, 250, NONE,     0,    0 },
+    { "downtime once",           0, 0,  300,  2000,  10, 2, 1000000, 2, 0,  2, 1000000, 1000000, 250, NONE,     0,    0 },
+    { "downtime from stalls",    0, 0,  300,  20000, 10, 2, 1000000, 0, 1,  3, 950000,  100000,  0,   DOWNTIME, 10450, 2 },
+
+    { "throttle",                0, 1,  300,  2000,  10, 2, 1000000, 0, 1,  3, 950000,  100000,  0,   THROTTLE, 20,   2 },
+    { "throttle capped",         0, 1,  300,  2000,  40, 2, 1000000, 0, 1,  3, 950000,  100000,  0,   THROTTLE, 50,   2 },
+    { "throttle at maximum",     0, 1,  300,  2000,  50, 2, 1000000, 0, 1,  3, 950000,  100000,  0,   NONE,     0,    2 },
+    { "throttle not allowed",    0, 0,  300,  2000,  10, 2, 1000000, 0, 1,  3, 950000,  100000,  0,   NONE,     0,    2 },
+    { "throttle one stall",      0, 1,  300,  2000,  10, 2, 1000000, 0, 0,  3, 950000,  100000,  0,   NONE,     0,    1 },
+    { "throttle progress",       0, 1,  300,  2000,  10, 2, 1000000, 0, 1,  3, 800000,  100000,  0,   NONE,     0,    0 },
+
+    { "postcopy",                1, 1,  300,  2000,  10, 2, 1000000, 0, 4,  3, 950000,  100000,  0,   POSTCOPY, 0,    5 },
+    { "postcopy too early",      1, 1,  300,  2000,  10, 2, 1000000, 0, 2,  3, 950000,  100000,  0,   THROTTLE, 20,   3 },
+};
+
+# undef NONE
+# undef DOWNTIME
+# undef POSTCOPY
+# undef THROTTLE
+
+
+static int
+testConvergence(const void *opaque)
+{
+    const struct testConvergenceData *data = opaque;
+    qemuMigrationConvergence conv = {
+        .enabled = true,
+        .postcopy = data->postcopy,
+        .autoConverge = data->autoConverge,
+        .downtime = data->downtime,
+        .maxDowntime = data->maxDowntime,
+        .throttleIncrement = data->throttleIncrement,
+        .iteration = data->iteration,
+        .remaining = data->remaining,
+        .acted = data->acted,
+        .stalls = data->stalls,
+    };
+    qemuMonitorMigrationStats stats = {
+        .ram_iteration = data->ramIteration,
+        .ram_remaining = data->ramRemaining,
+        .ram_bps = data->ramBps,
+        .ram_dirty_rate = data->ramDirtyRate,
+    };
+    qemuMigrationConvergenceAction action;
+    unsigned long long value = 0;
+
+    action = qemuMigrationSrcConvergenceDecide(&conv, &stats, 4096, &value);
+
+    if (action != data->action) {
+        fprintf(stderr, "expected action %d, got %d\n", data->action, action);
+        return -1;
+    }
+
+    if (value != data->value) {
+        fprintf(stderr, "expected value %llu, got %llu\n", data->value, value);
+        return -1;
+    }
+
+    if (conv.stalls != data->stallsAfter) {
+        fprintf(stderr, "expected %u stalls, got %u\n",
+                data->stallsAfter, conv.stalls);
+        return -1;
+    }
+
+    if (action != QEMU_MIGRATION_CONVERGENCE_NONE &&
+        conv.acted != stats.ram_iteration) {
+        fprintf(stderr, "adjustment not recorded\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    size_t i;
+
+    /* Sizes in the scheduler tests are chosen so that the weights are
+     * exact in floating point. */
+    const struct testMirrorData idle[] = {
+        { .capacity = 1024 },
+        { .capacity = 4096 },
+        { .capacity = 2048 },
+    };
+    const size_t idleOrder[] = { 1, 2, 0 };
+
+    /* Guest writes count as data to copy in the next minute. */
+    const struct testMirrorData dirty[] = {
+        { .capacity = 4096 },
+        { .capacity = 1024, .dirtyRate = 64 },
+        { .capacity = 2048 },
+        { .capacity = 2048, .started = true },
+    };
+    const size_t dirtyOrder[] = { 1, 0, 2 };
+    const unsigned long long dirtyBandwidth[] = { 0, 0, 0, 1024 };
+
+    /* Ready mirrors keep the reserve, the rest follows remaining data. */
+    const struct testMirrorData running[] = {
+        { .capacity = 4096, .started = true, .diskStarted = true,
+          .total = 4096, .transferred = 3840 },
+        { .capacity = 1024, .started = true, .dirtyRate = 768 },
+        { .capacity = 2048, .started = true, .diskStarted = true,
+          .total = 2048, .transferred = 2048 },
+        { .capacity = 8192 },
+    };
+    const size_t runningOrder[] = { 3 };
+    const unsigned long long runningBandwidth[] = { 272, 1136, 128, 0 };
+
+    /* With nothing left to copy the bandwidth is split evenly. */
+    const struct testMirrorData converged[] = {
+        { .capacity = 1024, .started = true, .diskStarted = true,
+          .total = 1024, .transferred = 1024 },
+        { .capacity = 1024, .started = true, .diskStarted = true,
+          .total = 1024, .transferred = 1024 },
+    };
+    const unsigned long long convergedBandwidth[] = { 500, 500 };
+
+    /* A limit too small to share still lets every mirror run. */
+    const unsigned long long tinyBandwidth[] = { 1, 1 };
+
+# define DO_TEST_ORDER(name, list, ord) \
+    do { \
+        struct testSchedData data = { \
+            .mirrors = list, .nmirrors = G_N_ELEMENTS(list), \
+            .order = ord, .norder = G_N_ELEMENTS(ord), \
+        }; \
+        if (virTestRun("Scheduler order " name, testSchedOrder, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+# define DO_TEST_SPLIT(name, spd, list, bw) \
+    do { \
+        struct testSchedData data = { \
+            .speed = spd, .mirrors = list, .nmirrors = G_N_ELEMENTS(list), \
+            .bandwidth = bw, \
+        }; \
+        if (virTestRun("Scheduler split " name, testSchedSplit, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_ORDER("idle", idle, idleOrder);
+    DO_TEST_ORDER("dirty", dirty, dirtyOrder);
+    DO_TEST_ORDER("running", running, runningOrder);
+
+    DO_TEST_SPLIT("dirty", 1024, dirty, dirtyBandwidth);
+    DO_TEST_SPLIT("running", 1536, running, runningBandwidth);
+    DO_TEST_SPLIT("converged", 1000, converged, convergedBandwidth);
+    DO_TEST_SPLIT("tiny", 1, converged, tinyBandwidth);
+
+    if (virTestRun("Mirror stats params", testMirrorStatsParams, NULL) < 0)
+        ret = -1;
+
+    for (i = 0; i < G_N_ELEMENTS(convergenceTests); i++) {
+        g_autofree char *name = g_strdup_printf("Convergence %s",
+                                                convergenceTests[i].name);
+
+        if (virTestRun(name, testConvergence, &convergenceTests[i]) < 0)
+            ret = -1;
+    }
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
+
+#else
+
+int
+main(void)
+{
+    return EXIT_AM_SKIP;
+}
+
+#endif /* WITH_QEMU */
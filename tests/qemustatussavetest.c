@@ -0,0 +1,246 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+
+#ifdef WITH_QEMU
+
+# include "conf/domain_conf.h"
+# include "qemu/qemu_statussave.h"
+
+# define VIR_FROM_THIS VIR_FROM_QEMU
+
+# define NVMS 2
+
+static virDomainXMLOption *xmlopt;
+
+/* Number of status writes of each domain, indexed by the first byte of
+ * its UUID. Only written by the saver thread, read after a flush. */
+static unsigned int saved[NVMS];
+
+
+static void
+testStatusSave(virDomainObj *vm)
+{
+    saved[vm->def->uuid[0]]++;
+}
+
+
+static virDomainObj *
+testStatusSaveNewVM(size_t idx)
+{
+    virDomainObj *vm;
+
+    if (!(vm = virDomainObjNew(xmlopt)))
+        return NULL;
+
+    vm->def = virDomainDefNew(xmlopt);
+    vm->def->uuid[0] = idx;
+    vm->def->id = idx + 1;
+
+    return vm;
+}
+
+
+struct testStatusSaveData {
+    virDomainObj *vms[NVMS];
+    qemuStatusSaver *saver;
+};
+
+
+static int
+testStatusSaveSetup(struct testStatusSaveData *data)
+{
+    size_t i;
+
+    memset(saved, 0, sizeof(saved));
+
+    for (i = 0; i < NVMS; i++) {
+        if (!(data->vms[i] = testStatusSaveNewVM(i)))
+            return -1;
+    }
+
+    if (!(data->saver = qemuStatusSaverNew(testStatusSave)))
+        return -1;
+
+    return 0;
+}
+
+
+static void
+testStatusSaveTeardown(struct testStatusSaveData *data)
+{
+    size_t i;
+
+    qemuStatusSaverFree(data->saver);
+
+    for (i = 0; i < NVMS; i++)
+        virObjectUnref(data->vms[i]);
+}
+
+
+static void
+testStatusSaveSchedule(qemuStatusSaver *saver,
+                       virDomainObj *vm)
+{
+    virObjectLock(vm);
+    qemuStatusSaverSchedule(saver, vm);
+    virObjectUnlock(vm);
+}
+
+
+static int
+testStatusSaveCheck(const unsigned int *expected)
+{
+    size_t i;
+
+    for (i = 0; i < NVMS; i++) {
+        if (saved[i] != expected[i]) {
+            fprintf(stderr, "domain %zu: expected %u writes, got %u\n",
+                    i, expected[i], saved[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* Repeated requests for one domain result in a single write, and each
+ * domain is written on its own. */
+static int
+testStatusSaveCoalesce(const void *opaque G_GNUC_UNUSED)
+{
+    struct testStatusSaveData data = { 0 };
+    const unsigned int expected[NVMS] = { 1, 1 };
+    size_t i;
+    int ret = -1;
+
+    if (testStatusSaveSetup(&data) < 0)
+        goto cleanup;
+
+    for (i = 0; i < 10; i++) {
+        testStatusSaveSchedule(data.saver, data.vms[0]);
+        testStatusSaveSchedule(data.saver, data.vms[1]);
+    }
+
+    qemuStatusSaverFlush(data.saver);
+
+    ret = testStatusSaveCheck(expected);
+
+ cleanup:
+    testStatusSaveTeardown(&data);
+    return ret;
+}
+
+
+/* A flush returns only once all scheduled writes were done, and
+ * requests made after a write are not lost. */
+static int
+testStatusSaveFlush(const void *opaque G_GNUC_UNUSED)
+{
+    struct testStatusSaveData data = { 0 };
+    const unsigned int first[NVMS] = { 1, 0 };
+    const unsigned int second[NVMS] = { 2, 1 };
+    const unsigned int none[NVMS] = { 0, 0 };
+    int ret = -1;
+
+    if (testStatusSaveSetup(&data) < 0)
+        goto cleanup;
+
+    qemuStatusSaverFlush(data.saver);
+    if (testStatusSaveCheck(none) < 0)
+        goto cleanup;
+
+    testStatusSaveSchedule(data.saver, data.vms[0]);
+    qemuStatusSaverFlush(data.saver);
+    if (testStatusSaveCheck(first) < 0)
+        goto cleanup;
+
+    testStatusSaveSchedule(data.saver, data.vms[0]);
+    testStatusSaveSchedule(data.saver, data.vms[1]);
+
+    /* Freeing the saver writes what is still pending. */
+    qemuStatusSaverFree(g_steal_pointer(&data.saver));
+    ret = testStatusSaveCheck(second);
+
+ cleanup:
+    testStatusSaveTeardown(&data);
+    return ret;
+}
+
+
+/* The status of domains which are not running is not written. */
+static int
+testStatusSaveInactive(const void *opaque G_GNUC_UNUSED)
+{
+    struct testStatusSaveData data = { 0 };
+    const unsigned int expected[NVMS] = { 0, 1 };
+    int ret = -1;
+
+    if (testStatusSaveSetup(&data) < 0)
+        goto cleanup;
+
+    data.vms[0]->def->id = -1;
+
+    testStatusSaveSchedule(data.saver, data.vms[0]);
+    testStatusSaveSchedule(data.saver, data.vms[1]);
+
+    qemuStatusSaverFlush(data.saver);
+
+    ret = testStatusSaveCheck(expected);
+
+ cleanup:
+    testStatusSaveTeardown(&data);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (!(xmlopt = virTestGenericDomainXMLConfInit()))
+        return EXIT_FAILURE;
+
+    if (virTestRun("Coalesce", testStatusSaveCoalesce, NULL) < 0)
+        ret = -1;
+
+    if (virTestRun("Flush", testStatusSaveFlush, NULL) < 0)
+        ret = -1;
+
+    if (virTestRun("Inactive", testStatusSaveInactive, NULL) < 0)
+        ret = -1;
+
+    virObjectUnref(xmlopt);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
+
+#else
+
+int
+main(void)
+{
+    return EXIT_AM_SKIP;
+}
+
+#endif /* WITH_QEMU */
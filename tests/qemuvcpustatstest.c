@@ -0,0 +1,186 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+
+#ifdef WITH_QEMU
+
+# include "qemu/qemu_domain.h"
+# include "virnetlink.h"
+
+# include "testutilsqemu.h"
+
+# define VIR_FROM_THIS VIR_FROM_QEMU
+
+static virQEMUDriver driver;
+
+/* Behaviour of the mocked taskstats */
+static bool taskstatsFail;
+static size_t taskstatsCalls;
+
+
+int
+virNetlinkGetTaskStats(const pid_t *tids,
+                       size_t ntids,
+                       virNetlinkTaskStats *stats)
+{
+    size_t i;
+
+    taskstatsCalls++;
+
+    if (taskstatsFail) {
+        virReportSystemError(EPERM, "%s", "netlink error");
+        return -1;
+    }
+
+    for (i = 0; i < ntids; i++) {
+        stats[i].cpuTime = tids[i] * 1000ULL;
+        stats[i].hasDelay = false;
+    }
+
+    return 0;
+}
+
+
+/* Creates a domain with three vCPUs, of which the second one is
+ * offline. The online ones run as threads 100 and 102. */
+static virDomainObj *
+testVcpuStatsNewVM(void)
+{
+    g_autoptr(virDomainObj) vm = NULL;
+    size_t i;
+
+    if (!(vm = virDomainObjNew(driver.xmlopt)))
+        return NULL;
+
+    vm->def = virDomainDefNew(driver.xmlopt);
+    vm->def->name = g_strdup("vcpustats");
+
+    if (virDomainDefSetVcpusMax(vm->def, 3, driver.xmlopt) < 0)
+        return NULL;
+
+    for (i = 0; i < 3; i++) {
+        virDomainVcpuDef *vcpu = virDomainDefGetVcpu(vm->def, i);
+
+        if (i == 1)
+            continue;
+
+        vcpu->online = true;
+        QEMU_DOMAIN_VCPU_PRIVATE(vcpu)->tid = 100 + i;
+    }
+
+    return g_steal_pointer(&vm);
+}
+
+
+/* Once taskstats were used for a domain, their failure is reported
+ * instead of switching to procfs. */
+static int
+testVcpuStatsTaskStats(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(virDomainObj) vm = NULL;
+    virNetlinkTaskStats stats[3] = { 0 };
+
+    taskstatsFail = false;
+    taskstatsCalls = 0;
+
+    if (!(vm = testVcpuStatsNewVM()))
+        return -1;
+
+    if (qemuDomainGetVcpusTaskStats(vm, stats, 3) != 1)
+        return -1;
+
+    if (stats[0].cpuTime != 100000 || stats[1].cpuTime != 102000) {
+        fprintf(stderr, "unexpected vCPU times %llu, %llu\n",
+                stats[0].cpuTime, stats[1].cpuTime);
+        return -1;
+    }
+
+    taskstatsFail = true;
+
+    if (qemuDomainGetVcpusTaskStats(vm, stats, 3) != -1) {
+        fprintf(stderr, "taskstats failure not reported\n");
+        return -1;
+    }
+    virResetLastError();
+
+    return 0;
+}
+
+
+/* A domain for which taskstats failed first keeps using procfs. */
+static int
+testVcpuStatsProcfs(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(virDomainObj) vm = NULL;
+    virNetlinkTaskStats stats[3] = { 0 };
+
+    taskstatsFail = true;
+    taskstatsCalls = 0;
+
+    if (!(vm = testVcpuStatsNewVM()))
+        return -1;
+
+    if (qemuDomainGetVcpusTaskStats(vm, stats, 3) != 0 ||
+        virGetLastErrorCode() != VIR_ERR_OK)
+        return -1;
+
+    taskstatsFail = false;
+
+    if (qemuDomainGetVcpusTaskStats(vm, stats, 3) != 0)
+        return -1;
+
+    if (taskstatsCalls != 1) {
+        fprintf(stderr, "taskstats queried %zu times\n", taskstatsCalls);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (qemuTestDriverInit(&driver) < 0)
+        return EXIT_FAILURE;
+
+    if (virTestRun("Taskstats", testVcpuStatsTaskStats, NULL) < 0)
+        ret = -1;
+
+    if (virTestRun("Procfs", testVcpuStatsProcfs, NULL) < 0)
+        ret = -1;
+
+    qemuTestDriverFree(&driver);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
+
+#else
+
+int
+main(void)
+{
+    return EXIT_AM_SKIP;
+}
+
+#endif /* WITH_QEMU */
@@ -40,6 +40,19 @@
 
 static virQEMUDriver driver;
 
+/* Number of extra command line builds done by each test case when
+ * benchmarking is enabled via VIR_TEST_BENCHMARK=<iterations>. */
+static unsigned int benchIterations;
+
+typedef struct _testBenchClass testBenchClass;
+struct _testBenchClass {
+    unsigned long long usecs;
+    unsigned long long builds;
+};
+
+/* device class (test name prefix) -> testBenchClass */
+static GHashTable *benchClasses;
+
 static unsigned char *
 fakeSecretGetValue(virSecretPtr obj G_GNUC_UNUSED,
                    size_t *value_size,
@@ -629,6 +642,70 @@ testCompareXMLToArgvValidateSchema(virQEMUDriver *drv,
 }
 
 
+/* Builds the command line of already prepared @vm repeatedly and
+ * accounts the time to the device class of the test. Tests are named
+ * after the device they exercise (e.g. 'controller-...', 'disk-...'),
+ * so the part of the name up to the first dash is used as the class. */
+static int
+testCompareXMLToArgvBenchmark(virDomainObj *vm,
+                              const char *migrateURI,
+                              struct testQemuInfo *info)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+    bool enableFips = (info->flags & FLAG_FIPS_HOST) &&
+                      virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_ENABLE_FIPS);
+    g_autofree char *cls = g_strdup(info->name);
+    testBenchClass *bench;
+    unsigned long long start;
+    unsigned long long usecs;
+    char *dash;
+    size_t i;
+
+    start = g_get_monotonic_time();
+
+    for (i = 0; i < benchIterations; i++) {
+        g_autoptr(virCommand) cmd = NULL;
+
+        if (!(cmd = qemuProcessCreatePretendCmdBuild(&driver, vm, migrateURI,
+                                                     enableFips, false, false)))
+            return -1;
+    }
+
+    usecs = g_get_monotonic_time() - start;
+
+    VIR_TEST_VERBOSE("%s: %llu us per build", info->name, usecs / benchIterations);
+
+    if ((dash = strchr(cls, '-')))
+        *dash = '\0';
+
+    if (!(bench = virHashLookup(benchClasses, cls))) {
+        bench = g_new0(testBenchClass, 1);
+        if (virHashAddEntry(benchClasses, cls, bench) < 0) {
+            g_free(bench);
+            return -1;
+        }
+    }
+
+    bench->usecs += usecs;
+    bench->builds += benchIterations;
+
+    return 0;
+}
+
+
+static int
+testBenchmarkPrintClass(void *payload,
+                        const char *name,
+                        void *opaque G_GNUC_UNUSED)
+{
+    testBenchClass *bench = payload;
+
+    fprintf(stderr, "%-30s %8llu builds %10llu us per build\n",
+            name, bench->builds, bench->usecs / bench->builds);
+    return 0;
+}
+
+
 static int
 testCompareXMLToArgv(const void *data)
 {
@@ -799,6 +876,10 @@ testCompareXMLToArgv(const void *data)
     if (virTestCompareToFileFull(actualargv, info->outfile, false) < 0)
         goto cleanup;
 
+    if (benchIterations > 0 &&
+        testCompareXMLToArgvBenchmark(vm, migrateURI, info) < 0)
+        goto cleanup;
+
     ret = 0;
 
  ok:
@@ -856,6 +937,15 @@ mymain(void)
     if (!capslatest)
         return EXIT_FAILURE;
 
+    if (getenv("VIR_TEST_BENCHMARK")) {
+        if (virStrToLong_ui(getenv("VIR_TEST_BENCHMARK"), NULL, 10,
+                            &benchIterations) < 0) {
+            fprintf(stderr, "VIR_TEST_BENCHMARK must be a number of iterations\n");
+            return EXIT_FAILURE;
+        }
+        benchClasses = virHashNew(g_free);
+    }
+
     fakerootdir = g_strdup(FAKEROOTDIRTEMPLATE);
 
     if (!g_mkdtemp(fakerootdir)) {
@@ -3508,6 +3598,11 @@ mymain(void)
 
     DO_TEST_CAPS_LATEST("devices-acpi-index");
 
+    if (benchClasses) {
+        virHashForEachSorted(benchClasses, testBenchmarkPrintClass, NULL);
+        g_clear_pointer(&benchClasses, g_hash_table_unref);
+    }
+
     if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
         virFileDeleteTree(fakerootdir);
 
@@ -254,6 +254,37 @@ static int testBufAddBuffer(const void *data G_GNUC_UNUSED)
     return 0;
 }
 
+static int
+testBufReserve(const void *data G_GNUC_UNUSED)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *result = NULL;
+    const char *expected = "<a>\n  <b/>\n</a>\n";
+
+    virBufferReserve(&buf, 4096);
+
+    if (virBufferUse(&buf)) {
+        VIR_TEST_DEBUG("buffer is not empty after reserving space");
+        return -1;
+    }
+
+    virBufferAddLit(&buf, "<a>\n");
+    virBufferReserve(&buf, 2);
+    virBufferReserve(&buf, 8192);
+    virBufferAdjustIndent(&buf, 2);
+    virBufferAddLit(&buf, "<b/>\n");
+    virBufferAdjustIndent(&buf, -2);
+    virBufferAddLit(&buf, "</a>\n");
+
+    result = virBufferContentAndReset(&buf);
+    if (STRNEQ_NULLABLE(result, expected)) {
+        virTestDifference(stderr, expected, result);
+        return -1;
+    }
+
+    return 0;
+}
+
 static int
 testBufAddStr(const void *opaque)
 {
@@ -385,6 +416,7 @@ mymain(void)
     DO_TEST("AddBuffer", testBufAddBuffer);
     DO_TEST("set indent", testBufSetIndent);
     DO_TEST("autoclean", testBufferAutoclean);
+    DO_TEST("reserve", testBufReserve);
 
 #define DO_TEST_ADD_STR(_data, _expect) \
     do { \
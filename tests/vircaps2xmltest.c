@@ -22,6 +22,7 @@
 #include "capabilities.h"
 #include "virbitmap.h"
 #include "virfilewrapper.h"
+#include "virhostcpu.h"
 
 
 #define VIR_FROM_THIS VIR_FROM_NONE
@@ -52,6 +53,7 @@ test_virCapabilities(const void *opaque)
 
     virFileWrapperAddPrefix("/sys/devices/system", system);
     virFileWrapperAddPrefix("/sys/fs/resctrl", resctrl);
+    virHostCPUTopologyCacheClear();
     caps = virCapabilitiesNew(data->arch, data->offlineMigrate, data->liveMigrate);
 
     if (!caps)
@@ -22,6 +22,7 @@
 
 #ifdef __linux__
 
+# include <unistd.h>
 
 # define LIBVIRT_VIRCGROUPPRIV_H_ALLOW
 # include "vircgrouppriv.h"
@@ -759,6 +760,62 @@ static int testCgroupGetPercpuStats(const void *args G_GNUC_UNUSED)
     return ret;
 }
 
+static int testCgroupGetDomainTotalCpuStats(const void *args G_GNUC_UNUSED)
+{
+    g_autoptr(virCgroup) cgroup = NULL;
+    virTypedParameter params[3];
+    double scale = 1000000000.0 / sysconf(_SC_CLK_TCK);
+    unsigned long long expected[3];
+    const char *names[] = {
+        VIR_DOMAIN_CPU_STATS_CPUTIME,
+        VIR_DOMAIN_CPU_STATS_USERTIME,
+        VIR_DOMAIN_CPU_STATS_SYSTEMTIME,
+    };
+    size_t i;
+    size_t j;
+    int rv;
+
+    expected[0] = 2787788855799582ULL;
+    expected[1] = 216687025ULL;
+    expected[1] *= scale;
+    expected[2] = 43421396ULL;
+    expected[2] *= scale;
+
+    if ((rv = virCgroupNewPartition("/virtualmachines", true,
+                                    (1 << VIR_CGROUP_CONTROLLER_CPU) |
+                                    (1 << VIR_CGROUP_CONTROLLER_CPUACCT),
+                                    &cgroup)) < 0) {
+        fprintf(stderr, "Could not create /virtualmachines cgroup: %d\n", -rv);
+        return -1;
+    }
+
+    /* The second round is served from the cached file descriptors */
+    for (j = 0; j < 2; j++) {
+        memset(params, 0, sizeof(params));
+
+        if ((rv = virCgroupGetDomainTotalCpuStats(cgroup, params,
+                                                  G_N_ELEMENTS(params))) != 3) {
+            fprintf(stderr, "Failed call to virCgroupGetDomainTotalCpuStats: %d\n", rv);
+            return -1;
+        }
+
+        for (i = 0; i < G_N_ELEMENTS(params); i++) {
+            if (STRNEQ(params[i].field, names[i]) ||
+                params[i].type != VIR_TYPED_PARAM_ULLONG ||
+                params[i].value.ul != expected[i]) {
+                fprintf(stderr,
+                        "Wrong value from virCgroupGetDomainTotalCpuStats at %zu "
+                        "(is: %s=%llu, expected %s=%llu)\n",
+                        i, params[i].field, params[i].value.ul,
+                        names[i], expected[i]);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
 static int testCgroupGetMemoryUsage(const void *args G_GNUC_UNUSED)
 {
     g_autoptr(virCgroup) cgroup = NULL;
@@ -1070,6 +1127,9 @@ mymain(void)
 
     if (virTestRun("virCgroupGetPercpuStats works", testCgroupGetPercpuStats, NULL) < 0)
         ret = -1;
+
+    if (virTestRun("virCgroupGetDomainTotalCpuStats works", testCgroupGetDomainTotalCpuStats, NULL) < 0)
+        ret = -1;
     cleanupFakeFS(fakerootdir);
 
     fakerootdir = initFakeFS(NULL, "all-in-one");
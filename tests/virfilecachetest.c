@@ -78,6 +78,7 @@ testFileCacheObjNew(const char *data)
 
 struct _testFileCachePriv {
     bool dataSaved;
+    bool newDataFail;
     const char *newData;
     const char *expectData;
 };
@@ -101,6 +102,11 @@ testFileCacheNewData(const char *name G_GNUC_UNUSED,
 {
     testFileCachePriv *testPriv = priv;
 
+    if (testPriv->newDataFail) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s", "cannot create data");
+        return NULL;
+    }
+
     return testFileCacheObjNew(testPriv->newData);
 }
 
@@ -193,6 +199,144 @@ testFileCache(const void *opaque)
 }
 
 
+static char *
+testFileCacheLookupData(virFileCache *cache,
+                        const char *name)
+{
+    testFileCacheObj *obj;
+    char *ret;
+
+    if (!(obj = virFileCacheLookup(cache, name)))
+        return NULL;
+
+    ret = g_strdup(obj->data);
+    virObjectUnref(obj);
+    return ret;
+}
+
+
+static int
+testFileCacheValidityTTL(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(virFileCache) cache = NULL;
+    testFileCachePriv testPriv = { .expectData = "aaa\n" };
+    g_autofree char *first = NULL;
+    g_autofree char *second = NULL;
+
+    if (!(cache = virFileCacheNew(abs_srcdir "/virfilecachedata",
+                                  "cache", &testFileCacheHandlers)))
+        return -1;
+
+    virFileCacheSetPriv(cache, &testPriv);
+    virFileCacheSetValidityTTL(cache, 3600 * 1000);
+
+    if (!(first = testFileCacheLookupData(cache, "cacheValid")))
+        return -1;
+
+    /* the data would be invalid now, but must not be checked again */
+    testPriv.expectData = "zzz\n";
+
+    if (!(second = testFileCacheLookupData(cache, "cacheValid")))
+        return -1;
+
+    if (STRNEQ(first, "aaa\n") || STRNEQ(second, "aaa\n")) {
+        fprintf(stderr, "Expected cached data 'aaa', got '%s' and '%s'\n",
+                first, second);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testFileCacheRefreshInBackground(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(virFileCache) cache = NULL;
+    testFileCachePriv testPriv = { .expectData = "aaa\n" };
+    g_autofree char *stale = NULL;
+    size_t i;
+
+    if (!(cache = virFileCacheNew(abs_srcdir "/virfilecachedata",
+                                  "cache", &testFileCacheHandlers)))
+        return -1;
+
+    virFileCacheSetPriv(cache, &testPriv);
+    virFileCacheSetRefreshInBackground(cache, true);
+
+    g_free(testFileCacheLookupData(cache, "cacheValid"));
+
+    testPriv.newData = "ddd\n";
+    testPriv.expectData = "ddd\n";
+
+    /* outdated data is returned while the new one is being created */
+    if (!(stale = testFileCacheLookupData(cache, "cacheValid")))
+        return -1;
+
+    if (STRNEQ(stale, "aaa\n")) {
+        fprintf(stderr, "Expected stale data 'aaa', got '%s'\n", stale);
+        return -1;
+    }
+
+    for (i = 0; i < 1000; i++) {
+        g_autofree char *fresh = NULL;
+
+        if (!(fresh = testFileCacheLookupData(cache, "cacheValid")))
+            return -1;
+
+        if (STREQ(fresh, "ddd\n"))
+            return 0;
+
+        g_usleep(10 * 1000);
+    }
+
+    fprintf(stderr, "Data was not refreshed in the background\n");
+    return -1;
+}
+
+
+static int
+testFileCacheRefreshInBackgroundFail(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(virFileCache) cache = NULL;
+    testFileCachePriv testPriv = { .expectData = "aaa\n" };
+    size_t i;
+
+    if (!(cache = virFileCacheNew(abs_srcdir "/virfilecachedata",
+                                  "cache", &testFileCacheHandlers)))
+        return -1;
+
+    virFileCacheSetPriv(cache, &testPriv);
+    virFileCacheSetRefreshInBackground(cache, true);
+
+    g_free(testFileCacheLookupData(cache, "cacheValid"));
+
+    testPriv.expectData = "ddd\n";
+    testPriv.newDataFail = true;
+
+    /* once the refresh fails, the outdated data must not be returned
+     * anymore and the lookup has to report the error itself */
+    for (i = 0; i < 1000; i++) {
+        g_autofree char *data = testFileCacheLookupData(cache, "cacheValid");
+
+        if (!data) {
+            virResetLastError();
+            return 0;
+        }
+
+        if (STRNEQ(data, "aaa\n")) {
+            fprintf(stderr, "Expected stale data 'aaa', got '%s'\n", data);
+            return -1;
+        }
+
+        g_usleep(10 * 1000);
+    }
+
+    fprintf(stderr, "Outdated data still returned after failed refresh\n");
+    return -1;
+}
+
+
 static int
 mymain(void)
 {
@@ -223,6 +367,13 @@ mymain(void)
 
     virObjectUnref(cache);
 
+    if (virTestRun("validityTTL", testFileCacheValidityTTL, NULL) < 0)
+        ret = -1;
+    if (virTestRun("refreshInBackground", testFileCacheRefreshInBackground, NULL) < 0)
+        ret = -1;
+    if (virTestRun("refreshInBackgroundFail", testFileCacheRefreshInBackgroundFail, NULL) < 0)
+        ret = -1;
+
     return ret != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
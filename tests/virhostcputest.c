@@ -112,6 +112,8 @@ linuxCPUStatsCompareFiles(const char *cpustatfile,
     char *actualData = NULL;
     FILE *cpustat = NULL;
     virNodeCPUStatsPtr params = NULL;
+    virHostCPUStatsLinux *stats = NULL;
+    size_t nstats = 0;
     g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
     size_t i;
     int nparams = 0;
@@ -143,6 +145,30 @@ linuxCPUStatsCompareFiles(const char *cpustatfile,
 
     actualData = virBufferContentAndReset(&buf);
 
+    if (virTestCompareToFile(actualData, outfile) < 0)
+        goto fail;
+
+    VIR_FREE(actualData);
+
+    /* The single pass parser must produce the same results */
+    rewind(cpustat);
+    if (virHostCPUReadStatsLinux(cpustat, &stats, &nstats) < 0)
+        goto fail;
+
+    if (virHostCPUFillStatsLinux(stats, nstats, VIR_NODE_CPU_STATS_ALL_CPUS,
+                                 params, &nparams) < 0 ||
+        linuxCPUStatsToBuf(&buf, VIR_NODE_CPU_STATS_ALL_CPUS,
+                           params, nparams) < 0)
+        goto fail;
+
+    for (i = 0; i < ncpus; i++) {
+        if (virHostCPUFillStatsLinux(stats, nstats, i, params, &nparams) < 0 ||
+            linuxCPUStatsToBuf(&buf, i, params, nparams) < 0)
+            goto fail;
+    }
+
+    actualData = virBufferContentAndReset(&buf);
+
     if (virTestCompareToFile(actualData, outfile) < 0)
         goto fail;
 
@@ -152,6 +178,7 @@ linuxCPUStatsCompareFiles(const char *cpustatfile,
     VIR_FORCE_FCLOSE(cpustat);
     VIR_FREE(actualData);
     VIR_FREE(params);
+    VIR_FREE(stats);
     return ret;
 }
 
@@ -179,6 +206,7 @@ linuxTestHostCPU(const void *opaque)
                              abs_srcdir, archStr, data->testName);
 
     virFileWrapperAddPrefix(SYSFS_SYSTEM_PATH, sysfs_prefix);
+    virHostCPUTopologyCacheClear();
     result = linuxTestCompareFiles(cpuinfo, data->arch, output);
     virFileWrapperRemovePrefix(SYSFS_SYSTEM_PATH);
 
@@ -139,6 +139,164 @@ static int testLockSpaceResourceLockExcl(const void *args G_GNUC_UNUSED)
 }
 
 
+static int testLockSpaceResourceLockBatch(const void *args G_GNUC_UNUSED)
+{
+    virLockSpace *lockspace;
+    const char *names[] = { "foo", "bar", "baz" };
+    const unsigned int flags[] = { VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE,
+                                   VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE,
+                                   VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE };
+    int ret = -1;
+
+    rmdir(LOCKSPACE_DIR);
+
+    if (!(lockspace = virLockSpaceNew(LOCKSPACE_DIR)))
+        goto cleanup;
+
+    if (virLockSpaceAcquireResource(lockspace, "baz", geteuid(),
+                                    VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE) < 0)
+        goto cleanup;
+
+    /* "baz" is busy, so neither "bar" nor "foo" may be left locked */
+    if (virLockSpaceAcquireResources(lockspace, G_N_ELEMENTS(names),
+                                     names, flags, geteuid()) == 0)
+        goto cleanup;
+
+    if (virFileExists(LOCKSPACE_DIR "/foo") ||
+        virFileExists(LOCKSPACE_DIR "/bar"))
+        goto cleanup;
+
+    if (virLockSpaceReleaseResource(lockspace, "baz", geteuid()) < 0)
+        goto cleanup;
+
+    if (virLockSpaceAcquireResources(lockspace, G_N_ELEMENTS(names),
+                                     names, flags, geteuid()) < 0)
+        goto cleanup;
+
+    if (!virFileExists(LOCKSPACE_DIR "/foo") ||
+        !virFileExists(LOCKSPACE_DIR "/bar") ||
+        !virFileExists(LOCKSPACE_DIR "/baz"))
+        goto cleanup;
+
+    if (virLockSpaceReleaseResourcesForOwner(lockspace, geteuid()) != 3)
+        goto cleanup;
+
+    if (virFileExists(LOCKSPACE_DIR "/foo"))
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virLockSpaceFree(lockspace);
+    rmdir(LOCKSPACE_DIR);
+    return ret;
+}
+
+
+static int testLockSpaceResourceLockBatchHeld(const void *args G_GNUC_UNUSED)
+{
+    virLockSpace *lockspace;
+    virLockSpaceStats stats;
+    const char *names[] = { "foo", "bar", "baz" };
+    const unsigned int flags[] = { VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE,
+                                   VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE |
+                                   VIR_LOCK_SPACE_ACQUIRE_SHARED,
+                                   VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE };
+    int ret = -1;
+
+    rmdir(LOCKSPACE_DIR);
+
+    if (!(lockspace = virLockSpaceNew(LOCKSPACE_DIR)))
+        goto cleanup;
+
+    if (virLockSpaceAcquireResource(lockspace, "bar", 1,
+                                    VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE |
+                                    VIR_LOCK_SPACE_ACQUIRE_SHARED) < 0 ||
+        virLockSpaceAcquireResource(lockspace, "baz", 2,
+                                    VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE) < 0)
+        goto cleanup;
+
+    /* "bar" is acquired again before "baz" turns out to be busy */
+    if (virLockSpaceAcquireResources(lockspace, G_N_ELEMENTS(names),
+                                     names, flags, 1) == 0)
+        goto cleanup;
+
+    /* only what the batch acquired is gone, the earlier "bar" stays */
+    virLockSpaceGetStats(lockspace, &stats);
+    if (stats.resources != 2 || stats.owners != 2)
+        goto cleanup;
+
+    if (!virFileExists(LOCKSPACE_DIR "/bar") ||
+        virFileExists(LOCKSPACE_DIR "/foo"))
+        goto cleanup;
+
+    if (virLockSpaceReleaseResourcesForOwner(lockspace, 1) != 1)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virLockSpaceFree(lockspace);
+    rmdir(LOCKSPACE_DIR);
+    return ret;
+}
+
+
+static int testLockSpaceResourceReleaseOwner(const void *args G_GNUC_UNUSED)
+{
+    virLockSpace *lockspace;
+    virLockSpaceStats stats;
+    int ret = -1;
+
+    rmdir(LOCKSPACE_DIR);
+
+    if (!(lockspace = virLockSpaceNew(LOCKSPACE_DIR)))
+        goto cleanup;
+
+    if (virLockSpaceAcquireResource(lockspace, "foo", 1,
+                                    VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE |
+                                    VIR_LOCK_SPACE_ACQUIRE_SHARED) < 0 ||
+        virLockSpaceAcquireResource(lockspace, "foo", 2,
+                                    VIR_LOCK_SPACE_ACQUIRE_SHARED) < 0 ||
+        virLockSpaceAcquireResource(lockspace, "bar", 1,
+                                    VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE) < 0)
+        goto cleanup;
+
+    if (virLockSpaceAcquireResource(lockspace, "bar", 2, 0) == 0)
+        goto cleanup;
+
+    virLockSpaceGetStats(lockspace, &stats);
+    if (stats.resources != 2 || stats.owners != 2 ||
+        stats.acquired != 3 || stats.busy != 1 || stats.released != 0)
+        goto cleanup;
+
+    if (virLockSpaceReleaseResourcesForOwner(lockspace, 1) != 2)
+        goto cleanup;
+
+    /* "foo" is still held by the other owner */
+    if (!virFileExists(LOCKSPACE_DIR "/foo") ||
+        virFileExists(LOCKSPACE_DIR "/bar"))
+        goto cleanup;
+
+    if (virLockSpaceReleaseResourcesForOwner(lockspace, 1) != 0)
+        goto cleanup;
+
+    if (virLockSpaceReleaseResourcesForOwner(lockspace, 2) != 1)
+        goto cleanup;
+
+    virLockSpaceGetStats(lockspace, &stats);
+    if (stats.resources != 0 || stats.owners != 0 || stats.released != 2)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virLockSpaceFree(lockspace);
+    rmdir(LOCKSPACE_DIR);
+    return ret;
+}
+
+
 static int testLockSpaceResourceLockExclAuto(const void *args G_GNUC_UNUSED)
 {
     virLockSpace *lockspace;
@@ -359,6 +517,15 @@ mymain(void)
     if (virTestRun("Lockspace res lock shr", testLockSpaceResourceLockShr, NULL) < 0)
         ret = -1;
 
+    if (virTestRun("Lockspace res lock batch", testLockSpaceResourceLockBatch, NULL) < 0)
+        ret = -1;
+
+    if (virTestRun("Lockspace res lock batch held", testLockSpaceResourceLockBatchHeld, NULL) < 0)
+        ret = -1;
+
+    if (virTestRun("Lockspace res release owner", testLockSpaceResourceReleaseOwner, NULL) < 0)
+        ret = -1;
+
     if (virTestRun("Lockspace res lock excl auto", testLockSpaceResourceLockExclAuto, NULL) < 0)
         ret = -1;
 
@@ -0,0 +1,96 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virfilewrapper.h"
+#include "virnuma.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+/* The mocked host has four nodes with four CPUs and 1 GiB of free memory
+ * each, all of them equally distant from each other. */
+#define SYSFS_DATA abs_srcdir "/vircaps2xmldata/linux-basic/system"
+
+struct testPlacementData {
+    unsigned int vcpus;
+    unsigned long long memory; /* KiB */
+    const unsigned int *load;
+    size_t nload;
+    const char *expected;
+};
+
+
+static int
+testPlacement(const void *opaque)
+{
+    const struct testPlacementData *data = opaque;
+    g_autoptr(virBitmap) nodeset = NULL;
+    g_autofree char *actual = NULL;
+
+    if (!(nodeset = virNumaGetBuiltinPlacementAdvice(data->vcpus, data->memory,
+                                                     0, data->load,
+                                                     data->nload)))
+        return -1;
+
+    actual = virBitmapFormat(nodeset);
+
+    if (STRNEQ_NULLABLE(actual, data->expected)) {
+        fprintf(stderr, "expected nodeset '%s', got '%s'\n",
+                data->expected, NULLSTR(actual));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    const unsigned int loaded[] = { 4, 2, 0, 4 };
+    const unsigned int full[] = { 4, 4, 4, 4 };
+
+    virFileWrapperAddPrefix("/sys/devices/system", SYSFS_DATA);
+
+#define DO_TEST(name, vcpus, memory, load, nload, expected) \
+    do { \
+        struct testPlacementData data = { \
+            vcpus, memory, load, nload, expected \
+        }; \
+        if (virTestRun("Placement " name, testPlacement, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    /* The whole guest fits on any node, the first one wins the tie */
+    DO_TEST("idle", 2, 512 * 1024, NULL, 0, "0");
+    /* The least loaded node is preferred */
+    DO_TEST("loaded", 2, 512 * 1024, loaded, G_N_ELEMENTS(loaded), "2");
+    /* Load only tips the balance, a fully loaded host is still usable */
+    DO_TEST("full", 2, 512 * 1024, full, G_N_ELEMENTS(full), "0");
+    /* Neither memory nor CPUs of a single node are enough */
+    DO_TEST("memory", 2, 1536 * 1024, NULL, 0, "0-1");
+    DO_TEST("vcpus", 6, 512 * 1024, NULL, 0, "0-1");
+    DO_TEST("huge", 16, 4 * 1024 * 1024, NULL, 0, "0-3");
+
+    virFileWrapperClearPrefixes();
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN_PRELOAD(mymain, VIR_TEST_MOCK("virnuma"))
@@ -0,0 +1,240 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virerror.h"
+#include "viridentity.h"
+#include "virlog.h"
+
+#include "virtaskgraph.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+VIR_LOG_INIT("tests.taskgraphtest");
+
+#define TEST_NTASKS 8
+
+struct testTaskGraphData {
+    int order; /* shared counter of finished tasks */
+    int finished[TEST_NTASKS];
+    int fail;
+    virIdentity *identity; /* identity tasks are expected to run with */
+};
+
+struct testTaskGraphTask {
+    struct testTaskGraphData *data;
+    int id;
+};
+
+
+static int
+testTaskGraphFunc(void *opaque)
+{
+    struct testTaskGraphTask *task = opaque;
+
+    if (task->data->fail == task->id) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "task %d failed", task->id);
+        return -1;
+    }
+
+    if (task->data->identity) {
+        g_autoptr(virIdentity) current = virIdentityGetCurrent();
+
+        if (current != task->data->identity) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           "task %d runs with a wrong identity", task->id);
+            return -1;
+        }
+    }
+
+    g_usleep(1000);
+    task->data->finished[task->id] = g_atomic_int_add(&task->data->order, 1) + 1;
+    return 0;
+}
+
+
+/* Builds a diamond: 0 -> {1, 2, 3, 4, 5, 6} -> 7 */
+static virTaskGraph *
+testTaskGraphBuild(struct testTaskGraphData *data,
+                   struct testTaskGraphTask *tasks)
+{
+    g_autoptr(virTaskGraph) graph = virTaskGraphNew();
+    size_t middle[TEST_NTASKS - 2];
+    size_t first;
+    size_t i;
+
+    for (i = 0; i < TEST_NTASKS; i++) {
+        tasks[i].data = data;
+        tasks[i].id = i;
+    }
+
+    first = virTaskGraphAdd(graph, "first", testTaskGraphFunc, &tasks[0], NULL, 0);
+
+    for (i = 1; i < TEST_NTASKS - 1; i++) {
+        middle[i - 1] = virTaskGraphAdd(graph, "middle", testTaskGraphFunc,
+                                        &tasks[i], &first, 1);
+    }
+
+    virTaskGraphAdd(graph, "last", testTaskGraphFunc, &tasks[TEST_NTASKS - 1],
+                    middle, G_N_ELEMENTS(middle));
+
+    return g_steal_pointer(&graph);
+}
+
+
+static int
+testTaskGraphOrder(const void *opaque)
+{
+    const size_t *workers = opaque;
+    struct testTaskGraphData data = { .fail = -1 };
+    struct testTaskGraphTask tasks[TEST_NTASKS];
+    g_autoptr(virTaskGraph) graph = testTaskGraphBuild(&data, tasks);
+    size_t i;
+
+    if (virTaskGraphRun(graph, *workers) < 0)
+        return -1;
+
+    if (data.finished[0] != 1) {
+        fprintf(stderr, "first task finished as %d\n", data.finished[0]);
+        return -1;
+    }
+
+    for (i = 1; i < TEST_NTASKS - 1; i++) {
+        if (data.finished[i] <= 1 || data.finished[i] >= TEST_NTASKS) {
+            fprintf(stderr, "task %zu finished as %d\n", i, data.finished[i]);
+            return -1;
+        }
+    }
+
+    if (data.finished[TEST_NTASKS - 1] != TEST_NTASKS) {
+        fprintf(stderr, "last task finished as %d\n",
+                data.finished[TEST_NTASKS - 1]);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* A single worker runs tasks in the order they were added */
+static int
+testTaskGraphSerial(const void *opaque)
+{
+    const size_t *workers = opaque;
+    struct testTaskGraphData data = { .fail = -1 };
+    struct testTaskGraphTask tasks[TEST_NTASKS];
+    g_autoptr(virTaskGraph) graph = testTaskGraphBuild(&data, tasks);
+    size_t i;
+
+    if (virTaskGraphRun(graph, *workers) < 0)
+        return -1;
+
+    for (i = 0; i < TEST_NTASKS; i++) {
+        if (data.finished[i] != (int)i + 1) {
+            fprintf(stderr, "task %zu finished as %d\n", i, data.finished[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+testTaskGraphIdentity(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(virIdentity) identity = virIdentityNew();
+    struct testTaskGraphData data = { .fail = -1, .identity = identity };
+    struct testTaskGraphTask tasks[TEST_NTASKS];
+    g_autoptr(virTaskGraph) graph = testTaskGraphBuild(&data, tasks);
+    int ret;
+
+    if (virIdentitySetCurrent(identity) < 0)
+        return -1;
+
+    ret = virTaskGraphRun(graph, 4);
+
+    virIdentitySetCurrent(NULL);
+    return ret;
+}
+
+
+static int
+testTaskGraphFailure(const void *opaque G_GNUC_UNUSED)
+{
+    struct testTaskGraphData data = { .fail = 0 };
+    struct testTaskGraphTask tasks[TEST_NTASKS];
+    g_autoptr(virTaskGraph) graph = testTaskGraphBuild(&data, tasks);
+    size_t i;
+
+    if (virTaskGraphRun(graph, 4) == 0) {
+        fprintf(stderr, "task graph should have failed\n");
+        return -1;
+    }
+
+    if (virGetLastErrorCode() != VIR_ERR_INTERNAL_ERROR) {
+        fprintf(stderr, "error of the failed task not preserved\n");
+        return -1;
+    }
+    virResetLastError();
+
+    for (i = 0; i < TEST_NTASKS; i++) {
+        if (data.finished[i] != 0) {
+            fprintf(stderr, "task %zu should not have run\n", i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    size_t workers[] = { 1, 2, 4, 16 };
+    size_t serial[] = { 0, 1 };
+    size_t i;
+
+    for (i = 0; i < G_N_ELEMENTS(workers); i++) {
+        g_autofree char *name = g_strdup_printf("order with %zu workers",
+                                                workers[i]);
+
+        if (virTestRun(name, testTaskGraphOrder, &workers[i]) < 0)
+            ret = -1;
+    }
+
+    for (i = 0; i < G_N_ELEMENTS(serial); i++) {
+        g_autofree char *name = g_strdup_printf("serial with %zu workers",
+                                                serial[i]);
+
+        if (virTestRun(name, testTaskGraphSerial, &serial[i]) < 0)
+            ret = -1;
+    }
+
+    if (virTestRun("identity", testTaskGraphIdentity, NULL) < 0)
+        ret = -1;
+
+    if (virTestRun("failure", testTaskGraphFailure, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
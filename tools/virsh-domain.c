@@ -6011,6 +6011,10 @@ static const vshCmdOptDef opts_domjobinfo[] = {
      .type = VSH_OT_BOOL,
      .help = N_("print the raw data returned by libvirt")
     },
+    {.name = "disk-mirrors",
+     .type = VSH_OT_BOOL,
+     .help = N_("print statistics of each disk copied by storage migration")
+    },
     {.name = NULL}
 };
 
@@ -6100,6 +6104,7 @@ cmdDomjobinfo(vshControl *ctl, const vshCmd *cmd)
     virTypedParameterPtr params = NULL;
     int nparams = 0;
     unsigned long long value;
+    unsigned int uvalue;
     unsigned int flags = 0;
     int ivalue;
     const char *svalue;
@@ -6119,6 +6124,9 @@ cmdDomjobinfo(vshControl *ctl, const vshCmd *cmd)
     if (vshCommandOptBool(cmd, "keep-completed"))
         flags |= VIR_DOMAIN_JOB_STATS_KEEP_COMPLETED;
 
+    if (vshCommandOptBool(cmd, "disk-mirrors"))
+        flags |= VIR_DOMAIN_JOB_STATS_DISK_MIRRORS;
+
     memset(&info, 0, sizeof(info));
 
     rc = virDomainGetJobStats(dom, &info.type, &params, &nparams, flags);
@@ -6365,6 +6373,59 @@ cmdDomjobinfo(vshControl *ctl, const vshCmd *cmd)
         vshPrint(ctl, "%-17s %-13d\n", _("Auto converge throttle:"), ivalue);
     }
 
+    if ((rc = virTypedParamsGetUInt(params, nparams,
+                                    VIR_DOMAIN_JOB_DISK_MIRROR_COUNT,
+                                    &uvalue)) < 0) {
+        goto save_error;
+    } else if (rc) {
+        for (i = 0; i < uvalue; i++) {
+            char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+            g_autofree char *label = NULL;
+            int ready = 0;
+            unsigned long long eta;
+
+            g_snprintf(field, sizeof(field),
+                       VIR_DOMAIN_JOB_DISK_MIRROR_NAME, (unsigned int) i);
+            if ((rc = virTypedParamsGetString(params, nparams, field,
+                                              &svalue)) < 0)
+                goto save_error;
+            if (!rc)
+                continue;
+
+            g_snprintf(field, sizeof(field),
+                       VIR_DOMAIN_JOB_DISK_MIRROR_REMAINING, (unsigned int) i);
+            if (virTypedParamsGetULLong(params, nparams, field, &value) < 0)
+                goto save_error;
+            val = vshPrettyCapacity(value, &unit);
+
+            g_snprintf(field, sizeof(field),
+                       VIR_DOMAIN_JOB_DISK_MIRROR_READY, (unsigned int) i);
+            if (virTypedParamsGetBoolean(params, nparams, field, &ready) < 0)
+                goto save_error;
+
+            g_snprintf(field, sizeof(field),
+                       VIR_DOMAIN_JOB_DISK_MIRROR_ETA, (unsigned int) i);
+            if ((rc = virTypedParamsGetULLong(params, nparams, field,
+                                              &eta)) < 0)
+                goto save_error;
+
+            if (ready) {
+                label = g_strdup_printf(_("Disk mirror %s:"), svalue);
+                vshPrint(ctl, "%-17s %s\n", label, _("ready"));
+            } else {
+                label = g_strdup_printf(_("Disk mirror %s remaining:"), svalue);
+                vshPrint(ctl, "%-17s %-.3lf %s\n", label, val, unit);
+            }
+
+            if (!ready && rc) {
+                g_autofree char *etaLabel = g_strdup_printf(_("Disk mirror %s ETA:"),
+                                                            svalue);
+
+                vshPrint(ctl, "%-17s %llu s\n", etaLabel, eta / 1000);
+            }
+        }
+    }
+
     if ((rc = virTypedParamsGetULLong(params, nparams,
                                       VIR_DOMAIN_JOB_DISK_TEMP_USED,
                                       &value)) < 0) {